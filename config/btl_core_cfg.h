@@ -105,6 +105,36 @@
 // <i> This requires that the SE upgrade GBL tag is unencrypted.
 #define BOOTLOADER_SE_UPGRADE_NO_STAGING                    0
 
+// <e BOOTLOADER_ASYNC_FLASH_WRITE> Program flash in the background
+// <i> Default: 0
+// <i> Image data is copied to a RAM buffer and programmed by LDMA while the bootloader continues to receive and parse the image.
+// <i> A pending write is completed before the next flash erase or write, and when a transfer ends.
+// <i> Applicable to Series-2 devices only.
+#define BOOTLOADER_ASYNC_FLASH_WRITE                    0
+
+// <o BOOTLOADER_ASYNC_FLASH_WRITE_BUFFER_SIZE> Background write buffer size <4-8192:4>
+// <i> Default: 1024
+// <i> Writes larger than the buffer are programmed synchronously.
+#define BOOTLOADER_ASYNC_FLASH_WRITE_BUFFER_SIZE        1024
+// </e>
+
+// <q BOOTLOADER_FLASH_PAGE_BUFFER> Coalesce image writes per flash page
+// <i> Default: 0
+// <i> Sequential image data is collected in a RAM buffer of one flash page, and each page is erased and programmed with a single operation.
+// <i> The buffer is written when the next write is not contiguous, when the page is full, and when a transfer ends.
+#define BOOTLOADER_FLASH_PAGE_BUFFER                    0
+
+// <q BOOTLOADER_SKIP_IDENTICAL_PAGES> Skip programming of unchanged pages
+// <i> Default: 0
+// <i> Full flash pages that already contain the incoming data are neither erased nor programmed. Requires BOOTLOADER_FLASH_PAGE_BUFFER.
+// <i> The first application page is always programmed, so the application stays unbootable until the image is complete.
+#define BOOTLOADER_SKIP_IDENTICAL_PAGES                 0
+
+// <q BOOTLOADER_DELTA_OTW> Delta upgrades without storage
+// <i> Default: 0
+// <i> Rebuild the application from the installed application and a delta patch received over XMODEM. The new image is assembled in the application space above the installed application and copied to the start of the application space once its CRC has been verified. The installed application, rounded up to a whole page, and the new image together must fit in the application space, 0x7A000 bytes by default or 0x66000 bytes with resumable XMODEM uploads, so images of up to about 244 KiB or 204 KiB each. Delta upgrades are therefore unusable for the Z-Wave controller firmware of about 400 KB, which needs full GBL files. The program counter of the application is written last, so an interrupted copy leaves no bootable application; the bootloader then stays active and needs a full GBL file. Can't be combined with a storage slot. Delta tags must use LZMA or no compression.
+#define BOOTLOADER_DELTA_OTW                            0
+
 // <o BTL_UPGRADE_LOCATION_BASE> Base address of bootloader upgrade image <f.h>
 // <i> Default: 0x8000
 // <i> At the upgrade stage of the bootloader, the running main bootloader extracts the upgrade image from the GBL file,
@@ -118,6 +148,7 @@
 
 // <e USE_CUSTOM_APP_SIZE> Use custom Bootloader Application Size
 // <i> Default: 0
+// <i> When disabled, the application space ends at the end of flash, or with resumable XMODEM uploads at the checkpoint area (BTL_XMODEM_RESUME_ADDRESS).
 #define USE_CUSTOM_APP_SIZE                                     0
 
 // <o CUSTOM_BTL_APP_SPACE_SIZE> Enter Bootloader App Space Size
@@ -129,8 +160,14 @@
 #if USE_CUSTOM_APP_SIZE
 #define BTL_APP_SPACE_SIZE                    CUSTOM_BTL_APP_SPACE_SIZE
 #else
+#include "btl_xmodem_config.h"
+#if defined(BTL_XMODEM_RESUME_ENABLE) && (BTL_XMODEM_RESUME_ENABLE == 1)
+// Images can't overwrite the checkpoint area
+#define BTL_APP_SPACE_SIZE                    (BTL_XMODEM_RESUME_ADDRESS - BTL_APPLICATION_BASE)
+#else
 #define BTL_APP_SPACE_SIZE                    (FLASH_BASE + FLASH_SIZE) - BTL_APPLICATION_BASE
 #endif
+#endif
 
 // </h>
 
@@ -0,0 +1,52 @@
+/***************************************************************************//**
+ * @file
+ * @brief Configuration header for bootloader CRC calculation
+ *******************************************************************************
+ * # License
+ * <b>Copyright 2021 Silicon Laboratories Inc. www.silabs.com</b>
+ *******************************************************************************
+ *
+ * The licensor of this software is Silicon Laboratories Inc.  Your use of this
+ * software is governed by the terms of Silicon Labs Master Software License
+ * Agreement (MSLA) available at
+ * www.silabs.com/about-us/legal/master-software-license-agreement.  This
+ * software is distributed to you in Source Code format and is governed by the
+ * sections of the MSLA applicable to Source Code.
+ *
+ ******************************************************************************/
+#ifndef BTL_CRC_CONFIG_H
+#define BTL_CRC_CONFIG_H
+
+// <<< Use Configuration Wizard in Context Menu >>>
+
+// <h>CRC16
+
+// <o BTL_CRC16_ENGINE> CRC16 engine
+// <BTL_CRC16_ENGINE_BITWISE=> Bitwise (smallest)
+// <BTL_CRC16_ENGINE_TABLE=> 256-entry table (512 bytes)
+// <BTL_CRC16_ENGINE_SLICE_BY_4=> Slice-by-4 tables (2 kB)
+// <BTL_CRC16_ENGINE_GPCRC=> GPCRC peripheral
+// <i> Default: BTL_CRC16_ENGINE_TABLE
+// <i> Implementation used by btl_crc16Stream(), e.g. for XMODEM packet
+// <i> validation. The GPCRC engine takes one register write per byte, and
+// <i> makes the CRC32 of the GBL parser, which keeps its state in GPCRC,
+// <i> reinitialize it for each packet. It falls back to the 256-entry table
+// <i> on parts without GPCRC.
+#define BTL_CRC16_ENGINE       BTL_CRC16_ENGINE_TABLE
+
+// </h>
+
+// <h>CRC32
+
+// <q BTL_CRC32_SOFTWARE> Software CRC32
+// <i> Default: 0
+// <i> Calculate CRC32 with slice-by-8 lookup tables (8 kB) instead of the
+// <i> GPCRC peripheral. The software implementation is always used on parts
+// <i> without GPCRC.
+#define BTL_CRC32_SOFTWARE     0
+
+// </h>
+
+// <<< end of configuration section >>>
+
+#endif // BTL_CRC_CONFIG_H
@@ -36,6 +36,12 @@
 /// Enable Assert in source code.
 #define SL_DEBUG_ASSERT                    0
 
+// <q SL_DEBUG_PROFILE> Hot path profiling
+// <i> Default: 0
+// <i> Accumulate cycle, call and byte counts per image processing stage
+/// Accumulate cycle, call and byte counts per image processing stage.
+#define SL_DEBUG_PROFILE                   0
+
 // </h>
 // <<< end of configuration section >>>
 
@@ -27,13 +27,24 @@
 
 // <e SL_SERIAL_UART_FLOW_CONTROL> Hardware flow control
 // <i> Default: 0
+// <i> CTS pauses transmission. RTS is driven by the fill level of the
+// <i> receive buffer. Requires CTS and RTS pins.
 #define SL_SERIAL_UART_FLOW_CONTROL      0
+
+// <o SL_SERIAL_UART_RTS_HEADROOM> Free receive buffer space deasserting RTS
+// <i> Default: 256
+// <i> RTS is deasserted once less space than this is left in the receive
+// <i> buffer, and asserted again once twice as much is free. Must cover the
+// <i> data the host sends after RTS is deasserted, plus the data received
+// <i> while the bootloader is busy, such as during a flash page erase.
+// <i> Twice the headroom must not exceed half the receive buffer.
+#define SL_SERIAL_UART_RTS_HEADROOM      256
 // </e>
 
 // <o SL_DRIVER_UART_RX_BUFFER_SIZE> Receive buffer size
 // <0-2048:1>
 // <i> Default: 512 [0-2048]
-#define SL_DRIVER_UART_RX_BUFFER_SIZE    512
+#define SL_DRIVER_UART_RX_BUFFER_SIZE    2048
 
 // <o SL_DRIVER_UART_TX_BUFFER_SIZE> Transmit buffer size
 // <0-2048:1>
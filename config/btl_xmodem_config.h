@@ -40,6 +40,126 @@
 // <i> the bootloader will abort the firmware upgrade process and return to the application.
 #define BTL_XMODEM_IDLE_TIMEOUT  0
 
+// <q BTL_XMODEM_1K_ENABLE> Accept XMODEM-1K packets
+// <i> Default: 1
+// <i> Accept STX framed packets carrying 1024 bytes of payload in addition to
+// <i> regular 128 byte SOH packets. Requires a UART receive buffer of at least
+// <i> 1029 bytes to hold a complete packet without stalling the receiver.
+#define BTL_XMODEM_1K_ENABLE  1
+
+// <q BTL_XMODEM_STREAMING_ENABLE> Streaming (XMODEM-G) upload
+// <i> Default: 0
+// <i> Adds a menu option which requests the transfer with 'G' instead of 'C'.
+// <i> The sender then streams blocks back to back without waiting for an ACK,
+// <i> while the UART receive buffer absorbs data during flash erase/write.
+// <i> Blocks are not retransmitted; any error aborts the transfer. Only use on
+// <i> reliable links, with flow control or with a receive buffer large enough
+// <i> to cover a flash page erase at the configured baud rate.
+#define BTL_XMODEM_STREAMING_ENABLE  0
+
+// <e BTL_XMODEM_BAUD_SWITCH_ENABLE> High speed upload
+// <i> Default: 0
+// <i> Adds a menu option which switches the UART to a higher baud rate for the
+// <i> duration of one upload. After announcing the switch, the bootloader
+// <i> requests the transfer at the new baud rate. If the host does not follow
+// <i> or the first block fails, the default baud rate is restored and the menu
+// <i> is shown again. The default baud rate is also restored once the upload
+// <i> is complete.
+#define BTL_XMODEM_BAUD_SWITCH_ENABLE  0
+
+// <o BTL_XMODEM_BAUD_SWITCH_RATE> High speed baud rate
+// <i> Default: 921600
+#define BTL_XMODEM_BAUD_SWITCH_RATE  921600
+
+// <o BTL_XMODEM_BAUD_SWITCH_TIMEOUT> Seconds to wait for the host at the new baud rate [1-60]
+// <1-60:1>
+// <i> Default: 5
+#define BTL_XMODEM_BAUD_SWITCH_TIMEOUT  5
+// </e>
+
+// <e BTL_XMODEM_RESUME_ENABLE> Resumable upload
+// <i> Default: 0
+// <i> Periodically saves the parser, decryption, authentication and
+// <i> decompression state to a scratch flash area while an upload is received.
+// <i> Adds a menu option which restores the last checkpoint, checks the flash
+// <i> programmed up to that point and reports the offset into the GBL file
+// <i> the host must continue the upload from. Streaming uploads are not
+// <i> checkpointed.
+#define BTL_XMODEM_RESUME_ENABLE  0
+
+// <o BTL_XMODEM_RESUME_ADDRESS> Checkpoint area address
+// <i> Default: 0x0806C000
+// <i> Page aligned start of the flash area holding the checkpoint. The area
+// <i> must end below NVM3. Unless USE_CUSTOM_APP_SIZE sets its size, the
+// <i> application space ends here, which holds the delta scratch region.
+#define BTL_XMODEM_RESUME_ADDRESS  0x0806C000
+
+// <o BTL_XMODEM_RESUME_SIZE> Checkpoint area size
+// <i> Default: 0x8000
+// <i> Multiple of the flash page size. Must hold the parser contexts and the
+// <i> LZMA decompressor buffers: LZMA_COUNTER_SIZE_KB + LZMA_DICT_SIZE_KB
+// <i> + 3 kB, 27 kB for lc = 3 with the default dictionary.
+#define BTL_XMODEM_RESUME_SIZE  0x8000
+
+// <o BTL_XMODEM_RESUME_INTERVAL> Bytes received between checkpoints
+// <i> Default: 32768
+// <i> Each checkpoint erases the checkpoint area once.
+#define BTL_XMODEM_RESUME_INTERVAL  32768
+// </e>
+
+// <e BTL_XMODEM_FAST_NAK_ENABLE> Fast error recovery
+// <i> Default: 0
+// <i> Rejects a truncated packet as soon as the receive line goes idle in the
+// <i> middle of it, rather than after the packet timeout, so the sender
+// <i> retransmits within milliseconds. The time allowed for the rest of a
+// <i> packet is also derived from the current baud rate. Requires a USART
+// <i> with a timer comparator; otherwise only the baud rate derived timeout
+// <i> applies.
+#define BTL_XMODEM_FAST_NAK_ENABLE  0
+
+// <o BTL_XMODEM_RX_GAP_CHARS> Idle character times ending a packet [2-255]
+// <2-255:1>
+// <i> Default: 16
+#define BTL_XMODEM_RX_GAP_CHARS  16
+
+// <o BTL_XMODEM_RX_GAP_MIN_US> Minimum idle time in microseconds
+// <i> Default: 2000
+// <i> Lower bound on the idle time at high baud rates. USB serial adapters
+// <i> may pause between USB frames in the middle of a packet.
+#define BTL_XMODEM_RX_GAP_MIN_US  2000
+// </e>
+
+// <q BTL_XMODEM_DIRECT_UPLOAD_ENABLE> Upload without menu selection
+// <i> Default: 0
+// <i> Starts an upload right away when the host sends 'C' or the first
+// <i> XMODEM packet while the bootloader waits for a menu selection. On 'C',
+// <i> the bootloader requests the transfer without printing "begin upload".
+// <i> A packet sent without waiting for the request is received as the first
+// <i> packet of the transfer.
+#define BTL_XMODEM_DIRECT_UPLOAD_ENABLE  0
+
+// <q BTL_XMODEM_QUIET_ENABLE> Quiet mode
+// <i> Default: 0
+// <i> Suppresses the banner and menu. Menu selections are still accepted.
+#define BTL_XMODEM_QUIET_ENABLE  0
+
+// <e BTL_XMODEM_READBACK_ENABLE> Flash readback
+// <i> Default: 0
+// <i> Adds menu options which send a range of flash to the host with XMODEM,
+// <i> and which list a checksum for each flash page in a range. Both prompt
+// <i> for the start address and the length, as 8 hex digits each. Flash from
+// <i> the application base to the end of flash can be read, including NVM and
+// <i> the token page. The GBL decryption key in the token page reads as
+// <i> erased flash (0xFF); the rest of NVM and the token page, including the
+// <i> public signing key, is sent as stored. Only enable on devices where this
+// <i> is acceptable.
+#define BTL_XMODEM_READBACK_ENABLE  0
+
+// <q BTL_XMODEM_MANIFEST_SHA256> SHA-256 page manifest
+// <i> Default: 0
+// <i> List the SHA-256 digest of each flash page instead of its CRC32.
+#define BTL_XMODEM_MANIFEST_SHA256  0
+// </e>
 
 // </h>
 
@@ -157,6 +157,13 @@
 /// Bootload list found but with invalid CRC
 #define BOOTLOADER_ERROR_BOOTLOAD_LIST_INVALID \
   (BOOTLOADER_ERROR_BOOTLOAD_BASE | 0x06L)
+/// Delta patch is malformed, was made for another installed application, or
+/// doesn't fit the installed application or the scratch region
+#define BOOTLOADER_ERROR_BOOTLOAD_DELTA_PATCH \
+  (BOOTLOADER_ERROR_BOOTLOAD_BASE | 0x07L)
+/// Image rebuilt from a delta patch doesn't match the expected CRC
+#define BOOTLOADER_ERROR_BOOTLOAD_DELTA_CRC \
+  (BOOTLOADER_ERROR_BOOTLOAD_BASE | 0x08L)
 
 /** @} addtogroup BootloadError */
 
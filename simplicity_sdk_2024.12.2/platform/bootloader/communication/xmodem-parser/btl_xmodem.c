@@ -29,25 +29,33 @@ void xmodem_reset(void)
   started = false;
 }
 
-int32_t xmodem_parsePacket(const XmodemPacket_t *packet, uint8_t *response)
+// Parse a packet given its first three bytes (header, packet number and its
+// complement), its payload and its CRC, which need not be adjacent
+static int32_t parsePacket(const uint8_t start[],
+                           const uint8_t data[],
+                           const uint8_t crc[],
+                           uint8_t       *response)
 {
   uint16_t crc16 = 0;
 
-  switch (packet->header) {
+  switch (start[0]) {
     case XMODEM_CMD_SOH:
+#if defined(BTL_XMODEM_1K_ENABLE) && (BTL_XMODEM_1K_ENABLE == 1)
+    case XMODEM_CMD_STX:
+#endif
       // Packet number must start at 1, and must monotonically increase
       if (!started) {
-        if (packet->packetNumber != 0x01) {
+        if (start[1] != 0x01) {
           *response = XMODEM_CMD_NAK;
           return BOOTLOADER_ERROR_XMODEM_PKTNUM;
         }
         started = true;
       } else {
-        if (packet->packetNumber == packetNumber) {
+        if (start[1] == packetNumber) {
           BTL_DEBUG_PRINTLN("replay");
           *response = XMODEM_CMD_ACK;
           return BOOTLOADER_ERROR_XMODEM_PKTDUP;
-        } else if (packet->packetNumber != (uint8_t)(packetNumber + 1)) {
+        } else if (start[1] != (uint8_t)(packetNumber + 1)) {
           BTL_DEBUG_PRINTLN("ooseq");
           *response = XMODEM_CMD_NAK;
           return BOOTLOADER_ERROR_XMODEM_PKTSEQ;
@@ -55,28 +63,32 @@ int32_t xmodem_parsePacket(const XmodemPacket_t *packet, uint8_t *response)
       }
 
       // Byte 3 is the two's complement of the packet number in the second byte
-      if (packet->packetNumber + packet->packetNumberC != 0xFF) {
+      if (start[1] + start[2] != 0xFF) {
         BTL_DEBUG_PRINTLN("compl");
         *response = XMODEM_CMD_NAK;
         return BOOTLOADER_ERROR_XMODEM_PKTNUM;
       }
 
-      // Bytes 132-133 contain a 16-bit CRC over the data bytes
-      crc16 = btl_crc16Stream(packet->data, XMODEM_DATA_SIZE, crc16);
+      // The last two bytes contain a 16-bit CRC over the data bytes
+      BTL_PROFILE_BEGIN(XMODEM_CRC);
+      crc16 = btl_crc16Stream(data,
+                              xmodem_getDataSize(start[0]),
+                              crc16);
+      BTL_PROFILE_END(XMODEM_CRC, xmodem_getDataSize(start[0]));
 
-      if (((crc16 >> 8) & 0xFF) != packet->crcH) {
+      if (((crc16 >> 8) & 0xFF) != crc[0]) {
         BTL_DEBUG_PRINTLN("crch");
         *response = XMODEM_CMD_NAK;
         return BOOTLOADER_ERROR_XMODEM_CRCH;
       }
 
-      if ((crc16 & 0xFF) != packet->crcL) {
+      if ((crc16 & 0xFF) != crc[1]) {
         BTL_DEBUG_PRINTLN("crcl");
         *response = XMODEM_CMD_NAK;
         return BOOTLOADER_ERROR_XMODEM_CRCL;
       }
 
-      packetNumber = packet->packetNumber;
+      packetNumber = start[1];
       *response = XMODEM_CMD_ACK;
       return BOOTLOADER_OK;
 
@@ -97,6 +109,23 @@ int32_t xmodem_parsePacket(const XmodemPacket_t *packet, uint8_t *response)
   }
 }
 
+int32_t xmodem_parsePacket(const XmodemPacket_t *packet, uint8_t *response)
+{
+  return parsePacket(&(packet->header),
+                     packet->data,
+                     &(packet->crcH),
+                     response);
+}
+
+int32_t xmodem_parseFrame(const uint8_t frame[], uint8_t *response)
+{
+  // The CRC directly follows the payload
+  return parsePacket(frame,
+                     &frame[3],
+                     &frame[3U + xmodem_getDataSize(frame[0])],
+                     response);
+}
+
 uint8_t xmodem_getLastPacketNumber(void)
 {
   return packetNumber;
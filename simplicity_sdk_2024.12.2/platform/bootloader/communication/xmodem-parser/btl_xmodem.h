@@ -22,6 +22,7 @@
 #include <stddef.h>
 
 #include "core/btl_util.h"
+#include "btl_xmodem_config.h"
 
 MISRAC_DISABLE
 #include "em_common.h"
@@ -38,11 +39,22 @@ MISRAC_ENABLE
  * @{
  * @brief Parser for XMODEM packets
  * @details
- *   XMODEM packet parser supporting XMODEM-CRC.
+ *   XMODEM packet parser supporting XMODEM-CRC and, if enabled,
+ *   XMODEM-1K (STX framed 1024-byte blocks).
  ******************************************************************************/
 
 /// Size of an XMODEM packet
 #define XMODEM_DATA_SIZE              128
+/// Size of an XMODEM-1K packet
+#define XMODEM_1K_DATA_SIZE           1024
+
+#if defined(BTL_XMODEM_1K_ENABLE) && (BTL_XMODEM_1K_ENABLE == 1)
+/// Size of the largest XMODEM packet accepted by the parser
+#define XMODEM_MAX_DATA_SIZE          XMODEM_1K_DATA_SIZE
+#else
+/// Size of the largest XMODEM packet accepted by the parser
+#define XMODEM_MAX_DATA_SIZE          XMODEM_DATA_SIZE
+#endif
 
 /***************************************************************************//**
  * @addtogroup Commands
@@ -51,6 +63,8 @@ MISRAC_ENABLE
 
 /// Start of Header
 #define XMODEM_CMD_SOH                (0x01)
+/// Start of Text (XMODEM-1K header)
+#define XMODEM_CMD_STX                (0x02)
 /// End of Transmission
 #define XMODEM_CMD_EOT                (0x04)
 /// Acknowledge
@@ -63,21 +77,48 @@ MISRAC_ENABLE
 #define XMODEM_CMD_CTRL_C             (0x03)
 /// ASCII 'C'
 #define XMODEM_CMD_C                  (0x43)
+/// ASCII 'G', requests a streaming (XMODEM-G) transfer
+#define XMODEM_CMD_G                  (0x47)
 
 /** @} addtogroup Commands */
 
 SL_PACK_START(1)
 /// XMODEM packet
+///
+/// The payload is sized for the largest packet accepted. The CRC of a packet
+/// is always stored in crcH/crcL, also when the payload is shorter than
+/// @ref XMODEM_MAX_DATA_SIZE.
 typedef struct {
-  uint8_t header;                   ///< Packet header (@ref XMODEM_CMD_SOH)
-  uint8_t packetNumber;             ///< Packet sequence number
-  uint8_t packetNumberC;            ///< Complement of packet sequence number
-  uint8_t data[XMODEM_DATA_SIZE];   ///< Payload
-  uint8_t crcH;                     ///< CRC high byte
-  uint8_t crcL;                     ///< CRC low byte
+  uint8_t header;                     ///< Packet header (@ref XMODEM_CMD_SOH or @ref XMODEM_CMD_STX)
+  uint8_t packetNumber;               ///< Packet sequence number
+  uint8_t packetNumberC;              ///< Complement of packet sequence number
+  uint8_t data[XMODEM_MAX_DATA_SIZE]; ///< Payload
+  uint8_t crcH;                       ///< CRC high byte
+  uint8_t crcL;                       ///< CRC low byte
 } SL_ATTRIBUTE_PACKED XmodemPacket_t;
 SL_PACK_END()
 
+/***************************************************************************//**
+ * Get the payload size of an XMODEM packet based on its header.
+ *
+ * @param[in] header The XMODEM packet header byte.
+ *
+ * @return Payload size in bytes, or 0 if the header does not start a data
+ *         packet.
+ ******************************************************************************/
+__STATIC_INLINE size_t xmodem_getDataSize(uint8_t header)
+{
+  if (header == XMODEM_CMD_SOH) {
+    return XMODEM_DATA_SIZE;
+  }
+#if defined(BTL_XMODEM_1K_ENABLE) && (BTL_XMODEM_1K_ENABLE == 1)
+  if (header == XMODEM_CMD_STX) {
+    return XMODEM_1K_DATA_SIZE;
+  }
+#endif
+  return 0U;
+}
+
 /***************************************************************************//**
  * Reset the XMODEM parser to start a new transfer.
  ******************************************************************************/
@@ -93,6 +134,20 @@ void xmodem_reset(void);
  ******************************************************************************/
 int32_t xmodem_parsePacket(const XmodemPacket_t *packet, uint8_t *response);
 
+/***************************************************************************//**
+ * Parse an XMODEM packet as received on the wire.
+ *
+ * Unlike @ref XmodemPacket_t, the CRC directly follows the payload, so
+ * packets can be parsed where they were received.
+ *
+ * @param[in] frame The XMODEM packet, starting with the header byte. Data
+ *                  packets must be complete.
+ * @param[out] response The XMODEM response to the parsed frame
+ *
+ * @return @ref BOOTLOADER_OK on success, else error code
+ ******************************************************************************/
+int32_t xmodem_parseFrame(const uint8_t frame[], uint8_t *response);
+
 /***************************************************************************//**
  * Return the packet number of the last packet that was successfully parsed.
  *
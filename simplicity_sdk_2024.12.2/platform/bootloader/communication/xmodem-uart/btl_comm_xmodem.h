@@ -31,6 +31,7 @@ MISRAC_ENABLE
 #endif
 
 #include "communication/xmodem-parser/btl_xmodem.h"
+#include "debug/btl_debug.h"
 
 /***************************************************************************//**
  * @addtogroup Components
@@ -64,6 +65,19 @@ typedef enum {
   COMPLETE,
   CONFIRM_ERASE_NVM,
   ERASE_NVM,
+#if defined(BTL_XMODEM_BAUD_SWITCH_ENABLE) && (BTL_XMODEM_BAUD_SWITCH_ENABLE == 1)
+  SWITCH_BAUD_RATE,
+#endif
+#if defined(SL_DEBUG_PROFILE) && (SL_DEBUG_PROFILE == 1)
+  DUMP_PROFILE,
+#endif
+#if defined(BTL_XMODEM_RESUME_ENABLE) && (BTL_XMODEM_RESUME_ENABLE == 1)
+  RESUME_TRANSFER,
+#endif
+#if defined(BTL_XMODEM_READBACK_ENABLE) && (BTL_XMODEM_READBACK_ENABLE == 1)
+  READ_FLASH,
+  FLASH_MANIFEST,
+#endif
 } XmodemState_t;
 
 /** @endcond */
@@ -21,10 +21,28 @@
 
 #include "btl_comm_xmodem.h"
 #include "btl_xmodem_config.h"
+#include "btl_uart_driver_cfg.h"
 #include "driver/btl_serial_driver.h"
 #include "driver/btl_driver_delay.h"
 
 #include "core/flash/btl_internal_flash.h"
+#include "security/btl_crc32.h"
+#if defined(BTL_XMODEM_READBACK_ENABLE) && (BTL_XMODEM_READBACK_ENABLE == 1)
+#include "security/btl_crc16.h"
+#if defined(BTL_XMODEM_MANIFEST_SHA256) && (BTL_XMODEM_MANIFEST_SHA256 == 1)
+#include "security/btl_security_sha256.h"
+#include "security/btl_security_types.h"
+#endif
+#endif
+#if defined(BTL_PARSER_SUPPORT_LZMA)
+#include "parser/compression/btl_decompress_lzma.h"
+#endif
+#if defined(BTL_PARSER_SUPPORT_LZ4)
+#include "parser/compression/btl_decompress_lz4.h"
+#endif
+#if defined(BOOTLOADER_DELTA_OTW) && (BOOTLOADER_DELTA_OTW == 1)
+#include "core/btl_delta.h"
+#endif
 
 #if defined(BOOTLOADER_NONSECURE)
 // NS headers
@@ -47,6 +65,57 @@
 #error  "BTL_XMODEM_IDLE_TIMEOUT undefined."
 #endif
 
+#define XMODEM_STR(x) STRINGIZE(x)
+
+// Start of NVM3 of the controller firmware, see ERASE_NVM. NVM3 of the end
+// device firmware starts above it, at 0x08076000.
+#define XMODEM_NVM_ADDRESS  0x08074000UL
+
+// GBL decryption key in the ZPAL token page, see ERASE_NVM. Flash read back
+// by the host returns it as erased flash.
+#define XMODEM_GBL_KEY_ADDRESS  0x0807E284UL
+#define XMODEM_GBL_KEY_SIZE     20UL
+
+#if defined(BTL_XMODEM_RESUME_ENABLE) && (BTL_XMODEM_RESUME_ENABLE == 1)
+#if defined(BOOTLOADER_NONSECURE)
+#error "Resumable upload is not supported by the non-secure bootloader"
+#endif
+#if ((BTL_XMODEM_RESUME_ADDRESS % FLASH_PAGE_SIZE) != 0) \
+  || ((BTL_XMODEM_RESUME_SIZE % FLASH_PAGE_SIZE) != 0)
+#error "The checkpoint area must start and end at a flash page boundary"
+#endif
+#if ((BTL_XMODEM_RESUME_ADDRESS + BTL_XMODEM_RESUME_SIZE) > XMODEM_NVM_ADDRESS)
+#error "The checkpoint area must end below NVM3"
+#endif
+#if (BTL_XMODEM_RESUME_ADDRESS <= BTL_APPLICATION_BASE)
+#error "The checkpoint area must start above the application base"
+#endif
+// The delta scratch region is part of the application space, so this also
+// keeps it clear of the checkpoint area
+#if (BTL_XMODEM_RESUME_ADDRESS < (BTL_APPLICATION_BASE + BTL_APP_SPACE_SIZE)) \
+  && ((BTL_XMODEM_RESUME_ADDRESS + BTL_XMODEM_RESUME_SIZE) > BTL_APPLICATION_BASE)
+#error "The checkpoint area overlaps the application space"
+#endif
+#if defined(BTL_PARSER_SUPPORT_LZMA)
+// The checkpoint holds the probability model counters, the dictionary and the
+// 512 byte input buffer of the LZMA decompressor. The rest of 3 KiB is left
+// for the header and the parser, decryption, authentication and delta
+// contexts.
+#if (((LZMA_COUNTER_SIZE_KB) + (LZMA_DICT_SIZE_KB) + 3UL) * 1024UL) \
+  > BTL_XMODEM_RESUME_SIZE
+#error "The checkpoint area is too small for the LZMA decompressor limits"
+#endif
+#endif
+
+#define XMODEM_CHECKPOINT_MAGIC        0x50434D58UL
+#define XMODEM_CHECKPOINT_MAX_REGIONS  20U
+#endif
+
+#if defined(BTL_XMODEM_FAST_NAK_ENABLE) && (BTL_XMODEM_FAST_NAK_ENABLE == 1)
+// Time allowed for the rest of a packet on top of its transmission time
+#define XMODEM_PACKET_TIMEOUT_MARGIN_MS  100UL
+#endif
+
 // -----------------------------------------------------------------------------
 // Static consts
 
@@ -56,39 +125,175 @@ static const char transferAbortedStr[] = "\r\nSerial upload aborted\r\n";
 static const char xmodemError[] = "\r\nblock error 0x";
 static const char fileError[] = "\r\nfile error 0x";
 static const char bootError[] = "\r\nFailed to boot\r\n";
+#if defined(BTL_XMODEM_BAUD_SWITCH_ENABLE) && (BTL_XMODEM_BAUD_SWITCH_ENABLE == 1)
+static const char baudSwitchStr[] =
+  "\r\nswitching to " XMODEM_STR(BTL_XMODEM_BAUD_SWITCH_RATE) " baud\r\n";
+#endif
+#if defined(SL_DEBUG_PROFILE) && (SL_DEBUG_PROFILE == 1)
+static const char profileHeaderStr[] = "\r\nstage calls bytes cycles\r\n";
+static const char * const profileStageNames[BTL_PROFILE_STAGE_COUNT] = {
+  [BTL_PROFILE_STAGE_UART_WAIT]      = "uart_wait",
+  [BTL_PROFILE_STAGE_XMODEM_CRC]     = "xmodem_crc",
+  [BTL_PROFILE_STAGE_GBL_CRC32]      = "gbl_crc32",
+  [BTL_PROFILE_STAGE_GBL_COPY]       = "gbl_copy",
+  [BTL_PROFILE_STAGE_SHA_UPDATE]     = "sha_update",
+  [BTL_PROFILE_STAGE_AES_CTR]        = "aes_ctr",
+  [BTL_PROFILE_STAGE_LZMA_DECODE]    = "lzma_decode",
+  [BTL_PROFILE_STAGE_LZ4_DECODE]     = "lz4_decode",
+  [BTL_PROFILE_STAGE_FLASH_CALLBACK] = "flash_callback",
+  [BTL_PROFILE_STAGE_PAGE_ERASE]     = "page_erase",
+  [BTL_PROFILE_STAGE_WORD_WRITE]     = "word_write",
+};
+#endif
+#if defined(BTL_XMODEM_RESUME_ENABLE) && (BTL_XMODEM_RESUME_ENABLE == 1)
+static const char resumeStr[] = "\r\nresume at 0x";
+static const char noCheckpointStr[] = "\r\nno checkpoint\r\n";
+#endif
+#if defined(BTL_XMODEM_READBACK_ENABLE) && (BTL_XMODEM_READBACK_ENABLE == 1)
+static const char addressPromptStr[] = "\r\naddress > ";
+static const char lengthPromptStr[] = "\r\nlength > ";
+static const char invalidRangeStr[] = "\r\ninvalid range\r\n";
+static const char downloadInitStr[] = "\r\nbegin download\r\n";
+static const char downloadCompleteStr[] = "\r\nSerial download complete\r\n";
+static const char downloadAbortedStr[] = "\r\nSerial download aborted\r\n";
+#endif
+
+// -----------------------------------------------------------------------------
+// Local types
+
+#if defined(BTL_XMODEM_RESUME_ENABLE) && (BTL_XMODEM_RESUME_ENABLE == 1)
+// Start of the checkpoint area. The magic is programmed last, so a checkpoint
+// interrupted by a reset is never taken for a valid one.
+typedef struct {
+  uint32_t magic;       ///< XMODEM_CHECKPOINT_MAGIC
+  uint32_t length;      ///< Number of state bytes following this header
+  uint32_t stateCrc;    ///< CRC32 of the state bytes
+  uint32_t gblOffset;   ///< Offset into the GBL file to resume from
+  uint32_t flashStart;  ///< Start of the flash programmed before the checkpoint
+  uint32_t flashEnd;    ///< End of the flash programmed before the checkpoint
+  uint32_t flashCrc;    ///< CRC32 of the flash programmed before the checkpoint
+  uint32_t deltaStart;  ///< Start of the delta image rebuilt before the checkpoint
+  uint32_t deltaEnd;    ///< End of the delta image rebuilt before the checkpoint
+  uint32_t deltaCrc;    ///< CRC32 of the delta image rebuilt before the checkpoint
+} XmodemCheckpoint_t;
+
+// A piece of transfer state saved in the checkpoint
+typedef struct {
+  void    *data;
+  size_t  length;
+} XmodemStateRegion_t;
+#endif
+
+// -----------------------------------------------------------------------------
+// Static variables
+
+#if defined(BTL_XMODEM_STREAMING_ENABLE) && (BTL_XMODEM_STREAMING_ENABLE == 1)
+// Whether the current transfer was requested in streaming (XMODEM-G) mode
+static bool streamingTransfer = false;
+#endif
+
+#if defined(BTL_XMODEM_DIRECT_UPLOAD_ENABLE) && (BTL_XMODEM_DIRECT_UPLOAD_ENABLE == 1)
+// Whether the host started the current transfer without a menu selection
+static bool directTransfer = false;
+#endif
+
+#if defined(BTL_XMODEM_BAUD_SWITCH_ENABLE) && (BTL_XMODEM_BAUD_SWITCH_ENABLE == 1)
+// Whether the UART runs at the high speed baud rate
+static bool baudSwitched = false;
+// Whether the default baud rate is restored if the next block fails
+static bool baudFallbackArmed = false;
+#endif
+
+#if defined(BTL_XMODEM_RESUME_ENABLE) && (BTL_XMODEM_RESUME_ENABLE == 1)
+// Offset into the GBL file of the next packet
+static uint32_t transferOffset = 0UL;
+// Offset from which the next checkpoint is saved
+static uint32_t nextCheckpointOffset = 0UL;
+// Collects checkpoint data into whole words for programming
+SL_ALIGN(4)
+static uint8_t checkpointBuffer[256] SL_ATTRIBUTE_ALIGN(4);
+static size_t checkpointBufferLength = 0U;
+#endif
 
 // -----------------------------------------------------------------------------
 // Static local functions
 
 static int32_t sendPacket(uint8_t packet)
 {
-  int32_t ret;
-  ret = uart_sendByte(packet);
+  const uint8_t buf[3] = { packet, packet, packet };
 
-  if (packet == XMODEM_CMD_CAN) {
-    // If packet is CAN, send three times
-    uart_sendByte(packet);
-    uart_sendByte(packet);
+  // The previous response has normally been sent long ago
+  while (!uart_isTxIdle()) {
+    // Do nothing
   }
 
-  return ret;
+  // If packet is CAN, send three times. The response is sent in the
+  // background, while the next packet is received.
+  return uart_sendBuffer(buf, (packet == XMODEM_CMD_CAN) ? 3U : 1U, false);
+}
+
+// Milliseconds to wait for length bytes of a packet
+static uint32_t packetTimeout(size_t length)
+{
+#if defined(BTL_XMODEM_FAST_NAK_ENABLE) && (BTL_XMODEM_FAST_NAK_ENABLE == 1)
+  // Transmission time of 10 bit characters at the current baud rate
+  return ((length * 10000UL) / uart_getBaudRate())
+         + XMODEM_PACKET_TIMEOUT_MARGIN_MS;
+#else
+  (void)length;
+  return 3000;
+#endif
+}
+
+#if defined(BTL_XMODEM_FAST_NAK_ENABLE) && (BTL_XMODEM_FAST_NAK_ENABLE == 1)
+// Microseconds the receive line must be idle to end a packet
+static uint32_t rxGapTime(void)
+{
+  return SL_MAX((BTL_XMODEM_RX_GAP_CHARS * 10000000UL) / uart_getBaudRate(),
+                BTL_XMODEM_RX_GAP_MIN_US);
 }
+#endif
 
-static int32_t receivePacket(XmodemPacket_t *packet)
+// Receive the rest of a packet, once its first byte is available
+static int32_t receiveFrame(XmodemPacket_t *packet, uint8_t **frame)
 {
   int32_t ret = BOOTLOADER_OK;
   size_t requestedBytes;
   size_t receivedBytes;
+  size_t dataSize;
   uint8_t *buf = (uint8_t *)packet;
+  uint8_t *span;
+#if defined(BTL_XMODEM_STREAMING_ENABLE) && (BTL_XMODEM_STREAMING_ENABLE == 1)
+  // Packets held in the receive buffer reduce the room for the ones that
+  // follow, which the sender does not wait for in streaming mode
+  const bool inPlace = !streamingTransfer;
+#else
+  const bool inPlace = true;
+#endif
 
-  // Wait for bytes to be available in RX buffer
-  delay_milliseconds(3000, false);
-  while (uart_getRxAvailableBytes() == 0) {
-    if (delay_expired()) {
+  // The header determines the size of the packet
+  (void)uart_getRxSpan(&span);
+  dataSize = xmodem_getDataSize(span[0]);
+  if (inPlace && (dataSize != 0U)) {
+    ret = uart_receiveSpan(frame,
+                           3U + dataSize + 2U,
+                           packetTimeout(3U + dataSize + 2U));
+    if (ret == BOOTLOADER_OK) {
+      packet->header = (*frame)[0];
+      return BOOTLOADER_OK;
+    }
+    *frame = NULL;
+    if (ret != BOOTLOADER_ERROR_UART_ARGUMENT) {
+      // Didn't receive entire packet in time; drop the partial packet and
+      // bail
+      (void)uart_flush(false, true);
       return BOOTLOADER_ERROR_COMMUNICATION_ERROR;
     }
+    // The packet wraps around the end of the receive buffer; copy it
   }
 
+  (void)memset(packet, 0, sizeof(XmodemPacket_t));
+
   // Read the first byte
   requestedBytes = 1;
   uart_receiveBuffer(buf,
@@ -97,41 +302,130 @@ static int32_t receivePacket(XmodemPacket_t *packet)
                      true,
                      1000);
 
-  if (packet->header != XMODEM_CMD_SOH) {
-    // All packets except XMODEM_CMD_SOH are single-byte
+  dataSize = xmodem_getDataSize(packet->header);
+  if (dataSize == 0U) {
+    // All packets except XMODEM_CMD_SOH and XMODEM_CMD_STX are single-byte
+#if defined(BTL_XMODEM_FAST_NAK_ENABLE) && (BTL_XMODEM_FAST_NAK_ENABLE == 1)
+    if (packet->header != XMODEM_CMD_CAN) {
+      // Commands other than CAN are sent on their own. Data following one
+      // within the idle gap means the header of a data packet was lost, and
+      // the byte read is its packet number: drop the rest of the packet once
+      // the sender stops, so that it is sent again rather than taken as a
+      // command. The idle timer only starts at the end of the next byte.
+      (void)uart_receiveBuffer(buf + 1,
+                               1U,
+                               &receivedBytes,
+                               true,
+                               (rxGapTime() / 1000UL) + 1UL);
+      if (receivedBytes != 0U) {
+        (void)uart_receiveBuffer(buf + 1,
+                                 sizeof(XmodemPacket_t) - 1U,
+                                 &receivedBytes,
+                                 true,
+                                 packetTimeout(sizeof(XmodemPacket_t)));
+        return BOOTLOADER_ERROR_COMMUNICATION_ERROR;
+      }
+    }
+#endif
     return BOOTLOADER_OK;
   }
 
-  requestedBytes = sizeof(XmodemPacket_t) - 1;
+  // Read packet number, its complement and the payload
+  requestedBytes = 2U + dataSize;
   ret = uart_receiveBuffer(buf + 1,
                            requestedBytes,
                            &receivedBytes,
                            true,
-                           3000);
+                           packetTimeout(requestedBytes + 2U));
+
+  if (receivedBytes == requestedBytes) {
+    // The CRC follows the payload, which may be shorter than the packet buffer
+    requestedBytes = 2U;
+    ret = uart_receiveBuffer(&(packet->crcH),
+                             requestedBytes,
+                             &receivedBytes,
+                             true,
+                             packetTimeout(requestedBytes));
+  }
 
   if (receivedBytes != requestedBytes) {
     BTL_DEBUG_PRINT("Recvd ");
     BTL_DEBUG_PRINT_WORD_HEX(receivedBytes);
     BTL_DEBUG_PRINT_LF();
-    // Didn't receive entire packet within 3000 ms; bail
+    // Didn't receive entire packet in time; bail
     return BOOTLOADER_ERROR_COMMUNICATION_ERROR;
   }
 
   return ret;
 }
 
+// Receive a packet. Data packets are left in the UART receive buffer where
+// possible; frame then points to the packet, which must be released with
+// uart_releaseRx once processed. Otherwise, frame is NULL and the packet is
+// copied to packet.
+static int32_t receivePacket(XmodemPacket_t *packet, uint8_t **frame)
+{
+  int32_t ret;
+
+  *frame = NULL;
+
+  // Wait for bytes to be available in RX buffer
+  delay_milliseconds(3000, false);
+  while (uart_getRxAvailableBytes() == 0) {
+    // Keep a background flash write moving across page boundaries
+    (void)flash_isWriteBusy();
+    if (delay_expired()) {
+      return BOOTLOADER_ERROR_COMMUNICATION_ERROR;
+    }
+  }
+
+#if defined(BTL_XMODEM_FAST_NAK_ENABLE) && (BTL_XMODEM_FAST_NAK_ENABLE == 1)
+  // Give up on the packet as soon as the sender stops in the middle of it
+  uart_setRxIdleTimeout(rxGapTime());
+#endif
+
+  ret = receiveFrame(packet, frame);
+
+#if defined(BTL_XMODEM_FAST_NAK_ENABLE) && (BTL_XMODEM_FAST_NAK_ENABLE == 1)
+  uart_setRxIdleTimeout(0);
+#endif
+
+  return ret;
+}
+
 static XmodemState_t getAction(bool confirm_erase)
 {
   uint8_t c;
   XmodemState_t state;
-  int ret = uart_receiveByteTimeout(&c, 1000UL);
+  int ret;
 
+#if defined(BTL_XMODEM_DIRECT_UPLOAD_ENABLE) && (BTL_XMODEM_DIRECT_UPLOAD_ENABLE == 1)
+  uint8_t *input;
+
+  // Look at the input before reading it, so that a packet sent without a
+  // menu selection is left in the receive buffer as a whole
+  if (uart_receiveSpan(&input, 1U, 1000UL) != BOOTLOADER_OK) {
+    return IDLE;
+  }
+  if (xmodem_getDataSize(input[0]) != 0U) {
+#if defined(BTL_XMODEM_STREAMING_ENABLE) && (BTL_XMODEM_STREAMING_ENABLE == 1)
+    streamingTransfer = false;
+#endif
+    directTransfer = true;
+    return INIT_TRANSFER;
+  }
+#endif
+
+  ret = uart_receiveByteTimeout(&c, 1000UL);
   if (ret != BOOTLOADER_OK) {
     return IDLE;
   }
 
   switch (c) {
     case '1':
+#if defined(BTL_XMODEM_STREAMING_ENABLE) && (BTL_XMODEM_STREAMING_ENABLE == 1)
+      streamingTransfer = false;
+#endif
       state = INIT_TRANSFER;
       break;
     case '2':
@@ -146,6 +440,52 @@ static XmodemState_t getAction(bool confirm_erase)
       return CONFIRM_ERASE_NVM;
       break;
     }
+#if defined(BTL_XMODEM_STREAMING_ENABLE) && (BTL_XMODEM_STREAMING_ENABLE == 1)
+    case '5':
+      streamingTransfer = true;
+      state = INIT_TRANSFER;
+      break;
+#endif
+#if defined(BTL_XMODEM_BAUD_SWITCH_ENABLE) && (BTL_XMODEM_BAUD_SWITCH_ENABLE == 1)
+    case '6':
+#if defined(BTL_XMODEM_STREAMING_ENABLE) && (BTL_XMODEM_STREAMING_ENABLE == 1)
+      streamingTransfer = false;
+#endif
+      state = SWITCH_BAUD_RATE;
+      break;
+#endif
+#if defined(SL_DEBUG_PROFILE) && (SL_DEBUG_PROFILE == 1)
+    case '7':
+      state = DUMP_PROFILE;
+      break;
+#endif
+#if defined(BTL_XMODEM_RESUME_ENABLE) && (BTL_XMODEM_RESUME_ENABLE == 1)
+    case '8':
+#if defined(BTL_XMODEM_STREAMING_ENABLE) && (BTL_XMODEM_STREAMING_ENABLE == 1)
+      streamingTransfer = false;
+#endif
+      state = RESUME_TRANSFER;
+      break;
+#endif
+#if defined(BTL_XMODEM_READBACK_ENABLE) && (BTL_XMODEM_READBACK_ENABLE == 1)
+    case '9':
+      state = READ_FLASH;
+      break;
+    case '0':
+      state = FLASH_MANIFEST;
+      break;
+#endif
+#if defined(BTL_XMODEM_DIRECT_UPLOAD_ENABLE) && (BTL_XMODEM_DIRECT_UPLOAD_ENABLE == 1)
+    case XMODEM_CMD_C:
+      // The host waits for the transfer to be requested; drop any repeats
+      (void)uart_flush(false, true);
+#if defined(BTL_XMODEM_STREAMING_ENABLE) && (BTL_XMODEM_STREAMING_ENABLE == 1)
+      streamingTransfer = false;
+#endif
+      directTransfer = true;
+      state = INIT_TRANSFER;
+      break;
+#endif
     case 'y':
       if (confirm_erase) {
         return ERASE_NVM;
@@ -158,14 +498,529 @@ static XmodemState_t getAction(bool confirm_erase)
   return state;
 }
 
+#if defined(BTL_XMODEM_BAUD_SWITCH_ENABLE) && (BTL_XMODEM_BAUD_SWITCH_ENABLE == 1)
+static void restoreBaudRate(void)
+{
+  if (baudSwitched) {
+    uart_setBaudRate(SL_SERIAL_UART_BAUD_RATE);
+    baudSwitched = false;
+  }
+  baudFallbackArmed = false;
+}
+#endif
+
 __STATIC_INLINE uint8_t nibbleToHex(uint8_t nibble)
 {
   return (nibble > 9) ? (nibble - 10 + 'A') : (nibble + '0');
 }
 
+#if (defined(SL_DEBUG_PROFILE) && (SL_DEBUG_PROFILE == 1))                \
+  || (defined(BTL_XMODEM_RESUME_ENABLE) && (BTL_XMODEM_RESUME_ENABLE == 1)) \
+  || (defined(BTL_XMODEM_READBACK_ENABLE) && (BTL_XMODEM_READBACK_ENABLE == 1))
+static void sendHexWord(uint32_t word)
+{
+  for (int shift = 28; shift >= 0; shift -= 4) {
+    uart_sendByte(nibbleToHex((word >> shift) & 0x0F));
+  }
+}
+#endif
+
+#if defined(SL_DEBUG_PROFILE) && (SL_DEBUG_PROFILE == 1)
+
+// One line per stage with the call count, byte count and cycle count in hex,
+// separated by spaces, so the table can be parsed by a host script
+static void dumpProfile(void)
+{
+  uart_sendBuffer((uint8_t *)profileHeaderStr,
+                  sizeof(profileHeaderStr) - 1U,
+                  true);
+  for (size_t i = 0; i < BTL_PROFILE_STAGE_COUNT; i++) {
+    const BtlProfileStats_t *stats = btl_profileGetStats((BtlProfileStage_t)i);
+    uart_sendBuffer((const uint8_t *)profileStageNames[i],
+                    strlen(profileStageNames[i]),
+                    true);
+    uart_sendByte(' ');
+    sendHexWord(stats->calls);
+    uart_sendByte(' ');
+    sendHexWord(stats->bytes);
+    uart_sendByte(' ');
+    sendHexWord((uint32_t)(stats->cycles >> 32));
+    sendHexWord((uint32_t)stats->cycles);
+    uart_sendByte('\r');
+    uart_sendByte('\n');
+  }
+}
+#endif
+
+#if defined(BTL_XMODEM_RESUME_ENABLE) && (BTL_XMODEM_RESUME_ENABLE == 1)
+// Collect the transfer state into regions, in the order it is saved
+static size_t getStateRegions(XmodemStateRegion_t regions[],
+                              ImageProperties_t   *imageProps,
+                              ParserContext_t     *parserContext,
+                              DecryptContext_t    *decryptContext,
+                              AuthContext_t       *authContext)
+{
+  size_t count = 0U;
+
+  regions[count++] = (XmodemStateRegion_t){ imageProps, sizeof(*imageProps) };
+  regions[count++] = (XmodemStateRegion_t){ parserContext, sizeof(*parserContext) };
+  regions[count++] = (XmodemStateRegion_t){ decryptContext, sizeof(*decryptContext) };
+  regions[count++] = (XmodemStateRegion_t){ authContext, sizeof(*authContext) };
+
+#if defined(BOOTLOADER_DELTA_OTW) && (BOOTLOADER_DELTA_OTW == 1)
+  for (size_t index = 0U; count < XMODEM_CHECKPOINT_MAX_REGIONS; index++) {
+    size_t length;
+    void *data = delta_getState(index, &length);
+    if (data == NULL) {
+      break;
+    }
+    regions[count++] = (XmodemStateRegion_t){ data, length };
+  }
+#endif
+#if defined(BTL_PARSER_SUPPORT_LZMA)
+  for (size_t index = 0U; count < XMODEM_CHECKPOINT_MAX_REGIONS; index++) {
+    size_t length;
+    void *data = gbl_lzmaGetState(index, &length);
+    if (data == NULL) {
+      break;
+    }
+    regions[count++] = (XmodemStateRegion_t){ data, length };
+  }
+#endif
+#if defined(BTL_PARSER_SUPPORT_LZ4)
+  for (size_t index = 0U; count < XMODEM_CHECKPOINT_MAX_REGIONS; index++) {
+    size_t length;
+    void *data = gbl_lz4GetState(index, &length);
+    if (data == NULL) {
+      break;
+    }
+    regions[count++] = (XmodemStateRegion_t){ data, length };
+  }
+#endif
+
+  return count;
+}
+
+// Program any number of bytes, a buffer full at a time
+static void writeCheckpointData(uint32_t      *address,
+                                const uint8_t *data,
+                                size_t        length)
+{
+  while (length > 0U) {
+    size_t chunk = SL_MIN(length,
+                          sizeof(checkpointBuffer) - checkpointBufferLength);
+    (void)memcpy(&checkpointBuffer[checkpointBufferLength], data, chunk);
+    checkpointBufferLength += chunk;
+    data += chunk;
+    length -= chunk;
+
+    if (checkpointBufferLength == sizeof(checkpointBuffer)) {
+      (void)flash_writeBuffer(*address, checkpointBuffer, sizeof(checkpointBuffer));
+      *address += sizeof(checkpointBuffer);
+      checkpointBufferLength = 0U;
+    }
+  }
+}
+
+// Program what is left in the checkpoint buffer, padded to a whole word
+static void flushCheckpointData(uint32_t *address)
+{
+  size_t length = (checkpointBufferLength + 3U) & ~3U;
+
+  if (length > 0U) {
+    (void)memset(&checkpointBuffer[checkpointBufferLength],
+                 0xFF,
+                 length - checkpointBufferLength);
+    (void)flash_writeBuffer(*address, checkpointBuffer, length);
+    *address += length;
+  }
+  checkpointBufferLength = 0U;
+}
+
+static void saveCheckpoint(ImageProperties_t *imageProps,
+                           ParserContext_t   *parserContext,
+                           DecryptContext_t  *decryptContext,
+                           AuthContext_t     *authContext)
+{
+  XmodemStateRegion_t regions[XMODEM_CHECKPOINT_MAX_REGIONS];
+  size_t count = getStateRegions(regions,
+                                 imageProps,
+                                 parserContext,
+                                 decryptContext,
+                                 authContext);
+  XmodemCheckpoint_t header = { 0 };
+  uint32_t address = BTL_XMODEM_RESUME_ADDRESS + sizeof(XmodemCheckpoint_t);
+
+  for (size_t i = 0U; i < count; i++) {
+    header.length += regions[i].length;
+  }
+  if ((sizeof(XmodemCheckpoint_t) + header.length) > BTL_XMODEM_RESUME_SIZE) {
+    BTL_DEBUG_PRINTLN("Checkpoint too large");
+    return;
+  }
+
+  // Flash has to hold everything the parser passed on before the checkpoint
+  bootload_getProgrammedRange(&header.flashStart, &header.flashEnd);
+  if ((header.flashStart < (BTL_XMODEM_RESUME_ADDRESS + BTL_XMODEM_RESUME_SIZE))
+      && (header.flashEnd > BTL_XMODEM_RESUME_ADDRESS)) {
+    BTL_DEBUG_PRINTLN("Image overlaps checkpoint");
+    return;
+  }
+  header.flashCrc = BTL_CRC32_START;
+  if (header.flashEnd > header.flashStart) {
+    header.flashCrc = btl_crc32Stream((const uint8_t *)header.flashStart,
+                                      header.flashEnd - header.flashStart,
+                                      BTL_CRC32_START);
+  }
+#if defined(BOOTLOADER_DELTA_OTW) && (BOOTLOADER_DELTA_OTW == 1)
+  // So does the scratch region, with the image rebuilt from a delta patch
+  delta_getScratchRange(&header.deltaStart, &header.deltaEnd);
+  header.deltaCrc = BTL_CRC32_START;
+  if (header.deltaEnd > header.deltaStart) {
+    header.deltaCrc = btl_crc32Stream((const uint8_t *)header.deltaStart,
+                                      header.deltaEnd - header.deltaStart,
+                                      BTL_CRC32_START);
+  }
+#endif
+
+  for (uint32_t pageAddress = BTL_XMODEM_RESUME_ADDRESS;
+       pageAddress < (address + header.length);
+       pageAddress += FLASH_PAGE_SIZE) {
+    (void)flash_erasePage(pageAddress);
+  }
+
+  header.stateCrc = BTL_CRC32_START;
+  for (size_t i = 0U; i < count; i++) {
+    header.stateCrc = btl_crc32Stream(regions[i].data,
+                                      regions[i].length,
+                                      header.stateCrc);
+    writeCheckpointData(&address, regions[i].data, regions[i].length);
+  }
+  flushCheckpointData(&address);
+
+  header.gblOffset = transferOffset;
+  header.magic = XMODEM_CHECKPOINT_MAGIC;
+  (void)flash_writeBuffer(BTL_XMODEM_RESUME_ADDRESS + sizeof(header.magic),
+                          &header.length,
+                          sizeof(XmodemCheckpoint_t) - sizeof(header.magic));
+  (void)flash_writeBuffer(BTL_XMODEM_RESUME_ADDRESS,
+                          &header.magic,
+                          sizeof(header.magic));
+
+  BTL_DEBUG_PRINT("Checkpoint ");
+  BTL_DEBUG_PRINT_WORD_HEX(transferOffset);
+  BTL_DEBUG_PRINT_LF();
+}
+
+static int32_t restoreCheckpoint(ImageProperties_t *imageProps,
+                                 ParserContext_t   *parserContext,
+                                 DecryptContext_t  *decryptContext,
+                                 AuthContext_t     *authContext)
+{
+  const XmodemCheckpoint_t *header =
+    (const XmodemCheckpoint_t *)BTL_XMODEM_RESUME_ADDRESS;
+  const uint8_t *state = (const uint8_t *)&header[1];
+  XmodemStateRegion_t regions[XMODEM_CHECKPOINT_MAX_REGIONS];
+  size_t count = getStateRegions(regions,
+                                 imageProps,
+                                 parserContext,
+                                 decryptContext,
+                                 authContext);
+  size_t length = 0U;
+
+  for (size_t i = 0U; i < count; i++) {
+    length += regions[i].length;
+  }
+  if ((header->magic != XMODEM_CHECKPOINT_MAGIC)
+      || (header->length != length)
+      || (btl_crc32Stream(state, length, BTL_CRC32_START) != header->stateCrc)) {
+    return BOOTLOADER_ERROR_PARSE_CONTEXT;
+  }
+
+  // The flash programmed before the checkpoint must not have changed since
+  if ((header->flashEnd > header->flashStart)
+      && (btl_crc32Stream((const uint8_t *)header->flashStart,
+                          header->flashEnd - header->flashStart,
+                          BTL_CRC32_START) != header->flashCrc)) {
+    BTL_DEBUG_PRINTLN("Checkpoint flash mismatch");
+    return BOOTLOADER_ERROR_PARSE_CONTEXT;
+  }
+  if ((header->deltaEnd > header->deltaStart)
+      && (btl_crc32Stream((const uint8_t *)header->deltaStart,
+                          header->deltaEnd - header->deltaStart,
+                          BTL_CRC32_START) != header->deltaCrc)) {
+    BTL_DEBUG_PRINTLN("Checkpoint delta mismatch");
+    return BOOTLOADER_ERROR_PARSE_CONTEXT;
+  }
+
+  for (size_t i = 0U; i < count; i++) {
+    (void)memcpy(regions[i].data, state, regions[i].length);
+    state += regions[i].length;
+  }
+  bootload_resumeProgrammedRange(header->flashStart, header->flashEnd);
+
+  transferOffset = header->gblOffset;
+  nextCheckpointOffset = transferOffset + BTL_XMODEM_RESUME_INTERVAL;
+  return BOOTLOADER_OK;
+}
+
+// Invalidate the checkpoint once the image it belongs to is complete
+static void clearCheckpoint(void)
+{
+  if (*(const uint32_t *)BTL_XMODEM_RESUME_ADDRESS != 0xFFFFFFFFUL) {
+    (void)flash_erasePage(BTL_XMODEM_RESUME_ADDRESS);
+  }
+}
+
+// Account for a parsed packet and save a checkpoint when one is due
+static void checkpointTransfer(size_t            length,
+                               ImageProperties_t *imageProps,
+                               ParserContext_t   *parserContext,
+                               DecryptContext_t  *decryptContext,
+                               AuthContext_t     *authContext)
+{
+  transferOffset += length;
+
+#if defined(BTL_XMODEM_STREAMING_ENABLE) && (BTL_XMODEM_STREAMING_ENABLE == 1)
+  if (streamingTransfer) {
+    // The sender does not wait while the checkpoint is programmed
+    return;
+  }
+#endif
+
+  if (transferOffset >= nextCheckpointOffset) {
+    saveCheckpoint(imageProps, parserContext, decryptContext, authContext);
+    nextCheckpointOffset = transferOffset + BTL_XMODEM_RESUME_INTERVAL;
+  }
+}
+#endif
+
+#if defined(BTL_XMODEM_READBACK_ENABLE) && (BTL_XMODEM_READBACK_ENABLE == 1)
+// Read a word entered as 8 hex digits
+static int32_t receiveHexWord(uint32_t *word)
+{
+  uint8_t c;
+
+  *word = 0UL;
+  for (size_t i = 0U; i < 8U; i++) {
+    if (uart_receiveByteTimeout(&c, 3000UL) != BOOTLOADER_OK) {
+      return BOOTLOADER_ERROR_COMMUNICATION_TIMEOUT;
+    }
+    if ((c >= '0') && (c <= '9')) {
+      c = c - '0';
+    } else if ((c >= 'A') && (c <= 'F')) {
+      c = c - 'A' + 10U;
+    } else if ((c >= 'a') && (c <= 'f')) {
+      c = c - 'a' + 10U;
+    } else {
+      return BOOTLOADER_ERROR_COMMUNICATION_ERROR;
+    }
+    *word = (*word << 4) | c;
+  }
+
+  return BOOTLOADER_OK;
+}
+
+// Prompt for a range of flash to read. The bootloader itself can't be read.
+static bool receiveFlashRange(uint32_t *address, uint32_t *length)
+{
+  uart_sendBuffer((uint8_t *)addressPromptStr,
+                  sizeof(addressPromptStr),
+                  true);
+  if (receiveHexWord(address) != BOOTLOADER_OK) {
+    return false;
+  }
+  uart_sendBuffer((uint8_t *)lengthPromptStr,
+                  sizeof(lengthPromptStr),
+                  true);
+  if (receiveHexWord(length) != BOOTLOADER_OK) {
+    return false;
+  }
+
+  if ((*length == 0UL)
+      || (*address < BTL_APPLICATION_BASE)
+      || (*address >= (FLASH_BASE + FLASH_SIZE))
+      || (*length > ((FLASH_BASE + FLASH_SIZE) - *address))) {
+    uart_sendBuffer((uint8_t *)invalidRangeStr,
+                    sizeof(invalidRangeStr),
+                    true);
+    return false;
+  }
+
+  return true;
+}
+
+// Copy a range of flash, with the GBL decryption key read as erased flash
+static void readFlash(uint32_t address, uint8_t *buffer, size_t length)
+{
+  uint32_t start = SL_MAX(address, XMODEM_GBL_KEY_ADDRESS);
+  uint32_t end = SL_MIN(address + length,
+                        XMODEM_GBL_KEY_ADDRESS + XMODEM_GBL_KEY_SIZE);
+
+  (void)memcpy(buffer, (const void *)address, length);
+  if (start < end) {
+    (void)memset(&buffer[start - address], 0xFF, end - start);
+  }
+}
+
+// Send data of any length, queueing each chunk while the previous one is sent
+static void sendData(const uint8_t *data, size_t length)
+{
+  while (length > 0U) {
+    size_t chunk = SL_MIN(length, SL_DRIVER_UART_TX_BUFFER_SIZE - 1U);
+    while (!uart_isTxIdle()) {
+      // Do nothing
+    }
+    (void)uart_sendBuffer(data, chunk, false);
+    data += chunk;
+    length -= chunk;
+  }
+}
+
+// Send a range of flash to the host as the XMODEM sender. Full XMODEM-1K
+// packets are sent where possible; the last packet is padded with 0xFF.
+static int32_t sendFlash(uint32_t address, uint32_t length)
+{
+  uint8_t chunk[SL_DRIVER_UART_TX_BUFFER_SIZE - 1U];
+  uint8_t header[3];
+  uint8_t crc[2];
+  uint8_t packetNumber = 1U;
+  uint8_t c = 0U;
+  int retries;
+
+  // Wait for the host to request the transfer
+  for (retries = 60; c != XMODEM_CMD_C; retries--) {
+    if (retries == 0) {
+      return BOOTLOADER_ERROR_COMMUNICATION_TIMEOUT;
+    }
+    if (uart_receiveByteTimeout(&c, 1000UL) != BOOTLOADER_OK) {
+      c = 0U;
+    } else if (c == XMODEM_CMD_CAN) {
+      return BOOTLOADER_ERROR_XMODEM_CANCEL;
+    }
+  }
+  // Drop repeated requests
+  (void)uart_flush(false, true);
+
+  while (length > 0U) {
+    size_t dataSize = (length >= XMODEM_MAX_DATA_SIZE)
+                      ? XMODEM_MAX_DATA_SIZE
+                      : XMODEM_DATA_SIZE;
+    size_t copySize = SL_MIN(length, dataSize);
+
+    header[0] = (dataSize == XMODEM_DATA_SIZE) ? XMODEM_CMD_SOH : XMODEM_CMD_STX;
+    header[1] = packetNumber;
+    header[2] = (uint8_t)~packetNumber;
+
+    for (retries = 10; ; retries--) {
+      uint16_t crc16 = 0x0000U;
+
+      if (retries == 0) {
+        sendPacket(XMODEM_CMD_CAN);
+        return BOOTLOADER_ERROR_COMMUNICATION_ERROR;
+      }
+
+      // The payload is read a chunk at a time, so that the key can be masked
+      // and the CRC computed as the chunks are sent
+      sendData(header, sizeof(header));
+      for (size_t offset = 0U; offset < dataSize; ) {
+        size_t chunkSize = SL_MIN(dataSize - offset, sizeof(chunk));
+
+        (void)memset(chunk, 0xFF, chunkSize);
+        if (offset < copySize) {
+          readFlash(address + offset,
+                    chunk,
+                    SL_MIN(chunkSize, copySize - offset));
+        }
+        crc16 = btl_crc16Stream(chunk, chunkSize, crc16);
+        sendData(chunk, chunkSize);
+        offset += chunkSize;
+      }
+      crc[0] = (uint8_t)(crc16 >> 8);
+      crc[1] = (uint8_t)(crc16 & 0xFFU);
+      sendData(crc, sizeof(crc));
+
+      if (uart_receiveByteTimeout(&c, 3000UL) != BOOTLOADER_OK) {
+        // No response; send the packet again
+        continue;
+      }
+      if (c == XMODEM_CMD_ACK) {
+        break;
+      }
+      if (c == XMODEM_CMD_CAN) {
+        return BOOTLOADER_ERROR_XMODEM_CANCEL;
+      }
+      // Packet rejected; send it again
+    }
+
+    address += copySize;
+    length -= copySize;
+    packetNumber++;
+  }
+
+  for (retries = 10; retries > 0; retries--) {
+    sendPacket(XMODEM_CMD_EOT);
+    if ((uart_receiveByteTimeout(&c, 3000UL) == BOOTLOADER_OK)
+        && (c == XMODEM_CMD_ACK)) {
+      return BOOTLOADER_OK;
+    }
+  }
+
+  return BOOTLOADER_ERROR_COMMUNICATION_TIMEOUT;
+}
+
+// List the address and checksum of each flash page overlapping a range
+static void sendManifest(uint32_t address, uint32_t length)
+{
+  uint32_t page = address & ~(FLASH_PAGE_SIZE - 1UL);
+  // Divides the flash page size
+  uint8_t chunk[64];
+
+  uart_sendByte('\r');
+  uart_sendByte('\n');
+  for (; page < (address + length); page += FLASH_PAGE_SIZE) {
+    sendHexWord(page);
+    uart_sendByte(' ');
+#if defined(BTL_XMODEM_MANIFEST_SHA256) && (BTL_XMODEM_MANIFEST_SHA256 == 1)
+    Sha256Context_t sha256;
+    btl_initSha256(&sha256);
+    for (uint32_t offset = 0UL; offset < FLASH_PAGE_SIZE; offset += sizeof(chunk)) {
+      readFlash(page + offset, chunk, sizeof(chunk));
+      btl_updateSha256(&sha256, chunk, sizeof(chunk));
+    }
+    btl_finalizeSha256(&sha256);
+    for (size_t i = 0U; i < BTL_SECURITY_SHA256_DIGEST_LENGTH; i++) {
+      uart_sendByte(nibbleToHex(sha256.sha[i] >> 4));
+      uart_sendByte(nibbleToHex(sha256.sha[i] & 0x0F));
+    }
+#else
+    // Standard CRC-32, as computed by zlib
+    uint32_t crc32 = BTL_CRC32_START;
+    for (uint32_t offset = 0UL; offset < FLASH_PAGE_SIZE; offset += sizeof(chunk)) {
+      readFlash(page + offset, chunk, sizeof(chunk));
+      crc32 = btl_crc32Stream(chunk, sizeof(chunk), crc32);
+    }
+    sendHexWord(crc32 ^ 0xFFFFFFFFUL);
+#endif
+    uart_sendByte('\r');
+    uart_sendByte('\n');
+  }
+}
+#endif
+
 // -----------------------------------------------------------------------------
 // Global Functions
 
+#if (SL_SERIAL_UART_FLOW_CONTROL == 1)
+// Page erases and long flash writes, including those of a delta install,
+// stall the receive loops that deassert RTS when the receive buffer fills;
+// stop the host before they start
+void flash_stallCallback(void)
+{
+  uart_pauseRx();
+}
+#endif
+
 void bootloader_xmodem_communication_init(void)
 {
   uart_init();
@@ -174,11 +1029,31 @@ void bootloader_xmodem_communication_init(void)
 int32_t bootloader_xmodem_communication_start(void)
 {
   int32_t ret = BOOTLOADER_OK;
+#if defined(BTL_XMODEM_QUIET_ENABLE) && (BTL_XMODEM_QUIET_ENABLE == 1)
+  // Banner and menu are suppressed
+  return ret;
+#else
   char str[] = "\r\nGecko Bootloader vX.YY.ZZ\r\n"
                "1. upload gbl\r\n"
                "2. run\r\n"
                "3. ebl info\r\n"
                "4. erase nvm\r\n"
+#if defined(BTL_XMODEM_STREAMING_ENABLE) && (BTL_XMODEM_STREAMING_ENABLE == 1)
+               "5. upload gbl (streaming)\r\n"
+#endif
+#if defined(BTL_XMODEM_BAUD_SWITCH_ENABLE) && (BTL_XMODEM_BAUD_SWITCH_ENABLE == 1)
+               "6. upload gbl (" XMODEM_STR(BTL_XMODEM_BAUD_SWITCH_RATE) " baud)\r\n"
+#endif
+#if defined(SL_DEBUG_PROFILE) && (SL_DEBUG_PROFILE == 1)
+               "7. profile\r\n"
+#endif
+#if defined(BTL_XMODEM_RESUME_ENABLE) && (BTL_XMODEM_RESUME_ENABLE == 1)
+               "8. resume upload\r\n"
+#endif
+#if defined(BTL_XMODEM_READBACK_ENABLE) && (BTL_XMODEM_READBACK_ENABLE == 1)
+               "9. read flash\r\n"
+               "0. flash manifest\r\n"
+#endif
                "BL > ";
 
   uint32_t version = bootload_getBootloaderVersion();
@@ -190,6 +1065,7 @@ int32_t bootloader_xmodem_communication_start(void)
 
   uart_sendBuffer((uint8_t *)str, sizeof(str), true);
   return ret;
+#endif
 }
 
 int32_t bootloader_xmodem_communication_main(ImageProperties_t *imageProps,
@@ -198,7 +1074,12 @@ int32_t bootloader_xmodem_communication_main(ImageProperties_t *imageProps,
   int32_t ret = -1;
 
   XmodemState_t state = IDLE;
-  XmodemReceiveBuffer_t buf;
+  // Kept off the stack, since it is sized for the largest packet accepted.
+  // Word aligned, so the payload is word aligned for in place parsing.
+  SL_ALIGN(4)
+  static XmodemReceiveBuffer_t buf SL_ATTRIBUTE_ALIGN(4);
+  // Packet held in the UART receive buffer, or NULL if it was copied to buf
+  uint8_t *frame = NULL;
   uint8_t response = 0;
   bool confirm_erase = false;
   int packetTimeout = 60;
@@ -207,9 +1088,11 @@ int32_t bootloader_xmodem_communication_main(ImageProperties_t *imageProps,
 #endif
 
 #if !defined(BOOTLOADER_NONSECURE)
-  ParserContext_t parserContext = { 0 };
-  DecryptContext_t decryptContext = { 0 };
-  AuthContext_t authContext = { 0 };
+  // Static, so the contexts, which hold pointers to each other, are at the
+  // same address when restored from a checkpoint
+  static ParserContext_t parserContext = { 0 };
+  static DecryptContext_t decryptContext = { 0 };
+  static AuthContext_t authContext = { 0 };
 #endif
 
   delay_init();
@@ -240,22 +1123,48 @@ int32_t bootloader_xmodem_communication_main(ImageProperties_t *imageProps,
         break;
 
       case INIT_TRANSFER:
+#if defined(BTL_XMODEM_DIRECT_UPLOAD_ENABLE) && (BTL_XMODEM_DIRECT_UPLOAD_ENABLE == 1)
+        if (!directTransfer) {
+          uart_sendBuffer((uint8_t *)transferInitStr,
+                          sizeof(transferInitStr),
+                          true);
+        }
+#else
         uart_sendBuffer((uint8_t *)transferInitStr,
                         sizeof(transferInitStr),
                         true);
+#endif
 
         memset(imageProps, 0, sizeof(ImageProperties_t));
+        // The packet buffer is not used after parsing, so the parser may
+        // process the payload in place
 #if defined(BOOTLOADER_NONSECURE)
-        parser_init(PARSER_FLAG_PARSE_CUSTOM_TAGS);
+        parser_init(PARSER_FLAG_PARSE_CUSTOM_TAGS | PARSER_FLAG_IN_PLACE);
 #else
         parser_init(&parserContext,
                     &decryptContext,
                     &authContext,
-                    PARSER_FLAG_PARSE_CUSTOM_TAGS);
+                    PARSER_FLAG_PARSE_CUSTOM_TAGS | PARSER_FLAG_IN_PLACE);
         imageProps->instructions = 0xFFU;
 #endif
         imageProps->imageCompleted = false;
         imageProps->imageVerified = false;
+#if defined(BTL_XMODEM_RESUME_ENABLE) && (BTL_XMODEM_RESUME_ENABLE == 1)
+        transferOffset = 0UL;
+        nextCheckpointOffset = BTL_XMODEM_RESUME_INTERVAL;
+#endif
+
+#if defined(BTL_XMODEM_DIRECT_UPLOAD_ENABLE) && (BTL_XMODEM_DIRECT_UPLOAD_ENABLE == 1)
+        if (directTransfer) {
+          directTransfer = false;
+          xmodem_reset();
+          // A packet the host sent unrequested is already waiting; otherwise
+          // request the transfer right away
+          state = (uart_getRxAvailableBytes() != 0U) ? RECEIVE_DATA
+                  : WAIT_FOR_DATA;
+          break;
+        }
+#endif
 
         // Wait 5ms and see if we got any premature input; discard it
         delay_milliseconds(5, true);
@@ -270,8 +1179,12 @@ int32_t bootloader_xmodem_communication_main(ImageProperties_t *imageProps,
         break;
 
       case WAIT_FOR_DATA:
-        // Send 'C'
+        // Send 'C', or 'G' to request a streaming transfer
+#if defined(BTL_XMODEM_STREAMING_ENABLE) && (BTL_XMODEM_STREAMING_ENABLE == 1)
+        sendPacket(streamingTransfer ? XMODEM_CMD_G : XMODEM_CMD_C);
+#else
         sendPacket(XMODEM_CMD_C);
+#endif
         delay_milliseconds(1000, false);
         while (uart_getRxAvailableBytes() == 0 && !delay_expired()) {
           // Do nothing
@@ -287,21 +1200,61 @@ int32_t bootloader_xmodem_communication_main(ImageProperties_t *imageProps,
             sendPacket(XMODEM_CMD_CAN);
             state = MENU;
           }
+#if defined(BTL_XMODEM_BAUD_SWITCH_ENABLE) && (BTL_XMODEM_BAUD_SWITCH_ENABLE == 1)
+          if (baudFallbackArmed
+              && (packetTimeout <= (60 - BTL_XMODEM_BAUD_SWITCH_TIMEOUT))) {
+            // Host did not follow to the new baud rate
+            restoreBaudRate();
+            state = MENU;
+          }
+#endif
         }
         break;
 
       case RECEIVE_DATA:
         // Wait for a full XMODEM packet
-        memset(&(buf.packet), 0, sizeof(XmodemPacket_t));
-        ret = receivePacket(&(buf.packet));
+        BTL_PROFILE_BEGIN(UART_WAIT);
+        ret = receivePacket(&(buf.packet), &frame);
+        BTL_PROFILE_END(UART_WAIT, xmodem_getDataSize(buf.packet.header));
 
         if (ret != BOOTLOADER_OK) {
+#if defined(BTL_XMODEM_BAUD_SWITCH_ENABLE) && (BTL_XMODEM_BAUD_SWITCH_ENABLE == 1)
+          if (baudFallbackArmed) {
+            // First block failed at the new baud rate; fall back
+            restoreBaudRate();
+            state = MENU;
+            break;
+          }
+#endif
           response = XMODEM_CMD_NAK;
+#if defined(BTL_XMODEM_STREAMING_ENABLE) && (BTL_XMODEM_STREAMING_ENABLE == 1)
+          if (streamingTransfer) {
+            // Blocks are not retransmitted in streaming mode; abort transfer
+            response = XMODEM_CMD_CAN;
+            state = COMPLETE;
+          }
+#endif
           sendPacket(response);
           break;
         }
 
-        ret = xmodem_parsePacket(&(buf.packet), &response);
+        if (frame != NULL) {
+          ret = xmodem_parseFrame(frame, &response);
+        } else {
+          ret = xmodem_parsePacket(&(buf.packet), &response);
+        }
+#if defined(BTL_XMODEM_BAUD_SWITCH_ENABLE) && (BTL_XMODEM_BAUD_SWITCH_ENABLE == 1)
+        if (baudFallbackArmed) {
+          if (ret != BOOTLOADER_OK) {
+            // First block failed at the new baud rate; fall back. Restoring
+            // the baud rate flushes the receive buffer, including the frame.
+            restoreBaudRate();
+            state = MENU;
+            break;
+          }
+          baudFallbackArmed = false;
+        }
+#endif
         if (ret == BOOTLOADER_ERROR_XMODEM_DONE) {
           // XMODEM receive complete; return to menu
           state = COMPLETE;
@@ -313,18 +1266,22 @@ int32_t bootloader_xmodem_communication_main(ImageProperties_t *imageProps,
           }
         }
 
-        if ((ret == BOOTLOADER_OK) && (buf.packet.header == XMODEM_CMD_SOH)) {
+        if ((ret == BOOTLOADER_OK)
+            && (xmodem_getDataSize(buf.packet.header) != 0U)) {
           // Packet is OK, parse contents
+          // A packet in the receive buffer is parsed where it is, at any
+          // alignment
+          uint8_t *data = (frame != NULL) ? &frame[3] : buf.packet.data;
 #if defined(BOOTLOADER_NONSECURE)
           (void)parseCb;
-          ret = parser_parse(buf.packet.data,
-                             XMODEM_DATA_SIZE,
+          ret = parser_parse(data,
+                             xmodem_getDataSize(buf.packet.header),
                              imageProps);
 #else
           ret = parser_parse(&parserContext,
                              imageProps,
-                             buf.packet.data,
-                             XMODEM_DATA_SIZE,
+                             data,
+                             xmodem_getDataSize(buf.packet.header),
                              parseCb);
 #endif
           if (ret != BOOTLOADER_OK) {
@@ -334,7 +1291,34 @@ int32_t bootloader_xmodem_communication_main(ImageProperties_t *imageProps,
             BTL_DEBUG_PRINT_LF();
             response = XMODEM_CMD_CAN;
           }
+#if defined(BTL_XMODEM_RESUME_ENABLE) && (BTL_XMODEM_RESUME_ENABLE == 1)
+          if (ret == BOOTLOADER_OK) {
+            checkpointTransfer(xmodem_getDataSize(buf.packet.header),
+                               imageProps,
+                               &parserContext,
+                               &decryptContext,
+                               &authContext);
+          }
+#endif
+        }
+
+        if (frame != NULL) {
+          // Done with the packet; hand its space back to the receiver
+          uart_releaseRx(3U + xmodem_getDataSize(buf.packet.header) + 2U);
+          frame = NULL;
+        }
+
+#if defined(BTL_XMODEM_STREAMING_ENABLE) && (BTL_XMODEM_STREAMING_ENABLE == 1)
+        if (streamingTransfer) {
+          if ((ret != BOOTLOADER_OK) && (ret != BOOTLOADER_ERROR_XMODEM_DONE)) {
+            // Blocks are not retransmitted in streaming mode; abort transfer
+            response = XMODEM_CMD_CAN;
+          } else if (ret == BOOTLOADER_OK) {
+            // The sender does not wait for data blocks to be acknowledged
+            break;
+          }
         }
+#endif
 
         if (response == XMODEM_CMD_CAN) {
           // Parsing packet failed; return to main menu
@@ -349,8 +1333,32 @@ int32_t bootloader_xmodem_communication_main(ImageProperties_t *imageProps,
         BTL_DEBUG_PRINT("Complete ");
         BTL_DEBUG_PRINT_WORD_HEX(ret);
         BTL_DEBUG_PRINT_LF();
+        // Flash must hold the whole image before it is reported or booted
+#if defined(BOOTLOADER_NONSECURE)
+        (void)flash_waitForWrite();
+#else
+        bootload_flushFlashWrites();
+#endif
         uart_flush(false, true);
 
+#if defined(BOOTLOADER_DELTA_OTW) && (BOOTLOADER_DELTA_OTW == 1)
+        // A verified delta upgrade is only a patch so far. Install the image
+        // rebuilt from it before the transfer is reported as complete.
+        if ((response == XMODEM_CMD_ACK)
+            && (ret == BOOTLOADER_ERROR_XMODEM_DONE)
+            && (imageProps->contents & BTL_IMAGE_CONTENT_DELTA)) {
+          ret = delta_installImage(parserContext.newFwSize,
+                                   parserContext.newFwCRC);
+          if (ret == BOOTLOADER_OK) {
+            ret = BOOTLOADER_ERROR_XMODEM_DONE;
+          } else {
+            // The installed application is unchanged
+            imageProps->imageCompleted = false;
+            response = XMODEM_CMD_CAN;
+          }
+        }
+#endif
+
         delay_milliseconds(10, true);
 
         if ((response == XMODEM_CMD_ACK)
@@ -358,6 +1366,9 @@ int32_t bootloader_xmodem_communication_main(ImageProperties_t *imageProps,
           uart_sendBuffer((uint8_t *)transferCompleteStr,
                           sizeof(transferCompleteStr),
                           true);
+#if defined(BTL_XMODEM_RESUME_ENABLE) && (BTL_XMODEM_RESUME_ENABLE == 1)
+          clearCheckpoint();
+#endif
         } else {
           uart_sendBuffer((uint8_t *)transferAbortedStr,
                           sizeof(transferAbortedStr),
@@ -414,6 +1425,14 @@ int32_t bootloader_xmodem_communication_main(ImageProperties_t *imageProps,
             case BOOTLOADER_ERROR_PARSER_KEYERROR:
               response = 0x50; // BL_ERR_INV_KEY
               break;
+#if defined(BOOTLOADER_DELTA_OTW) && (BOOTLOADER_DELTA_OTW == 1)
+            case BOOTLOADER_ERROR_BOOTLOAD_DELTA_CRC:
+              response = 0x43; // BL_ERR_CRC
+              break;
+            case BOOTLOADER_ERROR_BOOTLOAD_DELTA_PATCH:
+              response = 0x4F; // BL_ERR_TAGBUF
+              break;
+#endif
           }
 
           uart_sendByte(nibbleToHex(response >> 4));
@@ -421,6 +1440,9 @@ int32_t bootloader_xmodem_communication_main(ImageProperties_t *imageProps,
           uart_sendByte('\r');
           uart_sendByte('\n');
         }
+#if defined(BTL_XMODEM_BAUD_SWITCH_ENABLE) && (BTL_XMODEM_BAUD_SWITCH_ENABLE == 1)
+        restoreBaudRate();
+#endif
         state = MENU;
         break;
 
@@ -463,6 +1485,102 @@ int32_t bootloader_xmodem_communication_main(ImageProperties_t *imageProps,
         }
         break;
       
+#if defined(BTL_XMODEM_BAUD_SWITCH_ENABLE) && (BTL_XMODEM_BAUD_SWITCH_ENABLE == 1)
+      case SWITCH_BAUD_RATE:
+        uart_sendBuffer((uint8_t *)baudSwitchStr,
+                        sizeof(baudSwitchStr),
+                        true);
+        if (uart_setBaudRate(BTL_XMODEM_BAUD_SWITCH_RATE) != BOOTLOADER_OK) {
+          state = MENU;
+          break;
+        }
+        baudSwitched = true;
+        baudFallbackArmed = true;
+        state = INIT_TRANSFER;
+        break;
+#endif
+
+#if defined(SL_DEBUG_PROFILE) && (SL_DEBUG_PROFILE == 1)
+      case DUMP_PROFILE:
+        dumpProfile();
+        state = MENU;
+        break;
+#endif
+
+#if defined(BTL_XMODEM_RESUME_ENABLE) && (BTL_XMODEM_RESUME_ENABLE == 1)
+      case RESUME_TRANSFER:
+        if (restoreCheckpoint(imageProps,
+                              &parserContext,
+                              &decryptContext,
+                              &authContext) != BOOTLOADER_OK) {
+          uart_sendBuffer((uint8_t *)noCheckpointStr,
+                          sizeof(noCheckpointStr),
+                          true);
+          state = MENU;
+          break;
+        }
+
+        // The host sends the GBL file from this offset as a new transfer
+        uart_sendBuffer((uint8_t *)resumeStr,
+                        sizeof(resumeStr) - 1U,
+                        true);
+        sendHexWord(transferOffset);
+        uart_sendByte('\r');
+        uart_sendByte('\n');
+
+        // Wait 5ms and see if we got any premature input; discard it
+        delay_milliseconds(5, true);
+        if (uart_getRxAvailableBytes()) {
+          uart_flush(false, true);
+        }
+
+        xmodem_reset();
+
+        state = WAIT_FOR_DATA;
+        break;
+#endif
+
+#if defined(BTL_XMODEM_READBACK_ENABLE) && (BTL_XMODEM_READBACK_ENABLE == 1)
+      case READ_FLASH: {
+        uint32_t address;
+        uint32_t length;
+
+        state = MENU;
+        if (!receiveFlashRange(&address, &length)) {
+          break;
+        }
+
+        uart_sendBuffer((uint8_t *)downloadInitStr,
+                        sizeof(downloadInitStr),
+                        true);
+        ret = sendFlash(address, length);
+
+        // Let the host leave its XMODEM receiver before reporting
+        delay_milliseconds(10, true);
+        if (ret == BOOTLOADER_OK) {
+          uart_sendBuffer((uint8_t *)downloadCompleteStr,
+                          sizeof(downloadCompleteStr),
+                          true);
+        } else {
+          uart_sendBuffer((uint8_t *)downloadAbortedStr,
+                          sizeof(downloadAbortedStr),
+                          true);
+        }
+        break;
+      }
+
+      case FLASH_MANIFEST: {
+        uint32_t address;
+        uint32_t length;
+
+        state = MENU;
+        if (receiveFlashRange(&address, &length)) {
+          sendManifest(address, length);
+        }
+        break;
+      }
+#endif
+
       case CONFIRM_ERASE_NVM:
         confirm_erase = true;
         state = IDLE;
@@ -475,7 +1593,7 @@ int32_t bootloader_xmodem_communication_main(ImageProperties_t *imageProps,
         // - Controller 0x08074000, size 0xa000
         // - End device 0x08076000, size 0x8000
         // ...which both end at address 0x0807dfff
-        uint32_t nvm_address = 0x08074000;
+        uint32_t nvm_address = XMODEM_NVM_ADDRESS;
         uint32_t nvm_size = 0x0000a000;
         uint32_t zpal_page_size = 0x00002000;
 
@@ -489,7 +1607,7 @@ int32_t bootloader_xmodem_communication_main(ImageProperties_t *imageProps,
         // It would be much easier to just have the controller firmware also generate a DSK,
         // but Silabs hides this functionality in the end device binaries...
 
-        uint32_t btl_enc_key_address = 0x0807e284; // Actually at 0x0807e286, but that's not 4-byte aligned
+        uint32_t btl_enc_key_address = XMODEM_GBL_KEY_ADDRESS; // Actually at 0x0807e286, but that's not 4-byte aligned
         uint8_t btl_enc_key_data[20]; // Actually 16 bytes, but we need to read 20 bytes to keep the alignment
         memcpy(btl_enc_key_data, (uint8_t *)btl_enc_key_address, sizeof(btl_enc_key_data));
 
@@ -88,6 +88,19 @@ MISRAC_ENABLE
   #endif
 #endif // defined(BOOTLOADER_SUPPORT_CERTIFICATES)
 
+#if defined(BOOTLOADER_DELTA_OTW) && (BOOTLOADER_DELTA_OTW == 1)
+  #if defined(BOOTLOADER_SUPPORT_STORAGE)
+    #error "Delta upgrades without storage can't be used with a storage slot"
+  #endif
+  #if defined(BOOTLOADER_NONSECURE)
+    #error "Delta upgrades without storage not supported"
+  #endif
+  // The parser handles delta tags, the patch is applied by core/btl_delta.c
+  #if !defined(BTL_PARSER_SUPPORT_DELTA_DFU)
+    #define BTL_PARSER_SUPPORT_DELTA_DFU 1
+  #endif
+#endif // defined(BOOTLOADER_DELTA_OTW)
+
 #if defined(BOOTLOADER_USE_SYMMETRIC_KEY_FROM_APP_PROPERTIES) \
   && (BOOTLOADER_USE_SYMMETRIC_KEY_FROM_APP_PROPERTIES == 1)
   #if !defined(_SILICON_LABS_32B_SERIES_2)
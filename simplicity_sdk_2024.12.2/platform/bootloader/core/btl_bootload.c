@@ -48,7 +48,7 @@ MISRAC_ENABLE
 
 // Flashing
 #include "core/flash/btl_internal_flash.h"
-#if defined (BTL_PARSER_SUPPORT_DELTA_DFU)
+#if defined (BTL_PARSER_SUPPORT_DELTA_DFU) && defined(BOOTLOADER_SUPPORT_STORAGE)
 #include "storage/btl_storage.h"
 #include "btl_interface_parser.h"
 #include "btl_parse.h"
@@ -82,6 +82,12 @@ MISRAC_ENABLE
 #endif
 #endif // defined(BOOTLOADER_SUPPORT_CERTIFICATES)
 
+#if defined(BOOTLOADER_SKIP_IDENTICAL_PAGES) && (BOOTLOADER_SKIP_IDENTICAL_PAGES == 1)
+#if !defined(BOOTLOADER_FLASH_PAGE_BUFFER) || (BOOTLOADER_FLASH_PAGE_BUFFER == 0)
+#error "Skipping identical pages requires the flash page buffer"
+#endif
+#endif // defined(BOOTLOADER_SKIP_IDENTICAL_PAGES)
+
 // --------------------------------
 // Local type declarations
 static bool bootload_verifySecureBoot(uint32_t startAddress);
@@ -89,6 +95,15 @@ static bool bootload_verifySecureBoot(uint32_t startAddress);
 static void flashData(uint32_t address,
                       const uint8_t  data[],
                       size_t   length);
+static void erasePage(uint32_t pageAddress);
+static void erasePages(uint32_t address,
+                       size_t   length);
+#if defined(BOOTLOADER_FLASH_PAGE_BUFFER) && (BOOTLOADER_FLASH_PAGE_BUFFER == 1)
+static void bufferData(uint32_t address,
+                       const uint8_t  data[],
+                       size_t   length);
+static void flushPageBuffer(void);
+#endif
 
 static bool getSignatureX(ApplicationProperties_t *appProperties,
                           uint32_t *appSignatureX);
@@ -109,6 +124,31 @@ static uint32_t getHighestApplicationVersionSeen(void);
 #define SL_GBL_UINT32_MAX_NUMBER                    0xFFFFFFFFUL
 #endif
 
+#define SL_GBL_FLASH_PAGE_COUNT                     (FLASH_SIZE / FLASH_PAGE_SIZE)
+
+// Application pages erased during the current transfer, relative to the
+// start of the application space
+static uint32_t erasedPages[(SL_GBL_FLASH_PAGE_COUNT + 31UL) / 32UL];
+
+// Range of flash programmed during the current transfer
+static uint32_t programmedStart = 0xFFFFFFFFUL;
+static uint32_t programmedEnd = 0UL;
+
+#if defined(BOOTLOADER_ASYNC_FLASH_WRITE) && (BOOTLOADER_ASYNC_FLASH_WRITE == 1) \
+  && (!defined(BOOTLOADER_FLASH_PAGE_BUFFER) || (BOOTLOADER_FLASH_PAGE_BUFFER == 0))
+// Holds the data of the write in progress, so the caller's buffer can be reused
+SL_ALIGN(4)
+static uint8_t asyncFlashBuffer[BOOTLOADER_ASYNC_FLASH_WRITE_BUFFER_SIZE] SL_ATTRIBUTE_ALIGN(4);
+#endif
+
+#if defined(BOOTLOADER_FLASH_PAGE_BUFFER) && (BOOTLOADER_FLASH_PAGE_BUFFER == 1)
+// Sequential image data not yet written to flash, at most up to a page end
+SL_ALIGN(4)
+static uint8_t pageBuffer[FLASH_PAGE_SIZE] SL_ATTRIBUTE_ALIGN(4);
+static uint32_t pageBufferAddress;
+static size_t pageBufferLength = 0U;
+#endif
+
 // --------------------------------
 // Local functions
 
@@ -149,23 +189,149 @@ static uint32_t getHighestApplicationVersionSeen(void)
 }
 #endif
 
-static void flashData(uint32_t address,
-                      const uint8_t  data[],
-                      size_t   length)
+// Erase a page, unless it was already erased during this transfer or is blank
+static void erasePage(uint32_t pageAddress)
+{
+  const uint32_t startOfAppSpace = (uint32_t)(mainBootloaderTable->startOfAppSpace);
+  const uint32_t page = (pageAddress - startOfAppSpace) / FLASH_PAGE_SIZE;
+  const bool tracked = (pageAddress >= startOfAppSpace)
+                       && (pageAddress < (uint32_t)(mainBootloaderTable->endOfAppSpace))
+                       && (page < SL_GBL_FLASH_PAGE_COUNT);
+
+  if (tracked && ((erasedPages[page / 32UL] & (1UL << (page % 32UL))) != 0UL)) {
+    return;
+  }
+
+  // A background write must not be in progress while the page is read
+  (void)flash_waitForWrite();
+  const uint32_t *word = (const uint32_t *)pageAddress;
+  for (uint32_t i = 0UL; i < (FLASH_PAGE_SIZE / sizeof(uint32_t)); i++) {
+    if (word[i] != 0xFFFFFFFFUL) {
+      (void)flash_erasePage(pageAddress);
+      break;
+    }
+  }
+
+  if (tracked) {
+    erasedPages[page / 32UL] |= (1UL << (page % 32UL));
+  }
+}
+
+static void erasePages(uint32_t address,
+                       size_t   length)
 {
   const uint32_t pageSize = FLASH_PAGE_SIZE;
 
   // Erase the page if write starts at a page boundary
   if (address % pageSize == 0UL) {
-    flash_erasePage(address);
+    erasePage(address);
   }
 
   // Erase all pages that start inside the write range
   for (uint32_t pageAddress = (address + pageSize) & ~(pageSize - 1UL);
        pageAddress < (address + length);
        pageAddress += pageSize) {
-    flash_erasePage(pageAddress);
+    erasePage(pageAddress);
+  }
+}
+
+#if defined(BOOTLOADER_FLASH_PAGE_BUFFER) && (BOOTLOADER_FLASH_PAGE_BUFFER == 1)
+static void flushPageBuffer(void)
+{
+  if (pageBufferLength == 0U) {
+    return;
+  }
+
+#if defined(BOOTLOADER_SKIP_IDENTICAL_PAGES) && (BOOTLOADER_SKIP_IDENTICAL_PAGES == 1)
+  // A full page that already holds this data needs neither erase nor
+  // program. The first application page holds the withheld vectors and is
+  // always rewritten, so a partially updated application can't boot.
+  if ((pageBufferLength == FLASH_PAGE_SIZE)
+      && (pageBufferAddress != (uint32_t)(mainBootloaderTable->startOfAppSpace))
+      && (memcmp(pageBuffer, (const void *)pageBufferAddress, FLASH_PAGE_SIZE) == 0)) {
+    BTL_DEBUG_PRINT("= ");
+    BTL_DEBUG_PRINT_WORD_HEX(pageBufferAddress);
+    BTL_DEBUG_PRINT_LF();
+    pageBufferLength = 0U;
+    return;
+  }
+#endif
+
+  erasePages(pageBufferAddress, pageBufferLength);
+
+  BTL_DEBUG_PRINT("P ");
+  BTL_DEBUG_PRINT_WORD_HEX(pageBufferLength);
+  BTL_DEBUG_PRINT(" to ");
+  BTL_DEBUG_PRINT_WORD_HEX(pageBufferAddress);
+  BTL_DEBUG_PRINT_LF();
+
+#if defined(BOOTLOADER_ASYNC_FLASH_WRITE) && (BOOTLOADER_ASYNC_FLASH_WRITE == 1)
+  // Program straight from the page buffer; bufferData waits for the write to
+  // complete before refilling it
+  (void)flash_writeBuffer_dmaAsync(pageBufferAddress,
+                                   pageBuffer,
+                                   pageBufferLength,
+                                   SL_GBL_MSC_LDMA_CHANNEL);
+#else
+  (void)flash_writeBuffer_dma(pageBufferAddress,
+                              pageBuffer,
+                              pageBufferLength,
+                              SL_GBL_MSC_LDMA_CHANNEL);
+#endif
+  pageBufferLength = 0U;
+}
+
+static void bufferData(uint32_t address,
+                       const uint8_t  data[],
+                       size_t   length)
+{
+  // Data that does not continue the buffered range starts a new one
+  if ((pageBufferLength > 0U)
+      && (address != (pageBufferAddress + pageBufferLength))) {
+    flushPageBuffer();
+  }
+
+  while (length > 0U) {
+    if (pageBufferLength == 0U) {
+      // The buffer may still be the source of a background write
+      (void)flash_waitForWrite();
+      pageBufferAddress = address;
+    }
+
+    // Collect up to the end of the flash page the buffered range starts in
+    uint32_t pageEnd = (pageBufferAddress + FLASH_PAGE_SIZE)
+                       & ~(FLASH_PAGE_SIZE - 1UL);
+    size_t chunk = SL_MIN(length,
+                          (size_t)(pageEnd - (pageBufferAddress + pageBufferLength)));
+    // Data written into the buffer (bootload_getApplicationBuffer) is
+    // already in place, unless a flush came in between
+    if (data != &pageBuffer[pageBufferLength]) {
+      (void)memmove(&pageBuffer[pageBufferLength], data, chunk);
+    }
+    pageBufferLength += chunk;
+    address += chunk;
+    data += chunk;
+    length -= chunk;
+
+    if ((pageBufferAddress + pageBufferLength) == pageEnd) {
+      flushPageBuffer();
+    }
   }
+}
+#endif
+
+static void flashData(uint32_t address,
+                      const uint8_t  data[],
+                      size_t   length)
+{
+  programmedStart = SL_MIN(programmedStart, address);
+  programmedEnd = SL_MAX(programmedEnd, address + length);
+
+#if defined(BOOTLOADER_FLASH_PAGE_BUFFER) && (BOOTLOADER_FLASH_PAGE_BUFFER == 1)
+  // Collect sequential data and program it per flash page
+  bufferData(address, data, length);
+#else
+  erasePages(address, length);
 
   BTL_DEBUG_PRINT("F ");
   BTL_DEBUG_PRINT_WORD_HEX(length);
@@ -173,7 +339,37 @@ static void flashData(uint32_t address,
   BTL_DEBUG_PRINT_WORD_HEX(address);
   BTL_DEBUG_PRINT_LF();
 
+#if defined(BOOTLOADER_ASYNC_FLASH_WRITE) && (BOOTLOADER_ASYNC_FLASH_WRITE == 1)
+  if ((length <= sizeof(asyncFlashBuffer)) && ((length & 3UL) == 0UL)) {
+    // Program from a private copy in the background and return to the
+    // parser. The buffer is free once the previous write has completed.
+    (void)flash_waitForWrite();
+    (void)memcpy(asyncFlashBuffer, data, length);
+    (void)flash_writeBuffer_dmaAsync(address,
+                                     asyncFlashBuffer,
+                                     length,
+                                     SL_GBL_MSC_LDMA_CHANNEL);
+    return;
+  }
+#endif
+
+  if (((uint32_t)data & 3UL) != 0UL) {
+    // The LDMA reads whole words; program data taken unaligned from the
+    // parser input (PARSER_FLAG_IN_PLACE) from a word aligned copy
+    uint32_t words[GBL_PARSER_BUFFER_SIZE / 4UL];
+    for (size_t offset = 0U; offset < length; offset += sizeof(words)) {
+      size_t chunk = SL_MIN(length - offset, sizeof(words));
+      (void)memcpy(words, &data[offset], chunk);
+      (void)flash_writeBuffer_dma(address + offset,
+                                  words,
+                                  chunk,
+                                  SL_GBL_MSC_LDMA_CHANNEL);
+    }
+    return;
+  }
+
   flash_writeBuffer_dma(address, data, length, SL_GBL_MSC_LDMA_CHANNEL);
+#endif // BOOTLOADER_FLASH_PAGE_BUFFER
 }
 
 static bool getSignatureX(ApplicationProperties_t *appProperties, uint32_t *appSignatureX)
@@ -312,7 +508,9 @@ SL_WEAK void bootload_applicationCallback(uint32_t address,
                                           size_t   length,
                                           void     *context)
 {
-#if defined(BTL_PARSER_SUPPORT_DELTA_DFU)
+  // Without storage, delta patches are applied by the delta module, which
+  // passes the rebuilt image here
+#if defined(BTL_PARSER_SUPPORT_DELTA_DFU) && defined(BOOTLOADER_SUPPORT_STORAGE)
   const BootloaderParserContext_t *ctx = (BootloaderParserContext_t *) context;
   if (ctx->parserContext.newFwCRC != 0x00) {
     uint32_t startOfAppSpace = BTL_APPLICATION_BASE;
@@ -398,12 +596,124 @@ SL_WEAK void bootload_bootloaderCallback(uint32_t offset,
   // This ensures that application is not misinterpreted as valid when
   // bootloader upgrade has started
   if (offset == 0UL && BTL_UPGRADE_LOCATION < (uint32_t)(mainBootloaderTable->endOfAppSpace)) {
+#if defined(BOOTLOADER_FLASH_PAGE_BUFFER) && (BOOTLOADER_FLASH_PAGE_BUFFER == 1)
+    // Buffered data may belong to the page erased here
+    flushPageBuffer();
+#endif
     flash_erasePage((uint32_t)(mainBootloaderTable->startOfAppSpace));
   }
 
   flashData(address, data, length);
 }
 
+uint8_t *bootload_getApplicationBuffer(uint32_t address, size_t *length)
+{
+#if defined(BOOTLOADER_FLASH_PAGE_BUFFER) && (BOOTLOADER_FLASH_PAGE_BUFFER == 1)
+  if ((address & 3UL) != 0UL) {
+    *length = 0U;
+    return NULL;
+  }
+
+  // As in bufferData, data that does not continue the buffered range starts
+  // a new one
+  if ((pageBufferLength > 0U)
+      && (address != (pageBufferAddress + pageBufferLength))) {
+    flushPageBuffer();
+  }
+  if (pageBufferLength == 0U) {
+    // The buffer may still be the source of a background write
+    (void)flash_waitForWrite();
+    pageBufferAddress = address;
+  }
+
+  uint32_t pageEnd = (pageBufferAddress + FLASH_PAGE_SIZE)
+                     & ~(FLASH_PAGE_SIZE - 1UL);
+  *length = (size_t)(pageEnd - (pageBufferAddress + pageBufferLength));
+  return &pageBuffer[pageBufferLength];
+#else
+  (void)address;
+  *length = 0U;
+  return NULL;
+#endif
+}
+
+void bootload_flushFlashWrites(void)
+{
+#if defined(BOOTLOADER_FLASH_PAGE_BUFFER) && (BOOTLOADER_FLASH_PAGE_BUFFER == 1)
+  flushPageBuffer();
+#endif
+  (void)flash_waitForWrite();
+
+  // The next transfer starts without knowledge of erased pages
+  (void)memset(erasedPages, 0, sizeof(erasedPages));
+  programmedStart = 0xFFFFFFFFUL;
+  programmedEnd = 0UL;
+}
+
+void bootload_getProgrammedRange(uint32_t *start, uint32_t *end)
+{
+#if defined(BOOTLOADER_FLASH_PAGE_BUFFER) && (BOOTLOADER_FLASH_PAGE_BUFFER == 1)
+  flushPageBuffer();
+#endif
+  (void)flash_waitForWrite();
+
+  *start = programmedStart;
+  *end = programmedEnd;
+}
+
+void bootload_readApplicationData(uint32_t address,
+                                  uint8_t  data[],
+                                  size_t   length,
+                                  void     *context)
+{
+#if defined(BTL_PARSER_SUPPORT_DELTA_DFU) && defined(BOOTLOADER_SUPPORT_STORAGE)
+  const BootloaderParserContext_t *ctx = (BootloaderParserContext_t *) context;
+  if (ctx->parserContext.newFwCRC != 0x00) {
+    // Patch data goes to storage, see bootload_applicationCallback
+    (void)storage_readRaw(address, data, length);
+    return;
+  }
+#else
+  (void) context;
+#endif
+
+#if defined(BOOTLOADER_FLASH_PAGE_BUFFER) && (BOOTLOADER_FLASH_PAGE_BUFFER == 1)
+  uint32_t bufferEnd = pageBufferAddress + pageBufferLength;
+  if ((pageBufferLength > 0U)
+      && (address >= pageBufferAddress)
+      && ((address + length) <= bufferEnd)) {
+    // Recent data, no need to wait for the flash
+    (void)memcpy(data, &pageBuffer[address - pageBufferAddress], length);
+    return;
+  }
+#endif
+
+  (void)flash_waitForWrite();
+  (void)memcpy(data, (const void *)address, length);
+
+#if defined(BOOTLOADER_FLASH_PAGE_BUFFER) && (BOOTLOADER_FLASH_PAGE_BUFFER == 1)
+  // Data held back in the page buffer is newer than the flash contents
+  if ((pageBufferLength > 0U)
+      && (address < bufferEnd)
+      && ((address + length) > pageBufferAddress)) {
+    uint32_t start = SL_MAX(address, pageBufferAddress);
+    uint32_t end = SL_MIN(address + length, bufferEnd);
+    (void)memcpy(&data[start - address],
+                 &pageBuffer[start - pageBufferAddress],
+                 end - start);
+  }
+#endif
+}
+
+void bootload_resumeProgrammedRange(uint32_t start, uint32_t end)
+{
+  // Pages past the resume point may hold data written before the reset. They
+  // are not marked as erased, so the blank check erases them again.
+  (void)memset(erasedPages, 0, sizeof(erasedPages));
+  programmedStart = start;
+  programmedEnd = end;
+}
+
 bool bootload_checkApplicationPropertiesMagic(void *appProperties)
 {
   if ((appProperties == NULL) || ((uint32_t) appProperties == 0xFFFFFFFFUL)) {
@@ -130,7 +130,7 @@ void bootload_bootloaderCallback(uint32_t offset,
  * Image data callback implementation.
  *
  * @param address         Address (inside the raw image) the data starts at
- * @param data            Raw image data
+ * @param data            Raw image data, not necessarily word aligned
  * @param length          Size in bytes of raw image data. Always constrained to
  *                        a multiple of four.
  * @param context         A context variable defined by the implementation that
@@ -141,6 +141,77 @@ void bootload_applicationCallback(uint32_t address,
                                   size_t   length,
                                   void     *context);
 
+/***************************************************************************//**
+ * Get the space in the page buffer for image data at an address.
+ *
+ * Lets a producer of image data, such as a decompressor, write it where
+ * @ref bootload_applicationCallback would copy it to. Data written there is
+ * only taken over when it is passed to @ref bootload_applicationCallback at
+ * the same address, with a pointer into this space; the callback then does
+ * not copy it. Buffered data that does not end at the address is programmed
+ * first.
+ *
+ * @param[in]  address Word-aligned address (inside the raw image) of the data
+ * @param[out] length  Number of bytes up to the end of the flash page, 0 if
+ *                     no space is available
+ *
+ * @return Start of the space, or NULL without a page buffer
+ *         (BOOTLOADER_FLASH_PAGE_BUFFER) or for an unaligned address
+ ******************************************************************************/
+uint8_t *bootload_getApplicationBuffer(uint32_t address, size_t *length);
+
+/***************************************************************************//**
+ * Write out all image data passed to the image data callbacks.
+ *
+ * Programs any data held back in the page buffer and waits for background
+ * flash writes to complete. Must be called when an image transfer ends,
+ * before the image in flash is used. Pages erased during the transfer are
+ * forgotten, so the next transfer erases them again where needed.
+ ******************************************************************************/
+void bootload_flushFlashWrites(void);
+
+/***************************************************************************//**
+ * Get the range of flash programmed during the current transfer.
+ *
+ * Programs any data held back in the page buffer and waits for background
+ * flash writes to complete first, so the range can be read back. The
+ * transfer continues afterwards.
+ *
+ * @param[out] start Lowest programmed address, or 0xFFFFFFFF if nothing was
+ *                   programmed yet
+ * @param[out] end   Address following the highest programmed byte, or 0
+ ******************************************************************************/
+void bootload_getProgrammedRange(uint32_t *start, uint32_t *end);
+
+/***************************************************************************//**
+ * Read back image data passed to @ref bootload_applicationCallback during the
+ * current transfer.
+ *
+ * Returns data still held back in the page buffer, and waits for background
+ * flash writes to complete before reading the rest from flash. Withheld
+ * vectors read back as erased flash.
+ *
+ * @param[in]  address Address (inside the raw image) to read from
+ * @param[out] data    Buffer to read into
+ * @param[in]  length  Number of bytes to read
+ * @param[in]  context Context passed to @ref bootload_applicationCallback
+ ******************************************************************************/
+void bootload_readApplicationData(uint32_t address,
+                                  uint8_t  data[],
+                                  size_t   length,
+                                  void     *context);
+
+/***************************************************************************//**
+ * Continue a transfer after a reset.
+ *
+ * Restores the range of flash programmed up to the point the transfer is
+ * resumed from, as returned by @ref bootload_getProgrammedRange.
+ *
+ * @param[in] start Lowest programmed address
+ * @param[in] end   Address following the highest programmed byte
+ ******************************************************************************/
+void bootload_resumeProgrammedRange(uint32_t start, uint32_t end);
+
 /***************************************************************************//**
  * Perform a bootloader upgrade using the upgrade image present at
  * upgradeAddress with length size.
@@ -0,0 +1,371 @@
+/***************************************************************************//**
+ * @file
+ * @brief Delta upgrade functionality for the Silicon Labs bootloader
+ *******************************************************************************
+ * # License
+ * <b>Copyright 2021 Silicon Laboratories Inc. www.silabs.com</b>
+ *******************************************************************************
+ *
+ * The licensor of this software is Silicon Laboratories Inc.  Your use of this
+ * software is governed by the terms of Silicon Labs Master Software License
+ * Agreement (MSLA) available at
+ * www.silabs.com/about-us/legal/master-software-license-agreement.  This
+ * software is distributed to you in Source Code format and is governed by the
+ * sections of the MSLA applicable to Source Code.
+ *
+ ******************************************************************************/
+#include "config/btl_config.h"
+
+#include "btl_delta.h"
+#include "btl_bootload.h"
+#include "btl_util.h"
+
+#include "api/btl_errorcode.h"
+#include "api/btl_interface.h"
+#include "core/flash/btl_internal_flash.h"
+#include "security/btl_crc32.h"
+#include "debug/btl_debug.h"
+
+#include <string.h>
+
+#if defined(BOOTLOADER_DELTA_OTW) && (BOOTLOADER_DELTA_OTW == 1)
+
+// --------------------------------
+// Configuration
+
+// The rebuilt image is staged here and written to the scratch region a
+// buffer at a time
+#define DELTA_BUFFER_SIZE           (256UL)
+// Patch header: magic, size and CRC-32 of the installed application. Block
+// header: diff length, extra length, offset in the installed application.
+#define DELTA_HEADER_SIZE           (12UL)
+
+#if ((FLASH_PAGE_SIZE % DELTA_BUFFER_SIZE) != 0)
+#error "DELTA_BUFFER_SIZE must divide the flash page size"
+#endif
+
+#define DELTA_ARRAY_TO_U32(array, offset)              \
+  ((uint32_t)((uint32_t)((array)[(offset) + 3]) << 24) \
+   | ((uint32_t)((array)[(offset) + 2]) << 16)         \
+   | ((uint32_t)((array)[(offset) + 1]) << 8)          \
+   | ((uint32_t)((array)[(offset) + 0]) << 0))
+
+// --------------------------------
+// Local type declarations
+
+typedef enum {
+  DELTA_STATE_PATCH_HEADER,     ///< Expecting the patch header
+  DELTA_STATE_HEADER,           ///< Expecting a block header
+  DELTA_STATE_DIFF,             ///< Expecting diff bytes
+  DELTA_STATE_EXTRA,            ///< Expecting extra bytes
+} DeltaState_t;
+
+typedef struct {
+  DeltaState_t  state;
+  int32_t       status;         ///< First error in the current patch
+  uint32_t      patchOffset;    ///< Patch bytes consumed
+  uint32_t      oldSize;        ///< Size of the installed application
+  uint32_t      scratchAddress; ///< Start of the scratch region
+  uint32_t      oldOffset;      ///< Offset of the next diff byte in the app
+  uint32_t      nextOldOffset;  ///< Offset in the app after the diff bytes
+  uint32_t      newOffset;      ///< Bytes of the new image produced
+  uint32_t      diffLength;     ///< Diff bytes left in the current block
+  uint32_t      extraLength;    ///< Extra bytes left in the current block
+  size_t        headerPos;      ///< Bytes in the header buffer
+  uint8_t       header[DELTA_HEADER_SIZE];
+} DeltaPatch_t;
+
+// --------------------------------
+// Prototypes
+
+static int32_t parsePatchHeader(void);
+static int32_t parseHeader(void);
+static void nextRun(void);
+static void writeBuffer(uint32_t offset, size_t length);
+
+// --------------------------------
+// Static variables
+
+static DeltaPatch_t patch;
+
+SL_ALIGN(4)
+static uint8_t outputBuffer[DELTA_BUFFER_SIZE] SL_ATTRIBUTE_ALIGN(4);
+
+// Patch state that persists between calls, in the order it is saved
+static const struct {
+  void    *data;
+  size_t  length;
+} stateRegions[] = {
+  { &patch, sizeof(patch) },
+  { outputBuffer, sizeof(outputBuffer) },
+};
+
+// --------------------------------
+// Local functions
+
+// Check the installed application against the patch header, and place the
+// scratch region in the pages above it. Nothing has been erased yet, so a
+// patch made for another application leaves the installed one untouched.
+static int32_t parsePatchHeader(void)
+{
+  uint32_t startOfAppSpace = (uint32_t)mainBootloaderTable->startOfAppSpace;
+  uint32_t appSpaceSize = (uint32_t)mainBootloaderTable->endOfAppSpace
+                          - startOfAppSpace;
+  uint32_t oldSize = DELTA_ARRAY_TO_U32(patch.header, 4);
+  uint32_t oldCrc = DELTA_ARRAY_TO_U32(patch.header, 8);
+
+  if (DELTA_ARRAY_TO_U32(patch.header, 0) != DELTA_PATCH_MAGIC) {
+    BTL_DEBUG_PRINTLN("Delta magic");
+    return BOOTLOADER_ERROR_BOOTLOAD_DELTA_PATCH;
+  }
+
+  // At least a page of the application space has to be left for the new image
+  if (oldSize > (appSpaceSize - FLASH_PAGE_SIZE)) {
+    BTL_DEBUG_PRINTLN("Delta old size");
+    return BOOTLOADER_ERROR_BOOTLOAD_DELTA_PATCH;
+  }
+  if ((~btl_crc32Stream((const uint8_t *)startOfAppSpace,
+                        oldSize,
+                        BTL_CRC32_START)) != oldCrc) {
+    BTL_DEBUG_PRINTLN("Delta old CRC");
+    return BOOTLOADER_ERROR_BOOTLOAD_DELTA_PATCH;
+  }
+
+  patch.oldSize = oldSize;
+  patch.scratchAddress = startOfAppSpace
+                         + ((oldSize + FLASH_PAGE_SIZE - 1UL)
+                            & ~(FLASH_PAGE_SIZE - 1UL));
+  patch.state = DELTA_STATE_HEADER;
+  patch.headerPos = 0U;
+  return BOOTLOADER_OK;
+}
+
+static int32_t parseHeader(void)
+{
+  uint32_t diffLength = DELTA_ARRAY_TO_U32(patch.header, 0);
+  uint32_t extraLength = DELTA_ARRAY_TO_U32(patch.header, 4);
+  uint32_t skip = DELTA_ARRAY_TO_U32(patch.header, 8);
+  uint32_t oldSize = patch.oldSize;
+  // The scratch region ends with the application space, and the image copied
+  // from it to the start of the application space fits there as well
+  uint32_t newSpace = (uint32_t)mainBootloaderTable->endOfAppSpace
+                      - patch.scratchAddress - patch.newOffset;
+  uint32_t nextOldOffset;
+
+  BTL_DEBUG_PRINT("Delta block 0x");
+  BTL_DEBUG_PRINT_WORD_HEX(diffLength);
+  BTL_DEBUG_PRINT(" 0x");
+  BTL_DEBUG_PRINT_WORD_HEX(extraLength);
+  BTL_DEBUG_PRINT(" 0x");
+  BTL_DEBUG_PRINT_WORD_HEX(skip);
+  BTL_DEBUG_PRINT_LF();
+
+  // The block must fit in the new image
+  if ((diffLength > newSpace) || (extraLength > (newSpace - diffLength))) {
+    return BOOTLOADER_ERROR_BOOTLOAD_DELTA_PATCH;
+  }
+
+  // Diff bytes must come from the installed application, and so must the
+  // position after the offset is applied
+  if (diffLength > (oldSize - patch.oldOffset)) {
+    return BOOTLOADER_ERROR_BOOTLOAD_DELTA_PATCH;
+  }
+  nextOldOffset = patch.oldOffset + diffLength;
+  if ((int32_t)skip < 0) {
+    if ((0U - skip) > nextOldOffset) {
+      return BOOTLOADER_ERROR_BOOTLOAD_DELTA_PATCH;
+    }
+  } else if (skip > (oldSize - nextOldOffset)) {
+    return BOOTLOADER_ERROR_BOOTLOAD_DELTA_PATCH;
+  }
+
+  patch.diffLength = diffLength;
+  patch.extraLength = extraLength;
+  patch.nextOldOffset = nextOldOffset + skip;
+  nextRun();
+  return BOOTLOADER_OK;
+}
+
+// Move on to the next part of the block that holds any bytes
+static void nextRun(void)
+{
+  if (patch.diffLength > 0UL) {
+    patch.state = DELTA_STATE_DIFF;
+    return;
+  }
+
+  patch.oldOffset = patch.nextOldOffset;
+  if (patch.extraLength > 0UL) {
+    patch.state = DELTA_STATE_EXTRA;
+  } else {
+    patch.state = DELTA_STATE_HEADER;
+    patch.headerPos = 0U;
+  }
+}
+
+// Program the output buffer to the scratch region, erasing each page as the
+// image reaches it
+static void writeBuffer(uint32_t offset, size_t length)
+{
+  uint32_t address = patch.scratchAddress + offset;
+
+  if ((address % FLASH_PAGE_SIZE) == 0UL) {
+    (void)flash_erasePage(address);
+  }
+  // A failed write shows up in the CRC check before installing
+  (void)flash_writeBuffer(address, outputBuffer, length);
+}
+
+// --------------------------------
+// Global functions
+
+int32_t delta_applyPatch(uint32_t offset, const uint8_t data[], size_t length)
+{
+  if (offset == 0UL) {
+    (void)memset(&patch, 0, sizeof(patch));
+    patch.state = DELTA_STATE_PATCH_HEADER;
+    patch.status = BOOTLOADER_OK;
+  }
+
+  if ((patch.status == BOOTLOADER_OK) && (offset != patch.patchOffset)) {
+    // Patch data must arrive in order
+    patch.status = BOOTLOADER_ERROR_BOOTLOAD_DELTA_PATCH;
+  }
+
+  while ((patch.status == BOOTLOADER_OK) && (length > 0U)) {
+    size_t count;
+
+    if ((patch.state == DELTA_STATE_PATCH_HEADER)
+        || (patch.state == DELTA_STATE_HEADER)) {
+      count = SL_MIN(length, DELTA_HEADER_SIZE - patch.headerPos);
+      (void)memcpy(&patch.header[patch.headerPos], data, count);
+      patch.headerPos += count;
+
+      if (patch.headerPos == DELTA_HEADER_SIZE) {
+        if (patch.state == DELTA_STATE_HEADER) {
+          patch.status = parseHeader();
+        } else {
+          patch.status = parsePatchHeader();
+        }
+      }
+    } else {
+      size_t bufferPos = patch.newOffset % DELTA_BUFFER_SIZE;
+      uint32_t *runLength = (patch.state == DELTA_STATE_DIFF)
+                            ? &patch.diffLength : &patch.extraLength;
+      count = SL_MIN(SL_MIN(length, *runLength),
+                     DELTA_BUFFER_SIZE - bufferPos);
+
+      if (patch.state == DELTA_STATE_DIFF) {
+        // The installed application is read where it is in flash
+        const uint8_t *old = (const uint8_t *)
+                             ((uint32_t)mainBootloaderTable->startOfAppSpace
+                              + patch.oldOffset);
+        for (size_t i = 0U; i < count; i++) {
+          outputBuffer[bufferPos + i] = (uint8_t)(data[i] + old[i]);
+        }
+        patch.oldOffset += count;
+      } else {
+        (void)memcpy(&outputBuffer[bufferPos], data, count);
+      }
+
+      patch.newOffset += count;
+      *runLength -= count;
+      if ((patch.newOffset % DELTA_BUFFER_SIZE) == 0UL) {
+        writeBuffer(patch.newOffset - DELTA_BUFFER_SIZE, DELTA_BUFFER_SIZE);
+      }
+      if (*runLength == 0UL) {
+        nextRun();
+      }
+    }
+
+    data += count;
+    length -= count;
+    patch.patchOffset += count;
+  }
+
+  return patch.status;
+}
+
+int32_t delta_installImage(uint32_t size, uint32_t crc)
+{
+  const uint8_t *image = (const uint8_t *)patch.scratchAddress;
+  uint32_t startOfAppSpace = (uint32_t)mainBootloaderTable->startOfAppSpace;
+  size_t bufferPos = size % DELTA_BUFFER_SIZE;
+  uint32_t alignedSize = (size + 3UL) & ~3UL;
+  uint32_t pc;
+  // Decompressed patches are padded to a whole word with 0xFF, which
+  // can't be mistaken for a block header
+  bool complete = (patch.state == DELTA_STATE_HEADER) && (patch.headerPos < 4U);
+
+  if (patch.status != BOOTLOADER_OK) {
+    return patch.status;
+  }
+  for (size_t i = 0U; complete && (i < patch.headerPos); i++) {
+    complete = (patch.header[i] == 0xFFU);
+  }
+  // The patch must end after a whole block and produce the whole image,
+  // which holds at least the initial stack pointer and program counter
+  if (!complete || (patch.newOffset != size) || (size < 8UL)) {
+    BTL_DEBUG_PRINTLN("Delta incomplete");
+    return BOOTLOADER_ERROR_BOOTLOAD_DELTA_PATCH;
+  }
+
+  // Write out the end of the image, padded to a whole word
+  if (bufferPos > 0U) {
+    size_t length = (bufferPos + 3U) & ~3U;
+    (void)memset(&outputBuffer[bufferPos], 0xFF, length - bufferPos);
+    writeBuffer(size - bufferPos, length);
+  }
+
+  if ((~btl_crc32Stream(image, size, BTL_CRC32_START)) != crc) {
+    BTL_DEBUG_PRINTLN("Delta CRC");
+    return BOOTLOADER_ERROR_BOOTLOAD_DELTA_CRC;
+  }
+
+  // Copy the image, holding back the program counter. As for a full upgrade,
+  // a valid program counter marks a complete application. The scratch region
+  // starts at least a page into the application space, so the image is read
+  // from each page before the copy erases it.
+  (void)memcpy(&pc, &image[4], 4U);
+  for (uint32_t offset = 0UL; offset < alignedSize; offset += DELTA_BUFFER_SIZE) {
+    size_t length = SL_MIN(DELTA_BUFFER_SIZE, alignedSize - offset);
+    (void)memcpy(outputBuffer, &image[offset], length);
+    if (offset == 0UL) {
+      (void)memset(&outputBuffer[4], 0xFF, 4U);
+    }
+    bootload_applicationCallback(startOfAppSpace + offset,
+                                 outputBuffer,
+                                 length,
+                                 NULL);
+  }
+  bootload_applicationCallback(startOfAppSpace + 4UL,
+                               (uint8_t *)&pc,
+                               4U,
+                               NULL);
+  bootload_flushFlashWrites();
+
+  // The patch can't be installed twice
+  patch.status = BOOTLOADER_ERROR_BOOTLOAD_DELTA_PATCH;
+  return BOOTLOADER_OK;
+}
+
+void *delta_getState(size_t index, size_t *length)
+{
+  if (index >= (sizeof(stateRegions) / sizeof(stateRegions[0]))) {
+    *length = 0U;
+    return NULL;
+  }
+
+  *length = stateRegions[index].length;
+  return stateRegions[index].data;
+}
+
+void delta_getScratchRange(uint32_t *start, uint32_t *end)
+{
+  // Bytes in the output buffer are not programmed yet
+  *start = patch.scratchAddress;
+  *end = patch.scratchAddress
+         + (patch.newOffset - (patch.newOffset % DELTA_BUFFER_SIZE));
+}
+
+#endif // BOOTLOADER_DELTA_OTW
@@ -0,0 +1,134 @@
+/***************************************************************************//**
+ * @file
+ * @brief Delta upgrade functionality for the Silicon Labs bootloader
+ *******************************************************************************
+ * # License
+ * <b>Copyright 2021 Silicon Laboratories Inc. www.silabs.com</b>
+ *******************************************************************************
+ *
+ * The licensor of this software is Silicon Laboratories Inc.  Your use of this
+ * software is governed by the terms of Silicon Labs Master Software License
+ * Agreement (MSLA) available at
+ * www.silabs.com/about-us/legal/master-software-license-agreement.  This
+ * software is distributed to you in Source Code format and is governed by the
+ * sections of the MSLA applicable to Source Code.
+ *
+ ******************************************************************************/
+#ifndef BTL_DELTA_H
+#define BTL_DELTA_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+/***************************************************************************//**
+ * @addtogroup Core Bootloader Core
+ * @{
+ * @addtogroup Delta
+ * @brief Apply delta upgrades without a storage slot
+ * @details
+ *   The new application image is rebuilt from the installed application and
+ *   a patch while the patch is received. The image is assembled in a scratch
+ *   region of flash, from the first page above the installed application to
+ *   the end of the application space, and is only copied to the application
+ *   area once it has been verified. The installed application, rounded up
+ *   to a whole page, and the new image together must fit in the application
+ *   space. On the EFR32ZG23 with 512 KiB of flash, that allows images of up
+ *   to about 244 KiB each, or 204 KiB with resumable XMODEM uploads, which
+ *   rules out the Z-Wave controller firmware of about 400 KB.
+ *
+ *   The copy overwrites the installed application, so an interrupted copy
+ *   leaves no bootable application, as an interrupted full upgrade does. The
+ *   program counter is written last, so the bootloader stays active and
+ *   accepts a full upgrade file.
+ *
+ *   The patch starts with a header of three little-endian words:
+ *   - The word @ref DELTA_PATCH_MAGIC.
+ *   - The size of the installed application the patch applies to.
+ *   - The CRC-32 of the installed application.
+ *
+ *   The installed application is checked against the header before anything
+ *   is erased. Any number of blocks follow the header. Each block starts with
+ *   three little-endian words:
+ *   - The number of diff bytes. Each diff byte is added to the next byte of
+ *     the installed application to form a byte of the new image.
+ *   - The number of extra bytes. Extra bytes are copied to the new image as
+ *     they are.
+ *   - A signed offset, added to the position in the installed application
+ *     after the diff bytes.
+ *
+ *   The diff bytes and then the extra bytes follow the header. The position
+ *   in the installed application starts at the start of the application
+ *   area. This is the control, diff and extra data of a bsdiff patch,
+ *   interleaved per block. Up to three bytes of 0xFF may follow the last
+ *   block. tools/mkdelta.py creates delta GBL files in this format.
+ * @{
+ ******************************************************************************/
+
+/// Word at the start of a delta patch, "DLT1"
+#define DELTA_PATCH_MAGIC         0x31544C44UL
+
+/***************************************************************************//**
+ * Apply delta patch data.
+ *
+ * Patch data must be passed in order. Data at offset 0 starts a new patch.
+ * The rebuilt image is written to the scratch region as it is produced.
+ *
+ * @param[in] offset Offset of the data in the patch
+ * @param[in] data   Patch data
+ * @param[in] length Number of bytes of patch data
+ *
+ * @return BOOTLOADER_OK if successful, BOOTLOADER_ERROR_BOOTLOAD_DELTA_PATCH
+ *         if the patch is malformed, was made for a different installed
+ *         application, or reaches outside the installed application or the
+ *         scratch region
+ ******************************************************************************/
+int32_t delta_applyPatch(uint32_t offset, const uint8_t data[], size_t length);
+
+/***************************************************************************//**
+ * Install the image rebuilt from a delta patch.
+ *
+ * Checks that the patch is complete and that the rebuilt image has the
+ * expected size and CRC, and then copies it to the application area. The
+ * program counter of the application is written last. The patch must have
+ * been authenticated before, as part of the upgrade file.
+ *
+ * @param[in] size Size of the new image in bytes
+ * @param[in] crc  CRC-32 of the new image
+ *
+ * @return BOOTLOADER_OK if successful, BOOTLOADER_ERROR_BOOTLOAD_DELTA_PATCH
+ *         if the patch is incomplete or the image has the wrong size,
+ *         BOOTLOADER_ERROR_BOOTLOAD_DELTA_CRC if the image has the wrong CRC
+ ******************************************************************************/
+int32_t delta_installImage(uint32_t size, uint32_t crc);
+
+/***************************************************************************//**
+ * Get a region of the delta patch state.
+ *
+ * The patch state is kept in static memory between calls. Saving all regions
+ * and copying them back later resumes patching where it left off, since the
+ * image rebuilt so far stays in the scratch region.
+ *
+ * @param[in]  index  Index of the region, starting at 0
+ * @param[out] length Size of the region in bytes, 0 if index is out of range
+ *
+ * @return Start of the region, or NULL if index is out of range
+ ******************************************************************************/
+void *delta_getState(size_t index, size_t *length);
+
+/***************************************************************************//**
+ * Get the flash programmed with the image rebuilt so far.
+ *
+ * The rebuilt image is part of the patch state, but is kept in flash. A
+ * resumed patch must find it unchanged.
+ *
+ * @param[out] start Start address of the programmed flash
+ * @param[out] end   End address of the programmed flash, equal to start if
+ *                   none has been programmed
+ ******************************************************************************/
+void delta_getScratchRange(uint32_t *start, uint32_t *end);
+
+/** @} addtogroup Delta */
+/** @} addtogroup Core */
+
+#endif // BTL_DELTA_H
@@ -17,6 +17,7 @@
 #include "core/flash/btl_internal_flash.h"
 
 #include "core/btl_util.h"
+#include "debug/btl_debug.h"
 
 MISRAC_DISABLE
 #include "em_cmu.h"
@@ -70,12 +71,69 @@ static MSC_Status_TypeDef writeHalfwordDMA(uint32_t address,
 }
 #endif // !defined(_SILICON_LABS_32B_SERIES_2)
 
+#if defined(_SILICON_LABS_32B_SERIES_2)
+// State of the background write started by flash_writeBuffer_dmaAsync
+static struct {
+  uint32_t dst;
+  uint32_t src;
+  uint32_t remaining;
+  uint32_t burstLength;
+  int      ch;
+  bool     busy;
+  bool     wasLocked;
+  bool     result;
+} asyncWrite = { .result = true };
+
+static void asyncWriteEnd(bool result)
+{
+  // Disable writing to the MSC module
+  MSC->WRITECTRL &= ~MSC_WRITECTRL_WREN;
+  if (asyncWrite.wasLocked) {
+    MSC->LOCK = MSC_LOCK_LOCKKEY_LOCK;
+  }
+  asyncWrite.result = result;
+  asyncWrite.busy = false;
+}
+
+// Start the LDMA transfer for the next burst, which is at most the remainder of
+// the current flash page, the same way MSC_WriteWordDma splits a write
+static void asyncWriteStartBurst(void)
+{
+  asyncWrite.burstLength = SL_MIN(asyncWrite.remaining,
+                                  ((asyncWrite.dst + FLASH_PAGE_SIZE)
+                                   & ~(FLASH_PAGE_SIZE - 1UL))
+                                  - asyncWrite.dst);
+
+  MSC->ADDRB = asyncWrite.dst;
+  if (MSC->STATUS & MSC_STATUS_INVADDR) {
+    asyncWriteEnd(false);
+    return;
+  }
+
+  LDMA->CH[asyncWrite.ch].CTRL = LDMA_CH_CTRL_DSTINC_NONE
+                                 | LDMA_CH_CTRL_SIZE_WORD
+                                 | (((asyncWrite.burstLength / 4UL) - 1UL)
+                                    << _LDMA_CH_CTRL_XFERCNT_SHIFT);
+  LDMA->CH[asyncWrite.ch].SRC = asyncWrite.src;
+  LDMA->CH[asyncWrite.ch].DST = (uint32_t)&MSC->WDATA;
+  LDMA->CHEN_SET = (0x1UL << asyncWrite.ch);
+}
+#endif // defined(_SILICON_LABS_32B_SERIES_2)
+
+SL_WEAK void flash_stallCallback(void)
+{
+}
+
 bool flash_erasePage(uint32_t address)
 {
+  flash_stallCallback();
+  (void)flash_waitForWrite();
 #if defined(_CMU_CLKEN1_MASK)
   CMU->CLKEN1_SET = CMU_CLKEN1_MSC;
 #endif
+  BTL_PROFILE_BEGIN(PAGE_ERASE);
   MSC_Status_TypeDef retval = MSC_ErasePage((uint32_t *)address);
+  BTL_PROFILE_END(PAGE_ERASE, FLASH_PAGE_SIZE);
   if (retval == mscReturnOk) {
     return true;
   } else {
@@ -90,6 +148,10 @@ bool flash_writeBuffer_dma(uint32_t       address,
 {
   MSC_Status_TypeDef retval = mscReturnOk;
 
+  if (length >= FLASH_STALL_WRITE_LENGTH) {
+    flash_stallCallback();
+  }
+  (void)flash_waitForWrite();
   if ((ch < 0) || (ch >= (int)DMA_CHAN_COUNT)) {
     return false;
   }
@@ -115,7 +177,9 @@ bool flash_writeBuffer_dma(uint32_t       address,
   CMU->CLKEN1_SET = CMU_CLKEN1_MSC;
 #endif
 
+  BTL_PROFILE_BEGIN(WORD_WRITE);
   retval = MSC_WriteWordDma(ch, (uint32_t *)address, data, length);
+  BTL_PROFILE_END(WORD_WRITE, length);
 #else
   uint16_t * data16 = (uint16_t *)data;
 
@@ -138,7 +202,9 @@ bool flash_writeBuffer_dma(uint32_t       address,
   if (length >= 4UL) {
     uint32_t length16 = (length & ~3UL);
 
+    BTL_PROFILE_BEGIN(WORD_WRITE);
     retval = MSC_WriteWordDma(ch, (uint32_t *)address, data16, length16);
+    BTL_PROFILE_END(WORD_WRITE, length16);
 
     data16 += length16 / sizeof(uint16_t);
     address += length16;
@@ -170,6 +236,10 @@ bool flash_writeBuffer(uint32_t       address,
 {
   MSC_Status_TypeDef retval = mscReturnOk;
 
+  if (length >= FLASH_STALL_WRITE_LENGTH) {
+    flash_stallCallback();
+  }
+  (void)flash_waitForWrite();
   if (length == 0UL) {
     // Attempt to write zero-length array, return immediately
     return true;
@@ -185,7 +255,9 @@ bool flash_writeBuffer(uint32_t       address,
   CMU->CLKEN1_SET = CMU_CLKEN1_MSC;
 #endif
 
+  BTL_PROFILE_BEGIN(WORD_WRITE);
   retval = MSC_WriteWord((uint32_t *)address, data, length);
+  BTL_PROFILE_END(WORD_WRITE, length);
 #else
   uint16_t * data16 = (uint16_t *)data;
 
@@ -207,7 +279,9 @@ bool flash_writeBuffer(uint32_t       address,
   // Flash word-aligned data
   if (length >= 4UL) {
     uint32_t length16 = (length & ~3UL);
+    BTL_PROFILE_BEGIN(WORD_WRITE);
     retval = MSC_WriteWord((uint32_t *)address, data16, length16);
+    BTL_PROFILE_END(WORD_WRITE, length16);
     data16 += length16 / sizeof(uint16_t);
     address += length16;
     length -= length16;
@@ -231,3 +305,108 @@ bool flash_writeBuffer(uint32_t       address,
     return false;
   }
 }
+
+bool flash_writeBuffer_dmaAsync(uint32_t       address,
+                                const void     *data,
+                                size_t         length,
+                                int            ch)
+{
+#if defined(_SILICON_LABS_32B_SERIES_2)
+  (void)flash_waitForWrite();
+
+  if ((ch < 0) || (ch >= (int)DMA_CHAN_COUNT)) {
+    return false;
+  }
+  if (length == 0UL) {
+    // Attempt to write zero-length array, return immediately
+    return true;
+  }
+  if ((address & 3UL) || (length & 3UL) || ((uint32_t)data & 3UL)) {
+    // Unaligned write, return early
+    return false;
+  }
+
+  MISRAC_DISABLE
+  CMU_ClockEnable(cmuClock_LDMA, true);
+#if defined(CMU_CLKEN0_LDMAXBAR)
+  CMU_ClockEnable(cmuClock_LDMAXBAR, true);
+#endif
+  MISRAC_ENABLE
+#if defined(_CMU_CLKEN1_MASK)
+  CMU->CLKEN1_SET = CMU_CLKEN1_MSC;
+#endif
+
+  // Channel setup as done by MSC_WriteWordDma
+  LDMA->EN_SET = 0x1UL;
+  LDMAXBAR->CH[ch].REQSEL = LDMAXBAR_CH_REQSEL_SOURCESEL_MSC
+                            | LDMAXBAR_CH_REQSEL_SIGSEL_MSCWDATA;
+  LDMA->CH[ch].CFG = _LDMA_CH_CFG_RESETVALUE;
+  LDMA->CH[ch].LOOP = _LDMA_CH_LOOP_RESETVALUE;
+  LDMA->CH[ch].LINK = _LDMA_CH_LINK_RESETVALUE;
+
+  // Unlock and enable writing to the MSC module until the write completes
+#if defined(_MSC_STATUS_REGLOCK_MASK)
+  asyncWrite.wasLocked = ((MSC->STATUS & _MSC_STATUS_REGLOCK_MASK) != 0U);
+#else
+  asyncWrite.wasLocked = ((MSC->LOCK & _MSC_LOCK_MASK) != 0U);
+#endif
+  MSC->LOCK = MSC_LOCK_LOCKKEY_UNLOCK;
+  MSC->WRITECTRL |= MSC_WRITECTRL_WREN;
+
+  asyncWrite.dst = address;
+  asyncWrite.src = (uint32_t)data;
+  asyncWrite.remaining = length;
+  asyncWrite.ch = ch;
+  asyncWrite.result = true;
+  asyncWrite.busy = true;
+  asyncWriteStartBurst();
+
+  return asyncWrite.result;
+#else
+  return flash_writeBuffer_dma(address, data, length, ch);
+#endif
+}
+
+bool flash_isWriteBusy(void)
+{
+#if defined(_SILICON_LABS_32B_SERIES_2)
+  if (asyncWrite.busy
+      && ((LDMA->CHDONE & (0x1UL << asyncWrite.ch)) != 0UL)) {
+    // Burst transferred; finish it and continue with the next flash page
+    LDMA->CHDONE_CLR = (0x1UL << asyncWrite.ch);
+    LDMA->CHDIS_SET = (0x1UL << asyncWrite.ch);
+    MSC->WRITECMD = MSC_WRITECMD_WRITEEND;
+
+    asyncWrite.dst += asyncWrite.burstLength;
+    asyncWrite.src += asyncWrite.burstLength;
+    asyncWrite.remaining -= asyncWrite.burstLength;
+    if (asyncWrite.remaining > 0UL) {
+      asyncWriteStartBurst();
+    } else {
+      asyncWriteEnd(true);
+    }
+  }
+  return asyncWrite.busy;
+#else
+  return false;
+#endif
+}
+
+bool flash_waitForWrite(void)
+{
+#if defined(_SILICON_LABS_32B_SERIES_2)
+  if (asyncWrite.busy) {
+    if (asyncWrite.remaining >= FLASH_STALL_WRITE_LENGTH) {
+      flash_stallCallback();
+    }
+    BTL_PROFILE_BEGIN(WORD_WRITE);
+    while (flash_isWriteBusy()) {
+      // Do nothing
+    }
+    BTL_PROFILE_END(WORD_WRITE, 0UL);
+  }
+  return asyncWrite.result;
+#else
+  return true;
+#endif
+}
@@ -41,6 +41,10 @@ MISRAC_ENABLE
 /// DMA Channel for MSC write
 #define SL_GBL_MSC_LDMA_CHANNEL     2
 
+/// Blocking writes of at least this many bytes call
+/// @ref flash_stallCallback before they start
+#define FLASH_STALL_WRITE_LENGTH    256UL
+
 // -----------------------------------------------------------------------------
 // Prototypes
 
@@ -66,6 +70,40 @@ bool flash_writeBuffer_dma(uint32_t       address,
                            size_t         length,
                            int            ch);
 
+/**
+ * Start writing a buffer to internal flash in the background.
+ *
+ * The write is performed by LDMA. The data buffer must remain valid and
+ * unchanged until @ref flash_waitForWrite returns. Any previously started
+ * background write is completed first. On devices without support for
+ * background writes, the data is written before returning.
+ *
+ * @param address   Starting address to write data to. Must be word aligned.
+ * @param data      Data buffer to write to internal flash. Must be word aligned.
+ * @param length    Amount of bytes in the data buffer to write
+ * @param ch        DMA channel to use
+ * @return True if the write was started successfully
+ */
+bool flash_writeBuffer_dmaAsync(uint32_t       address,
+                                const void     *data,
+                                size_t         length,
+                                int            ch);
+
+/**
+ * Advance a background write started by @ref flash_writeBuffer_dmaAsync.
+ *
+ * @return True if the background write is still in progress
+ */
+bool flash_isWriteBusy(void);
+
+/**
+ * Wait for a background write started by @ref flash_writeBuffer_dmaAsync to
+ * complete.
+ *
+ * @return True if the last background write was successful
+ */
+bool flash_waitForWrite(void);
+
 /**
  * Write buffer to internal flash.
  *
@@ -78,6 +116,17 @@ bool flash_writeBuffer(uint32_t       address,
                        const void           *data,
                        size_t         length);
 
+/**
+ * Called before the CPU stalls on flash: before each page erase, and before
+ * blocking writes and waits for background writes of at least
+ * @ref FLASH_STALL_WRITE_LENGTH bytes. Polling loops don't run until the
+ * operation completes.
+ *
+ * The default implementation does nothing. The UART XMODEM communication
+ * interface overrides it to stop the host sending.
+ */
+void flash_stallCallback(void);
+
 /** @} addtogroup internal_flash */
 /** @} addtogroup core */
 
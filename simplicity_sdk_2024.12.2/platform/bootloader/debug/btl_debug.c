@@ -130,3 +130,40 @@ void btl_debugWriteNewline(void)
 }
 
 #endif // BTL_PLUGIN_DEBUG_PRINT
+
+#if defined(SL_DEBUG_PROFILE) && (SL_DEBUG_PROFILE == 1)
+
+#include <string.h>
+
+static BtlProfileStats_t profileStats[BTL_PROFILE_STAGE_COUNT];
+
+void btl_profileReset(void)
+{
+#if defined(DWT)
+  CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+  DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+#endif
+  (void)memset(profileStats, 0, sizeof(profileStats));
+}
+
+void btl_profileAdd(BtlProfileStage_t stage, uint32_t start, uint32_t bytes)
+{
+  // Unsigned subtraction handles a single wrap of the cycle counter
+  uint32_t elapsed = BTL_PROFILE_CLOCK() - start;
+
+  if (stage < BTL_PROFILE_STAGE_COUNT) {
+    profileStats[stage].calls++;
+    profileStats[stage].bytes += bytes;
+    profileStats[stage].cycles += elapsed;
+  }
+}
+
+const BtlProfileStats_t *btl_profileGetStats(BtlProfileStage_t stage)
+{
+  if (stage >= BTL_PROFILE_STAGE_COUNT) {
+    return NULL;
+  }
+  return &profileStats[stage];
+}
+
+#endif // SL_DEBUG_PROFILE
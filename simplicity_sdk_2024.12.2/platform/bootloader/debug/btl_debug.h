@@ -112,6 +112,59 @@ void btl_debugWriteNewline(void);
 
 #endif
 
+// Accumulate time spent in the image processing hot path
+#if defined(SL_DEBUG_PROFILE) && (SL_DEBUG_PROFILE == 1)
+
+/// Stages of the image processing hot path covered by profiling probes
+typedef enum {
+  BTL_PROFILE_STAGE_UART_WAIT = 0,      ///< Waiting for a packet from the UART
+  BTL_PROFILE_STAGE_XMODEM_CRC,         ///< XMODEM packet CRC16
+  BTL_PROFILE_STAGE_GBL_CRC32,          ///< GBL file CRC32
+  BTL_PROFILE_STAGE_GBL_COPY,           ///< GBL data copied by the parser
+  BTL_PROFILE_STAGE_SHA_UPDATE,         ///< SHA-256 update
+  BTL_PROFILE_STAGE_AES_CTR,            ///< AES-CTR decryption
+  BTL_PROFILE_STAGE_LZMA_DECODE,        ///< LZMA decompression
+  BTL_PROFILE_STAGE_LZ4_DECODE,         ///< LZ4 decompression
+  BTL_PROFILE_STAGE_FLASH_CALLBACK,     ///< Application data callback
+  BTL_PROFILE_STAGE_PAGE_ERASE,         ///< Flash page erase
+  BTL_PROFILE_STAGE_WORD_WRITE,         ///< Flash word write
+  BTL_PROFILE_STAGE_COUNT               ///< Number of profiling stages
+} BtlProfileStage_t;
+
+/// Accumulated statistics of one profiling stage
+typedef struct {
+  uint32_t calls;                       ///< Number of times the stage ran
+  uint32_t bytes;                       ///< Number of bytes processed
+  uint64_t cycles;                      ///< Number of clock cycles spent
+} BtlProfileStats_t;
+
+#ifndef BTL_PROFILE_CLOCK
+/// Free running cycle counter used as profiling time base
+#define BTL_PROFILE_CLOCK()               (DWT->CYCCNT)
+#endif
+
+void btl_profileReset(void);
+void btl_profileAdd(BtlProfileStage_t stage, uint32_t start, uint32_t bytes);
+const BtlProfileStats_t *btl_profileGetStats(BtlProfileStage_t stage);
+
+#define BTL_PROFILE_RESET()               (btl_profileReset())
+#define BTL_PROFILE_BEGIN(stage) \
+  const uint32_t btlProfileStart_ ## stage = BTL_PROFILE_CLOCK()
+#define BTL_PROFILE_END(stage, bytes)                  \
+  (btl_profileAdd(BTL_PROFILE_STAGE_ ## stage,         \
+                  btlProfileStart_ ## stage, (uint32_t)(bytes)))
+
+#else // No profiling
+
+/// Clear all profiling statistics and start the cycle counter
+#define BTL_PROFILE_RESET()               do {} while (0)
+/// Mark the start of a profiled stage in the current scope
+#define BTL_PROFILE_BEGIN(stage)          do {} while (0)
+/// Account the time since the matching BTL_PROFILE_BEGIN to a stage
+#define BTL_PROFILE_END(stage, bytes)     do {} while (0)
+
+#endif
+
 /**
  * @} (end addtogroup Debug)
  * @} (end addtogroup Components)
@@ -29,6 +29,9 @@
 #include "em_bus.h"
 
 #include "debug/btl_debug.h"
+
+#include <string.h>
+
 #ifdef BTL_CONFIG_FILE
 #include BTL_CONFIG_FILE
 #else
@@ -89,6 +92,22 @@
 #if (SL_DRIVER_UART_RX_BUFFER_SIZE % 2) != 0
 #error "UART RX buffer size is not even"
 #endif
+#if (SL_SERIAL_UART_FLOW_CONTROL == 1)
+#if !defined(SL_SERIAL_UART_RTS_PORT) || !defined(SL_SERIAL_UART_RTS_PIN) \
+  || !defined(SL_SERIAL_UART_CTS_PORT) || !defined(SL_SERIAL_UART_CTS_PIN)
+#error "UART flow control enabled without RTS and CTS pins"
+#endif
+#if !defined(SL_SERIAL_UART_RTS_HEADROOM)
+#define SL_SERIAL_UART_RTS_HEADROOM        256
+#endif
+#if (2 * SL_SERIAL_UART_RTS_HEADROOM) > (SL_DRIVER_UART_RX_BUFFER_SIZE / 2)
+#error "UART RTS headroom too large for the RX buffer"
+#endif
+#endif
+
+// Bit times the receive line must be idle for the timer comparator to expire.
+// Longer idle times are measured by counting consecutive expirations.
+#define UART_RX_IDLE_PERIOD_BITS           250U
 
 // A btl_uart_drv driver instance initialization structure contains peripheral name
 // of the uart and cmu_clock_type.
@@ -118,6 +137,21 @@ static size_t  txLength;
 /// Index into the receive buffer indicating which byte is due to be read next.
 static size_t  rxHead;
 
+/// Current baud rate
+static uint32_t currentBaudRate;
+
+/// Idle periods ending a blocking receive, 0 if idle detection is disabled
+static uint32_t rxIdlePeriods;
+/// Idle periods counted since data was last received
+static uint32_t rxIdleCount;
+/// LDMA write position when data was last received
+static size_t  rxIdleLdmaHead;
+
+#if (SL_SERIAL_UART_FLOW_CONTROL == 1)
+/// Whether RTS currently allows the host to send
+static bool    rtsAsserted;
+#endif
+
 /// LDMA channel configuration triggering on free space in UART transmit FIFO
 static LDMA_TransferCfg_t ldmaTxTransfer = LDMA_TRANSFER_CFG_PERIPHERAL(BTL_DRIVER_UART_LDMA_TXBL_SIGNAL);
 /// LDMA channel configuration triggering on available byte in UART receive FIFO
@@ -158,6 +192,186 @@ static LDMA_Descriptor_t ldmaRxDesc[4] = {
     -3
     )
 };
+//  ‐‐‐‐‐‐‐‐‐‐‐‐‐‐‐‐‐‐‐‐‐‐‐‐‐‐‐‐‐‐‐‐‐‐‐‐‐‐‐‐‐‐‐‐‐‐‐‐‐‐‐‐‐‐‐‐‐‐‐‐‐‐‐‐‐‐‐‐‐‐‐‐‐‐‐‐‐
+// Static functions
+
+/**
+ * Calculate the USART clock divider for a baud rate, using 16x oversampling.
+ *
+ * @param[in] baudRate The baud rate
+ *
+ * @return Clock divider value, which exceeds _USART_CLKDIV_DIV_MASK if the
+ *   baud rate can't be reached
+ */
+static uint32_t uart_calculateClkDiv(uint32_t baudRate)
+{
+  uint32_t refFreq;
+  uint32_t clkdiv;
+
+  refFreq = util_getClockFreq();
+#if defined(_SILICON_LABS_32B_SERIES_2)
+  refFreq = refFreq / (1U + ((CMU->SYSCLKCTRL & _CMU_SYSCLKCTRL_PCLKPRESC_MASK)
+                             >> _CMU_SYSCLKCTRL_PCLKPRESC_SHIFT));
+#endif
+  clkdiv = 32 * refFreq + (16 * baudRate) / 2;
+  clkdiv /= (16 * baudRate);
+  if (clkdiv < 32) {
+    // Baud rate too high for the peripheral clock
+    return UINT32_MAX;
+  }
+  clkdiv -= 32;
+  clkdiv *= 8;
+
+  return clkdiv;
+}
+
+/**
+ * Move the read position forward, handing each half of the receive buffer
+ * back to the LDMA once the read position has passed its end.
+ *
+ * @param[in] length Number of bytes to move forward
+ */
+static void uart_advanceRxHead(size_t length)
+{
+  while (length > 0U) {
+    size_t boundary = (rxHead < (SL_DRIVER_UART_RX_BUFFER_SIZE / 2))
+                      ? (SL_DRIVER_UART_RX_BUFFER_SIZE / 2)
+                      : SL_DRIVER_UART_RX_BUFFER_SIZE;
+    size_t chunk = SL_MIN(length, boundary - rxHead);
+
+    rxHead += chunk;
+    length -= chunk;
+
+    if (rxHead == SL_DRIVER_UART_RX_BUFFER_SIZE) {
+      rxHead = 0;
+      // Completed processing of second half of the buffer, mark it as
+      // available for LDMA again by setting SYNC[1]
+#if defined(_LDMA_SYNCSWSET_MASK)
+      LDMA->SYNCSWSET_SET = 1 << 1;
+#else
+      BUS_RegMaskedSet(&LDMA->SYNC, 1 << 1);
+#endif
+    } else if (rxHead == SL_DRIVER_UART_RX_BUFFER_SIZE / 2) {
+      // Completed processing of first half of the buffer, mark it as
+      // available for LDMA again by setting SYNC[0]
+#if defined(_LDMA_SYNCSWSET_MASK)
+      LDMA->SYNCSWSET_SET = 1 << 0;
+#else
+      BUS_RegMaskedSet(&LDMA->SYNC, 1 << 0);
+#endif
+    }
+  }
+}
+
+/**
+ * Get the position in the receive buffer the LDMA writes the next byte to.
+ *
+ * @return Index into the receive buffer
+ */
+static size_t uart_getLdmaHead(void)
+{
+  size_t dst;
+
+  // Get destination address for next transfer
+  dst = LDMA->CH[SL_DRIVER_UART_LDMA_RX_CHANNEL].DST;
+
+  if (dst == 0x0101) {
+    // SYNC descriptor with bit 0 of MATCHEN and MATCHVAL set
+    return 0;
+  } else if (dst == 0x0202) {
+    // SYNC descriptor with bit 1 of MATCHEN and MATCHVAL set
+    return SL_DRIVER_UART_RX_BUFFER_SIZE / 2;
+  } else {
+    // XFER descriptor with absolute address in buffer
+    return dst - (uint32_t)(rxBuffer);
+  }
+}
+
+#if defined(_USART_TIMECMP1_MASK)
+/**
+ * Clear the flag set each time the receive line idle timer expires.
+ */
+static void uart_clearRxIdleFlag(void)
+{
+#if defined(_USART_IFC_MASK)
+  sl_uart_init_inst.port->IFC = USART_IFC_TCMP1;
+#else
+  sl_uart_init_inst.port->IF_CLR = USART_IF_TCMP1;
+#endif
+}
+#endif
+
+#if (SL_SERIAL_UART_FLOW_CONTROL == 1)
+/**
+ * Drive RTS from the fill level of the receive buffer. RTS is deasserted
+ * once the free space drops below the headroom, and asserted again once
+ * twice the headroom is free.
+ *
+ * @param[in] available Number of unread bytes in the receive buffer
+ */
+static void uart_updateRts(size_t available)
+{
+  // Bytes already read from the current half are not free until the read
+  // position leaves that half
+  size_t space = SL_DRIVER_UART_RX_BUFFER_SIZE
+                 - available
+                 - (rxHead % (SL_DRIVER_UART_RX_BUFFER_SIZE / 2));
+
+  if (rtsAsserted && (space < SL_SERIAL_UART_RTS_HEADROOM)) {
+    GPIO_PinOutSet(SL_SERIAL_UART_RTS_PORT, SL_SERIAL_UART_RTS_PIN);
+    rtsAsserted = false;
+  } else if (!rtsAsserted && (space >= (2U * SL_SERIAL_UART_RTS_HEADROOM))) {
+    GPIO_PinOutClear(SL_SERIAL_UART_RTS_PORT, SL_SERIAL_UART_RTS_PIN);
+    rtsAsserted = true;
+  }
+}
+#endif
+
+/**
+ * Find out whether the receive line has been idle for the time set with
+ * @ref uart_setRxIdleTimeout.
+ *
+ * @return true if no data was received for at least the idle timeout
+ */
+static bool uart_isRxIdle(void)
+{
+#if defined(_USART_TIMECMP1_MASK)
+  size_t ldmaHead;
+
+  if (rxIdlePeriods == 0U) {
+    return false;
+  }
+
+#if (SL_SERIAL_UART_FLOW_CONTROL == 1)
+  if (!rtsAsserted) {
+    // The host was told to stop sending; the line is expected to go idle
+    rxIdleCount = 0;
+    uart_clearRxIdleFlag();
+    return false;
+  }
+#endif
+
+  ldmaHead = uart_getLdmaHead();
+  if (ldmaHead != rxIdleLdmaHead) {
+    // Data was received; the line was not idle for the periods counted
+    rxIdleLdmaHead = ldmaHead;
+    rxIdleCount = 0;
+    uart_clearRxIdleFlag();
+    return false;
+  }
+
+  if (sl_uart_init_inst.port->IF & USART_IF_TCMP1) {
+    // The timer restarts itself as long as the line stays idle
+    uart_clearRxIdleFlag();
+    rxIdleCount++;
+  }
+
+  return rxIdleCount >= rxIdlePeriods;
+#else
+  return false;
+#endif
+}
+
 //  ‐‐‐‐‐‐‐‐‐‐‐‐‐‐‐‐‐‐‐‐‐‐‐‐‐‐‐‐‐‐‐‐‐‐‐‐‐‐‐‐‐‐‐‐‐‐‐‐‐‐‐‐‐‐‐‐‐‐‐‐‐‐‐‐‐‐‐‐‐‐‐‐‐‐‐‐‐
 // Functions
 
@@ -167,7 +381,6 @@ static LDMA_Descriptor_t ldmaRxDesc[4] = {
  */
 void uart_init(void)
 {
-  uint32_t refFreq;
   uint32_t clkdiv;
 
 #if defined(USART_PRESENT) && defined(EUART_PRESENT)
@@ -304,15 +517,7 @@ void uart_init(void)
 
   // Configure oversampling and baudrate
   sl_uart_init_inst.port->CTRL |= USART_CTRL_OVS_X16;
-  refFreq = util_getClockFreq();
-#if defined(_SILICON_LABS_32B_SERIES_2)
-  refFreq = refFreq / (1U + ((CMU->SYSCLKCTRL & _CMU_SYSCLKCTRL_PCLKPRESC_MASK)
-                             >> _CMU_SYSCLKCTRL_PCLKPRESC_SHIFT));
-#endif
-  clkdiv = 32 * refFreq + (16 * SL_SERIAL_UART_BAUD_RATE) / 2;
-  clkdiv /= (16 * SL_SERIAL_UART_BAUD_RATE);
-  clkdiv -= 32;
-  clkdiv *= 8;
+  clkdiv = uart_calculateClkDiv(SL_SERIAL_UART_BAUD_RATE);
 
   // Verify that resulting clock divider is within limits
   BTL_ASSERT(clkdiv <= _USART_CLKDIV_DIV_MASK);
@@ -321,6 +526,8 @@ void uart_init(void)
   clkdiv &= _USART_CLKDIV_DIV_MASK;
 
   sl_uart_init_inst.port->CLKDIV = clkdiv;
+  currentBaudRate = SL_SERIAL_UART_BAUD_RATE;
+  rxIdlePeriods = 0;
 
   GPIO_PinModeSet(SL_SERIAL_UART_TX_PORT,
                   SL_SERIAL_UART_TX_PIN,
@@ -351,29 +558,27 @@ void uart_init(void)
 
   // Configure CTS/RTS in case of flow control
 #if (SL_SERIAL_UART_FLOW_CONTROL == 1)
+  // RTS is driven by software from the fill level of the receive buffer,
+  // since the USART only deasserts it once its own receive FIFO is full.
+  // Keep it deasserted until reception is set up.
   GPIO_PinModeSet(SL_SERIAL_UART_RTS_PORT,
                   SL_SERIAL_UART_RTS_PIN,
                   gpioModePushPull,
                   1);
+  rtsAsserted = false;
   GPIO_PinModeSet(SL_SERIAL_UART_CTS_PORT,
                   SL_SERIAL_UART_CTS_PIN,
                   gpioModeInput,
                   1);
-  // Configure CTS/RTS route
+  // Configure CTS route
 #if defined(_USART_ROUTEPEN_RESETVALUE)
-  sl_uart_init_inst.port->ROUTELOC1 = (SL_SERIAL_UART_RTS_LOC
-                                       << _USART_ROUTELOC1_RTSLOC_SHIFT)
-                                      | (SL_SERIAL_UART_CTS_LOC
-                                         << _USART_ROUTELOC1_CTSLOC_SHIFT);
-  sl_uart_init_inst.port->ROUTEPEN |= USART_ROUTEPEN_RTSPEN | USART_ROUTEPEN_CTSPEN;
+  sl_uart_init_inst.port->ROUTELOC1 = (SL_SERIAL_UART_CTS_LOC
+                                       << _USART_ROUTELOC1_CTSLOC_SHIFT);
+  sl_uart_init_inst.port->ROUTEPEN |= USART_ROUTEPEN_CTSPEN;
 #else
-  GPIO->USARTROUTE_SET[SL_SERIAL_UART_PERIPHERAL_NO].ROUTEEN = GPIO_USART_ROUTEEN_RTSPEN;
   GPIO->USARTROUTE[SL_SERIAL_UART_PERIPHERAL_NO].CTSROUTE =
     (SL_SERIAL_UART_CTS_PORT << _GPIO_USART_CTSROUTE_PORT_SHIFT)
     | (SL_SERIAL_UART_CTS_PIN << _GPIO_USART_CTSROUTE_PIN_SHIFT);
-  GPIO->USARTROUTE[SL_SERIAL_UART_PERIPHERAL_NO].RTSROUTE =
-    (SL_SERIAL_UART_RTS_PORT << _GPIO_USART_RTSROUTE_PORT_SHIFT)
-    | (SL_SERIAL_UART_RTS_PIN << _GPIO_USART_RTSROUTE_PIN_SHIFT);
 #endif
 
   // Configure USART for flow control
@@ -440,7 +645,9 @@ void uart_init(void)
                      ((1 << SL_DRIVER_UART_LDMA_RX_CHANNEL)
                       | (1 << SL_DRIVER_UART_LDMA_TX_CHANNEL)));
 
-  // Kick off background RX
+  // Kick off background RX, from the start of the buffer also when the
+  // driver is initialized again
+  rxHead = 0;
   LDMA->LINKLOAD = (1 << SL_DRIVER_UART_LDMA_RX_CHANNEL);
 
   // Mark second half of RX buffer as ready
@@ -450,6 +657,11 @@ void uart_init(void)
   BUS_RegMaskedSet(&LDMA->SYNC, 1 << 1);
 #endif
 
+#if (SL_SERIAL_UART_FLOW_CONTROL == 1)
+  // Let the host send
+  uart_updateRts(0);
+#endif
+
   initialized = true;
 }
 
@@ -467,6 +679,111 @@ void uart_deinit(void)
   initialized = false;
 }
 
+/**
+ * Change the baud rate of the UART.
+ *
+ * @param[in] baudRate The new baud rate
+ *
+ * @return BOOTLOADER_OK if successful, error code otherwise
+ */
+int32_t uart_setBaudRate(uint32_t baudRate)
+{
+  uint32_t clkdiv;
+
+  BTL_ASSERT(initialized == true);
+
+  if (baudRate == 0) {
+    return BOOTLOADER_ERROR_UART_ARGUMENT;
+  }
+
+  clkdiv = uart_calculateClkDiv(baudRate);
+  if (clkdiv > _USART_CLKDIV_DIV_MASK) {
+    return BOOTLOADER_ERROR_UART_ARGUMENT;
+  }
+
+  // Let pending transmissions complete at the current baud rate
+  while (!uart_isTxIdle()) {
+    // Do nothing
+  }
+#if defined(USART_STATUS_TXIDLE)
+  while (!(sl_uart_init_inst.port->STATUS & USART_STATUS_TXIDLE)) {
+    // Do nothing
+  }
+#endif
+
+  sl_uart_init_inst.port->CLKDIV = clkdiv;
+  currentBaudRate = baudRate;
+
+  // Anything received around the switch is garbage
+  uart_flush(false, true);
+
+  return BOOTLOADER_OK;
+}
+
+/**
+ * Get the current baud rate of the UART.
+ *
+ * @return The baud rate
+ */
+uint32_t uart_getBaudRate(void)
+{
+  return currentBaudRate;
+}
+
+/**
+ * Make blocking receives give up once the receive line has been idle for a
+ * given time.
+ *
+ * @param[in] microseconds Idle time, 0 to disable
+ */
+void uart_setRxIdleTimeout(uint32_t microseconds)
+{
+  BTL_ASSERT(initialized == true);
+
+#if defined(_USART_TIMECMP1_MASK)
+  if (microseconds == 0U) {
+    sl_uart_init_inst.port->TIMECMP1 = _USART_TIMECMP1_RESETVALUE;
+    rxIdlePeriods = 0;
+    return;
+  }
+
+  // Bit times, rounded up to whole timer periods
+  rxIdlePeriods = ((currentBaudRate / 1000U) * microseconds) / 1000U;
+  rxIdlePeriods = (rxIdlePeriods + UART_RX_IDLE_PERIOD_BITS - 1U)
+                  / UART_RX_IDLE_PERIOD_BITS;
+  if (rxIdlePeriods == 0U) {
+    rxIdlePeriods = 1;
+  }
+
+  // Count bit times from the end of each received frame until the next one
+  // starts, restarting the count each time the comparator expires
+  sl_uart_init_inst.port->TIMECMP1 = (UART_RX_IDLE_PERIOD_BITS
+                                      << _USART_TIMECMP1_TCMPVAL_SHIFT)
+                                     | USART_TIMECMP1_TSTART_RXEOF
+                                     | USART_TIMECMP1_TSTOP_RXACT
+                                     | USART_TIMECMP1_RESTARTEN;
+  uart_clearRxIdleFlag();
+  rxIdleCount = 0;
+  rxIdleLdmaHead = uart_getLdmaHead();
+#else
+  (void)microseconds;
+#endif
+}
+
+/**
+ * Ask the host to stop sending ahead of a time the receive loops can't run.
+ * RTS is asserted again by the next poll of the receive buffer.
+ */
+void uart_pauseRx(void)
+{
+#if (SL_SERIAL_UART_FLOW_CONTROL == 1)
+  if (initialized && rtsAsserted) {
+    GPIO_PinOutSet(SL_SERIAL_UART_RTS_PORT, SL_SERIAL_UART_RTS_PIN);
+    rtsAsserted = false;
+  }
+#endif
+}
+
 /**
  * Write a data buffer to the UART.
  *
@@ -486,7 +803,12 @@ int32_t uart_sendBuffer(const uint8_t* buffer, size_t length, bool blocking)
     return BOOTLOADER_ERROR_SPI_PERIPHERAL_ARGUMENT;
   }
 
-  if (!uart_isTxIdle()) {
+  if (blocking) {
+    // Let a transfer started without blocking complete first
+    while (!uart_isTxIdle()) {
+      // Do nothing
+    }
+  } else if (!uart_isTxIdle()) {
     return BOOTLOADER_ERROR_UART_BUSY;
   }
 
@@ -588,32 +910,27 @@ bool uart_isTxIdle(void)
 size_t  uart_getRxAvailableBytes(void)
 {
   size_t ldmaHead;
-  size_t dst;
+  size_t available;
 
   BTL_ASSERT(initialized == true);
 
-  // Get destination address for next transfer
-  dst = LDMA->CH[SL_DRIVER_UART_LDMA_RX_CHANNEL].DST;
+  ldmaHead = uart_getLdmaHead();
 
-  if (dst == 0x0101) {
-    // SYNC descriptor with bit 0 of MATCHEN and MATCHVAL set
-    ldmaHead = 0;
-  } else if (dst == 0x0202) {
-    // SYNC descriptor with bit 1 of MATCHEN and MATCHVAL set
-    ldmaHead = SL_DRIVER_UART_RX_BUFFER_SIZE / 2;
-  } else {
-    // XFER descriptor with absolute address in buffer
-    ldmaHead = dst - (uint32_t)(rxBuffer);
-  }
-
-  // Return difference between received head and LDMA head
+  // Difference between received head and LDMA head
   if (rxHead == ldmaHead) {
-    return 0;
+    available = 0;
   } else if (rxHead < ldmaHead) {
-    return ldmaHead - rxHead;
+    available = ldmaHead - rxHead;
   } else {
-    return SL_DRIVER_UART_RX_BUFFER_SIZE - (rxHead - ldmaHead);
+    available = SL_DRIVER_UART_RX_BUFFER_SIZE - (rxHead - ldmaHead);
   }
+
+#if (SL_SERIAL_UART_FLOW_CONTROL == 1)
+  // Receive loops poll this, so it is where back-pressure is applied
+  uart_updateRts(available);
+#endif
+
+  return available;
 }
 
 /**
@@ -639,51 +956,33 @@ int32_t uart_receiveBuffer(uint8_t  * buffer,
   size_t copiedBytes = 0;
 
   BTL_ASSERT(initialized == true);
-  BTL_ASSERT(requestedLength < SL_DRIVER_UART_RX_BUFFER_SIZE);
-
-  // Check whether we have enough data
-  // Optional spin for timeout cycles
-  if (blocking) {
-    if (timeout != 0) {
-      delay_init();
-      delay_milliseconds(timeout, false);
-    }
 
-    while (uart_getRxAvailableBytes() < requestedLength) {
-      if ((timeout != 0) && delay_expired()) {
-        break;
-      }
-    }
-  }
-
-  copyBytes = uart_getRxAvailableBytes();
-  if (requestedLength < copyBytes) {
-    copyBytes = requestedLength;
+  if (blocking && (timeout != 0)) {
+    delay_init();
+    delay_milliseconds(timeout, false);
   }
 
-  // Copy up to requested bytes to given buffer
-  while (copiedBytes < copyBytes) {
-    buffer[copiedBytes] = rxBuffer[rxHead];
-    copiedBytes++;
-    rxHead++;
+  // Copy data out of the receive buffer as it becomes available, so that
+  // halves of the buffer are handed back to the LDMA while waiting. This
+  // allows reading more data than fits in half of the receive buffer.
+  while (copiedBytes < requestedLength) {
+    uint8_t *span;
+    copyBytes = uart_getRxSpan(&span);
+    if ((requestedLength - copiedBytes) < copyBytes) {
+      copyBytes = requestedLength - copiedBytes;
+    }
 
-    if (rxHead == SL_DRIVER_UART_RX_BUFFER_SIZE) {
-      rxHead = 0;
-      // Completed processing of second half of the buffer, mark it as available
-      // for LDMA again by setting SYNC[1]
-#if defined(_LDMA_SYNCSWSET_MASK)
-      LDMA->SYNCSWSET_SET = 1 << 1;
-#else
-      BUS_RegMaskedSet(&LDMA->SYNC, 1 << 1);
-#endif
-    } else if (rxHead == SL_DRIVER_UART_RX_BUFFER_SIZE / 2) {
-      // Completed processing of first half of the buffer, mark it as available
-      // for LDMA again by setting SYNC[0]
-#if defined(_LDMA_SYNCSWSET_MASK)
-      LDMA->SYNCSWSET_SET = 1 << 0;
-#else
-      BUS_RegMaskedSet(&LDMA->SYNC, 1 << 0);
-#endif
+    // Copy up to requested bytes to given buffer. Data wrapping around the
+    // end of the receive buffer is copied in the next iteration.
+    (void)memcpy(&buffer[copiedBytes], span, copyBytes);
+    copiedBytes += copyBytes;
+    uart_releaseRx(copyBytes);
+
+    if ((copyBytes == 0U)
+        && (!blocking
+            || ((timeout != 0) && delay_expired())
+            || uart_isRxIdle())) {
+      break;
     }
   }
 
@@ -698,6 +997,75 @@ int32_t uart_receiveBuffer(uint8_t  * buffer,
   }
 }
 
+/**
+ * Get the received data at the read position that is contiguous in memory.
+ *
+ * @param[out] data Start of the received data
+ *
+ * @return Number of bytes at data, until the end of the receive buffer
+ */
+size_t uart_getRxSpan(uint8_t **data)
+{
+  size_t available = uart_getRxAvailableBytes();
+
+  *data = &rxBuffer[rxHead];
+  return SL_MIN(available, SL_DRIVER_UART_RX_BUFFER_SIZE - rxHead);
+}
+
+/**
+ * Wait for a number of bytes to be received contiguously, without reading
+ * them out of the receive buffer.
+ *
+ * @param[out] data Start of the received data
+ * @param[in] length Number of bytes to wait for
+ * @param[in] timeout Number of milliseconds to wait, 0 to wait indefinitely
+ *
+ * @return BOOTLOADER_OK if successful, error code otherwise
+ */
+int32_t uart_receiveSpan(uint8_t **data, size_t length, uint32_t timeout)
+{
+  BTL_ASSERT(initialized == true);
+
+  // While the data is held, the LDMA can fill the rest of the current half
+  // of the receive buffer and the other half, but not return to this one
+  size_t capacity = ((rxHead < (SL_DRIVER_UART_RX_BUFFER_SIZE / 2))
+                     ? (SL_DRIVER_UART_RX_BUFFER_SIZE / 2)
+                     : SL_DRIVER_UART_RX_BUFFER_SIZE)
+                    - rxHead + (SL_DRIVER_UART_RX_BUFFER_SIZE / 2);
+  if ((length >= capacity)
+      || (length > (SL_DRIVER_UART_RX_BUFFER_SIZE - rxHead))) {
+    return BOOTLOADER_ERROR_UART_ARGUMENT;
+  }
+
+  if (timeout != 0) {
+    delay_init();
+    delay_milliseconds(timeout, false);
+  }
+
+  while (uart_getRxAvailableBytes() < length) {
+    if (((timeout != 0) && delay_expired()) || uart_isRxIdle()) {
+      return BOOTLOADER_ERROR_UART_TIMEOUT;
+    }
+  }
+
+  *data = &rxBuffer[rxHead];
+  return BOOTLOADER_OK;
+}
+
+/**
+ * Release received data obtained with @ref uart_getRxSpan or
+ * @ref uart_receiveSpan.
+ *
+ * @param[in] length Number of bytes to release
+ */
+void uart_releaseRx(size_t length)
+{
+  BTL_ASSERT(initialized == true);
+  BTL_ASSERT(length <= uart_getRxAvailableBytes());
+
+  uart_advanceRxHead(length);
+}
+
 /**
  * Get one byte from the UART in a blocking fashion.
  *
@@ -42,6 +42,50 @@ void uart_init(void);
  ******************************************************************************/
 void uart_deinit(void);
 
+/***************************************************************************//**
+ * Change the baud rate of the UART.
+ *
+ * Waits for pending transmissions to complete before switching, and flushes
+ * the receive buffer after switching.
+ *
+ * @param[in] baudRate The new baud rate
+ *
+ * @return BOOTLOADER_OK if successful, BOOTLOADER_ERROR_UART_ARGUMENT if the
+ *         baud rate can't be reached with the current peripheral clock
+ ******************************************************************************/
+int32_t uart_setBaudRate(uint32_t baudRate);
+
+/***************************************************************************//**
+ * Get the current baud rate of the UART.
+ *
+ * @return The baud rate set by @ref uart_init or @ref uart_setBaudRate
+ ******************************************************************************/
+uint32_t uart_getBaudRate(void);
+
+/***************************************************************************//**
+ * Make blocking receives give up once the receive line has been idle for a
+ * given time.
+ *
+ * The idle time is measured in bit times by the USART, from the end of the
+ * last received character, and is rounded up to a multiple of 250 bit times.
+ * Blocking receives then return BOOTLOADER_ERROR_UART_TIMEOUT as soon as the
+ * line goes idle before all requested data is received, rather than waiting
+ * for their timeout. Has no effect on devices without a USART timer
+ * comparator. The idle time is not adjusted by @ref uart_setBaudRate.
+ *
+ * @param[in] microseconds Idle time, 0 to disable
+ ******************************************************************************/
+void uart_setRxIdleTimeout(uint32_t microseconds);
+
+/***************************************************************************//**
+ * Ask the host to stop sending ahead of a time the receive loops can't run.
+ *
+ * With flow control, RTS is deasserted until the receive buffer is polled
+ * next, when it is asserted again if there is room. Does nothing without
+ * flow control.
+ ******************************************************************************/
+void uart_pauseRx(void);
+
 /***************************************************************************//**
  * Write a data buffer to the UART.
  *
@@ -49,9 +93,11 @@ void uart_deinit(void);
  * @param[in] length   Number of bytes in the buffer to send
  * @param[in] blocking Indicates whether this transfer can be offloaded to LDMA
  *                     and return, or whether to wait on completion before
- *                     returning.
+ *                     returning. A blocking transfer first waits for a
+ *                     pending transfer to complete.
  *
- * @return BOOTLOADER_OK if successful, error code otherwise
+ * @return BOOTLOADER_OK if successful, BOOTLOADER_ERROR_UART_BUSY if a
+ *         transfer is pending and blocking is false, error code otherwise
  ******************************************************************************/
 int32_t uart_sendBuffer(const uint8_t* buffer, size_t length, bool blocking);
 
@@ -107,6 +153,49 @@ int32_t uart_receiveBuffer(uint8_t  * buffer,
  ******************************************************************************/
 int32_t uart_receiveByte(uint8_t* byte);
 
+/***************************************************************************//**
+ * Get received data without copying it out of the receive buffer.
+ *
+ * Returns the data available at the read position up to the end of the
+ * receive buffer. Data wrapping around to the start of the buffer is returned
+ * by the next call, once the returned data has been released. The data may be
+ * modified in place. It stays valid until released with @ref uart_releaseRx
+ * or until the receive buffer is flushed.
+ *
+ * @param[out] data Start of the received data
+ *
+ * @return Number of bytes at data, 0 if no data is available
+ ******************************************************************************/
+size_t uart_getRxSpan(uint8_t **data);
+
+/***************************************************************************//**
+ * Wait for data to be received without copying it out of the receive buffer.
+ *
+ * The data is returned in one piece, as for @ref uart_getRxSpan. Data that
+ * would wrap around the end of the receive buffer, or that is too large to
+ * hold in the buffer while reception continues, is rejected and must be read
+ * with @ref uart_receiveBuffer instead.
+ *
+ * @param[out] data    Start of the received data
+ * @param[in]  length  Number of bytes to wait for
+ * @param[in]  timeout Number of milliseconds to wait, 0 to wait indefinitely
+ *
+ * @return BOOTLOADER_OK if successful, BOOTLOADER_ERROR_UART_ARGUMENT if the
+ *         data can't be held in one piece, BOOTLOADER_ERROR_UART_TIMEOUT if
+ *         the data was not received in time
+ ******************************************************************************/
+int32_t uart_receiveSpan(uint8_t **data, size_t length, uint32_t timeout);
+
+/***************************************************************************//**
+ * Release data obtained with @ref uart_getRxSpan or @ref uart_receiveSpan.
+ *
+ * Moves the read position forward and hands the parts of the receive buffer
+ * that were fully read back to the LDMA.
+ *
+ * @param[in] length Number of bytes to release
+ ******************************************************************************/
+void uart_releaseRx(size_t length);
+
 /***************************************************************************//**
  * Get one byte from UART in a blocking fashion.
  *
@@ -0,0 +1,393 @@
+/***************************************************************************//**
+ * @file
+ * @brief LZ4 decompression functionality for Gecko Bootloader
+ *******************************************************************************
+ * # License
+ * <b>Copyright 2021 Silicon Laboratories Inc. www.silabs.com</b>
+ *******************************************************************************
+ *
+ * The licensor of this software is Silicon Laboratories Inc.  Your use of this
+ * software is governed by the terms of Silicon Labs Master Software License
+ * Agreement (MSLA) available at
+ * www.silabs.com/about-us/legal/master-software-license-agreement.  This
+ * software is distributed to you in Source Code format and is governed by the
+ * sections of the MSLA applicable to Source Code.
+ *
+ ******************************************************************************/
+#include "btl_decompress_lz4.h"
+
+#include "api/btl_errorcode.h"
+#include "core/btl_util.h"
+#include "debug/btl_debug.h"
+
+#include "gbl/btl_gbl_format.h"
+
+#include <string.h>
+
+#if defined(BTL_PARSER_SUPPORT_DELTA_DFU)
+
+#define GBL_BYTES_ARRAY_TO_U32(array, offset)          \
+  ((uint32_t)((uint32_t)((array)[(offset) + 3]) << 24) \
+   | ((uint32_t)((array)[(offset) + 2]) << 16)         \
+   | ((uint32_t)((array)[(offset) + 1]) << 8)          \
+   | ((uint32_t)((array)[(offset) + 0]) << 0))
+#endif
+// --------------------------------
+// Configuration
+
+// Decompressed data is collected here and written out once the buffer is
+// full. Matches reaching back further than the buffer are read back from
+// the written data, so the buffer size only affects how often that happens.
+#define OUTPUT_BUFFER_SIZE          (256UL)
+
+// LZ4 block format, see lz4_Block_format.md
+#define LZ4_MIN_MATCH               (4UL)
+#define LZ4_LENGTH_MASK             (0x0FU)
+#define LZ4_LENGTH_SHIFT            (4U)
+// A length field of this value continues in extension bytes
+#define LZ4_LENGTH_EXTENDED         (0x0FUL)
+// An extension byte of this value is followed by another one
+#define LZ4_LENGTH_CONTINUED        (0xFFU)
+
+// --------------------------------
+// Local type declarations
+
+typedef enum {
+  LZ4_STATE_TOKEN,              ///< Expecting the token of a sequence
+  LZ4_STATE_LITERAL_LENGTH,     ///< Expecting literal length extension bytes
+  LZ4_STATE_LITERALS,           ///< Expecting literal bytes
+  LZ4_STATE_OFFSET_LOW,         ///< Expecting a match offset, or the block end
+  LZ4_STATE_OFFSET_HIGH,        ///< Expecting the second match offset byte
+  LZ4_STATE_MATCH_LENGTH,       ///< Expecting match length extension bytes
+  LZ4_STATE_MATCH_COPY,         ///< Copying a match, no input needed
+} Lz4State_t;
+
+typedef struct {
+  Lz4State_t  state;
+  size_t      literalLength;    ///< Literal bytes still to copy
+  size_t      matchLength;      ///< Match bytes still to copy
+  size_t      matchOffset;      ///< Distance of the match source
+  uint32_t    outputLength;     ///< Bytes decompressed in the current tag
+  size_t      outputBufferPos;  ///< Bytes in the output buffer
+  bool        firstCallInProgTag;
+} Lz4Decoder_t;
+
+// --------------------------------
+// Prototypes
+
+static int32_t decompressData(ParserContext_t                   *ctx,
+                              const uint8_t                     **data,
+                              size_t                            *length,
+                              const BootloaderParserCallbacks_t *callbacks);
+static void copyMatch(const ParserContext_t             *ctx,
+                      const BootloaderParserCallbacks_t *callbacks);
+static int32_t writeOutput(ParserContext_t                   *ctx,
+                           const BootloaderParserCallbacks_t *callbacks);
+
+// --------------------------------
+// Static variables
+
+static Lz4Decoder_t decoder;
+
+SL_ALIGN(4)
+static uint8_t outputBuffer[OUTPUT_BUFFER_SIZE] SL_ATTRIBUTE_ALIGN(4);
+
+// Decompressor state that persists between calls, in the order it is saved
+static const struct {
+  void    *data;
+  size_t  length;
+} stateRegions[] = {
+  { &decoder, sizeof(decoder) },
+  { outputBuffer, sizeof(outputBuffer) },
+};
+
+// --------------------------------
+// LZ4 decompression implementation
+
+// Copy as much of the current match as fits in the output buffer
+static void copyMatch(const ParserContext_t             *ctx,
+                      const BootloaderParserCallbacks_t *callbacks)
+{
+  uint8_t *dst = &outputBuffer[decoder.outputBufferPos];
+  size_t chunk = SL_MIN(decoder.matchLength,
+                        OUTPUT_BUFFER_SIZE - decoder.outputBufferPos);
+
+  if (decoder.matchOffset > decoder.outputBufferPos) {
+    // The match starts in data that was already written out. The output
+    // buffer starts at the programming address.
+    size_t distance = decoder.matchOffset - decoder.outputBufferPos;
+    chunk = SL_MIN(chunk, distance);
+    gbl_readProgData(ctx,
+                     ctx->programmingAddress - distance,
+                     dst,
+                     chunk,
+                     callbacks);
+  } else if (decoder.matchOffset >= chunk) {
+    (void)memcpy(dst, dst - decoder.matchOffset, chunk);
+  } else {
+    // The match overlaps the data it produces, repeating the last
+    // matchOffset bytes
+    const uint8_t *src = dst - decoder.matchOffset;
+    for (size_t i = 0U; i < chunk; i++) {
+      dst[i] = src[i];
+    }
+  }
+
+  decoder.outputBufferPos += chunk;
+  decoder.outputLength += chunk;
+  decoder.matchLength -= chunk;
+}
+
+// Decompress input until it is used up or the output buffer is full
+static int32_t decompressData(ParserContext_t                   *ctx,
+                              const uint8_t                     **data,
+                              size_t                            *length,
+                              const BootloaderParserCallbacks_t *callbacks)
+{
+  const uint8_t *input = *data;
+  size_t remaining = *length;
+  int32_t ret = BOOTLOADER_OK;
+
+  while ((ret == BOOTLOADER_OK)
+         && (decoder.outputBufferPos < OUTPUT_BUFFER_SIZE)
+         && ((remaining > 0U) || (decoder.state == LZ4_STATE_MATCH_COPY))) {
+    switch (decoder.state) {
+      case LZ4_STATE_TOKEN:
+        decoder.literalLength = (size_t)(*input >> LZ4_LENGTH_SHIFT);
+        decoder.matchLength = (size_t)(*input & LZ4_LENGTH_MASK);
+        input++;
+        remaining--;
+        if (decoder.literalLength == LZ4_LENGTH_EXTENDED) {
+          decoder.state = LZ4_STATE_LITERAL_LENGTH;
+        } else if (decoder.literalLength > 0U) {
+          decoder.state = LZ4_STATE_LITERALS;
+        } else {
+          decoder.state = LZ4_STATE_OFFSET_LOW;
+        }
+        break;
+
+      case LZ4_STATE_LITERAL_LENGTH:
+        decoder.literalLength += *input;
+        if (*input != LZ4_LENGTH_CONTINUED) {
+          decoder.state = LZ4_STATE_LITERALS;
+        }
+        input++;
+        remaining--;
+        break;
+
+      case LZ4_STATE_LITERALS: {
+        size_t chunk = SL_MIN(SL_MIN(remaining, decoder.literalLength),
+                              OUTPUT_BUFFER_SIZE - decoder.outputBufferPos);
+        (void)memcpy(&outputBuffer[decoder.outputBufferPos], input, chunk);
+        decoder.outputBufferPos += chunk;
+        decoder.outputLength += chunk;
+        decoder.literalLength -= chunk;
+        input += chunk;
+        remaining -= chunk;
+        if (decoder.literalLength == 0U) {
+          decoder.state = LZ4_STATE_OFFSET_LOW;
+        }
+        break;
+      }
+
+      case LZ4_STATE_OFFSET_LOW:
+        decoder.matchOffset = (size_t)*input;
+        input++;
+        remaining--;
+        decoder.state = LZ4_STATE_OFFSET_HIGH;
+        break;
+
+      case LZ4_STATE_OFFSET_HIGH:
+        decoder.matchOffset |= (size_t)*input << 8;
+        input++;
+        remaining--;
+        // Matches can only refer to data decompressed from this tag
+        if ((decoder.matchOffset == 0U)
+            || (decoder.matchOffset > decoder.outputLength)) {
+          BTL_DEBUG_PRINT("LZ4: Invalid offset 0x");
+          BTL_DEBUG_PRINT_WORD_HEX(decoder.matchOffset);
+          BTL_DEBUG_PRINT_LF();
+          ret = BOOTLOADER_ERROR_COMPRESSION_DATA;
+        } else if (decoder.matchLength == LZ4_LENGTH_EXTENDED) {
+          decoder.state = LZ4_STATE_MATCH_LENGTH;
+        } else {
+          decoder.matchLength += LZ4_MIN_MATCH;
+          decoder.state = LZ4_STATE_MATCH_COPY;
+        }
+        break;
+
+      case LZ4_STATE_MATCH_LENGTH:
+        decoder.matchLength += *input;
+        if (*input != LZ4_LENGTH_CONTINUED) {
+          decoder.matchLength += LZ4_MIN_MATCH;
+          decoder.state = LZ4_STATE_MATCH_COPY;
+        }
+        input++;
+        remaining--;
+        break;
+
+      case LZ4_STATE_MATCH_COPY:
+        copyMatch(ctx, callbacks);
+        if (decoder.matchLength == 0U) {
+          decoder.state = LZ4_STATE_TOKEN;
+        }
+        break;
+
+      default:
+        ret = BOOTLOADER_ERROR_COMPRESSION_STATE;
+        break;
+    }
+  }
+
+  *data = input;
+  *length = remaining;
+  return ret;
+}
+
+// Write out the output buffer, which starts at the programming address
+static int32_t writeOutput(ParserContext_t                   *ctx,
+                           const BootloaderParserCallbacks_t *callbacks)
+{
+  size_t length = decoder.outputBufferPos;
+  // Only the data at the end of the tag needs padding to a full word
+  size_t alignedLength = (length + 3UL) & ~3UL;
+  for (size_t i = length; i < alignedLength; i++) {
+    outputBuffer[i] = 0xFFU;
+  }
+
+#if defined(BTL_PARSER_SUPPORT_DELTA_DFU)
+  if (ctx->customTagId == GBL_TAG_ID_DELTA_LZ4) {
+    ctx->lengthOfPatch += length;
+  }
+#endif
+  decoder.outputBufferPos = 0U;
+  return gbl_writeProgData(ctx, outputBuffer, alignedLength, callbacks);
+}
+
+// -----------------------------------------------------------------------------
+// GBL tag implementation
+
+int32_t gbl_lz4EnterProgTag(ParserContext_t *ctx)
+{
+  (void) ctx;
+  BTL_DEBUG_PRINTLN("LZ4: Enter tag");
+
+  // Reset state variables
+  (void)memset(&decoder, 0, sizeof(decoder));
+  decoder.state = LZ4_STATE_TOKEN;
+  decoder.firstCallInProgTag = true;
+
+  return BOOTLOADER_OK;
+}
+
+int32_t gbl_lz4ParseProgTag(ParserContext_t *ctx,
+                            void *data,
+                            size_t length,
+                            const BootloaderParserCallbacks_t *callbacks)
+{
+  const uint8_t *input = (uint8_t *)data;
+  size_t remaining = length;
+  int32_t ret = BOOTLOADER_OK;
+
+  if (callbacks->applicationCallback == NULL) {
+    // Nothing to do
+    return BOOTLOADER_OK;
+  }
+
+  if (decoder.firstCallInProgTag) {
+    decoder.firstCallInProgTag = false;
+
+#if defined(BTL_PARSER_SUPPORT_DELTA_DFU)
+    if (ctx->customTagId == GBL_TAG_ID_DELTA_LZ4) {
+      BTL_ASSERT(length >= 12UL);
+      ctx->programmingAddress = ctx->deltaPatchAddress;
+      ctx->newFwCRC = GBL_BYTES_ARRAY_TO_U32(input, 0);
+      ctx->newFwSize = GBL_BYTES_ARRAY_TO_U32(input, 4);
+      // 4 bytes fwCRC + 4 bytes fwSize + 4 bytes address should be skipped
+      input += 12UL;
+      remaining -= 12UL;
+    } else
+#endif
+    {
+      BTL_ASSERT(length >= 4UL);
+      // First call to function contains programming address in first word
+      (void)memcpy(&ctx->programmingAddress, data, sizeof(ctx->programmingAddress));
+      input += 4UL;
+      remaining -= 4UL;
+    }
+  }
+
+  while ((ret == BOOTLOADER_OK)
+         && ((remaining > 0U) || (decoder.state == LZ4_STATE_MATCH_COPY))) {
+    uint32_t outputLength = decoder.outputLength;
+    BTL_PROFILE_BEGIN(LZ4_DECODE);
+    ret = decompressData(ctx, &input, &remaining, callbacks);
+    BTL_PROFILE_END(LZ4_DECODE, decoder.outputLength - outputLength);
+    (void)outputLength;
+
+    if ((ret == BOOTLOADER_OK)
+        && (decoder.outputBufferPos == OUTPUT_BUFFER_SIZE)) {
+      ret = writeOutput(ctx, callbacks);
+    }
+  }
+
+  return ret;
+}
+
+void *gbl_lz4GetState(size_t index, size_t *length)
+{
+  if (index >= (sizeof(stateRegions) / sizeof(stateRegions[0]))) {
+    *length = 0U;
+    return NULL;
+  }
+
+  *length = stateRegions[index].length;
+  return stateRegions[index].data;
+}
+
+size_t gbl_lz4NumBytesRequired(ParserContext_t *ctx)
+{
+  if (ctx->offsetInTag == 0) {
+#if defined(BTL_PARSER_SUPPORT_DELTA_DFU)
+    if (ctx->customTagId == GBL_TAG_ID_DELTA_LZ4) {
+      // For delta gbl we need:
+      //  - 4 bytes containing newFwCRC
+      //  - 4 bytes containing newFwSize
+      //  - a full word to set the programming address correctly
+      return 12UL;
+    }
+#endif
+    // If this is the first data in the tag, we need a full word to set the
+    // programming address correctly
+    return 4UL;
+  } else {
+    return 1UL;
+  }
+}
+
+int32_t gbl_lz4ExitProgTag(ParserContext_t *ctx,
+                           const BootloaderParserCallbacks_t *callbacks)
+{
+  int32_t ret = BOOTLOADER_OK;
+  BTL_DEBUG_PRINTLN("LZ4: Exit tag");
+
+  if (callbacks->applicationCallback == NULL) {
+    // Nothing to do
+    return BOOTLOADER_OK;
+  }
+
+  // A block ends with the literals of its last sequence
+  if (decoder.state != LZ4_STATE_OFFSET_LOW) {
+    return BOOTLOADER_ERROR_COMPRESSION_STATE;
+  }
+
+  if (decoder.outputBufferPos > 0U) {
+    // We have some remaining data
+    BTL_DEBUG_PRINT("Finish: data len = ");
+    BTL_DEBUG_PRINT_WORD_HEX(decoder.outputBufferPos);
+    BTL_DEBUG_PRINT_LF();
+    ret = writeOutput(ctx, callbacks);
+  }
+
+  return ret;
+}
@@ -0,0 +1,122 @@
+/***************************************************************************//**
+ * @file
+ * @brief LZ4 decompression functionality for Gecko Bootloader
+ *******************************************************************************
+ * # License
+ * <b>Copyright 2021 Silicon Laboratories Inc. www.silabs.com</b>
+ *******************************************************************************
+ *
+ * The licensor of this software is Silicon Laboratories Inc.  Your use of this
+ * software is governed by the terms of Silicon Labs Master Software License
+ * Agreement (MSLA) available at
+ * www.silabs.com/about-us/legal/master-software-license-agreement.  This
+ * software is distributed to you in Source Code format and is governed by the
+ * sections of the MSLA applicable to Source Code.
+ *
+ ******************************************************************************/
+#ifndef BTL_DECOMPRESS_LZ4_H
+#define BTL_DECOMPRESS_LZ4_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#include "parser/gbl/btl_gbl_parser.h"
+#include "api/btl_errorcode.h"
+
+/**
+ * @addtogroup Components
+ * @{
+ * @addtogroup Decompressor Decompressor
+ * @details
+ * @{
+ * @addtogroup Lz4Decompressor LZ4 Decompressor
+ * @brief LZ4 is a lossless data compression algorithm focused on decompression
+ * speed. It encodes a stream of literals and byte-aligned references to earlier
+ * data, without entropy coding.
+ * The decompressor reads references back from the data already written out, so
+ * it needs no dictionary in RAM.
+ * @ref CustomTags for more information.
+ * @details
+ * @{
+ */
+/** @} addtogroup Lz4Decompressor */
+/** @} addtogroup Decompressor */
+/** @} addtogroup Components */
+
+/**
+ * @addtogroup Components
+ * @{
+ * @addtogroup ImageParser
+ * @{
+ * @addtogroup GblParser
+ * @{
+ * @addtogroup CustomTags Custom GBL Tags
+ * @{
+ * @addtogroup Lz4ProgTag LZ4 Programming Tag
+ * @brief Tag to handle LZ4 compressed programming data
+ * @details The tag payload holds the programming address followed by a
+ *          single raw LZ4 block.
+ * @{
+ */
+
+/***************************************************************************//**
+ * Enter an LZ4 compressed programming tag.
+ * @param ctx Parser context
+ *
+ * @return Error code
+ ******************************************************************************/
+int32_t gbl_lz4EnterProgTag(ParserContext_t *ctx);
+
+/***************************************************************************//**
+ * Parse a chunk of data from an LZ4 compressed programming tag.
+ * @param ctx       Parser context
+ * @param data      Input data to parse
+ * @param length    Length of data
+ * @param callbacks Callbacks to call with parsed data
+ *
+ * @return Error code
+ ******************************************************************************/
+int32_t gbl_lz4ParseProgTag(ParserContext_t                   *ctx,
+                            void                              *data,
+                            size_t                            length,
+                            const BootloaderParserCallbacks_t *callbacks);
+
+/***************************************************************************//**
+ * Exit an LZ4 compressed programming tag.
+ * @param ctx       Parser context
+ * @param callbacks Callbacks to call with parsed data
+ *
+ * @return Error code
+ ******************************************************************************/
+int32_t gbl_lz4ExitProgTag(ParserContext_t                   *ctx,
+                           const BootloaderParserCallbacks_t *callbacks);
+
+/***************************************************************************//**
+ * Number of bytes needed for next stage of parsing.
+ * @param ctx Parser context
+ *
+ * @return Number of bytes required
+ ******************************************************************************/
+size_t gbl_lz4NumBytesRequired(ParserContext_t *ctx);
+
+/***************************************************************************//**
+ * Get a region of the decompressor state.
+ *
+ * Works like @ref gbl_lzmaGetState. Earlier output is read back from flash,
+ * so it isn't part of the state.
+ *
+ * @param[in]  index  Index of the region, starting at 0
+ * @param[out] length Size of the region in bytes, 0 if index is out of range
+ *
+ * @return Start of the region, or NULL if index is out of range
+ ******************************************************************************/
+void *gbl_lz4GetState(size_t index, size_t *length);
+
+/** @} addtogroup Lz4ProgTag */
+/** @} addtogroup CustomTags */
+/** @} addtogroup GblParser */
+/** @} addtogroup ImageParser */
+/** @} addtogroup Components */
+
+#endif // BTL_DECOMPRESS_LZ4_H
@@ -17,6 +17,8 @@
 #include "btl_decompress_lzma.h"
 
 #include "api/btl_errorcode.h"
+#include "core/btl_bootload.h"
+#include "core/btl_util.h"
 #include "debug/btl_debug.h"
 
 #include "gbl/btl_gbl_format.h"
@@ -56,14 +58,39 @@
 #define DECOMPRESSOR_HEAP_SIZE      ((LZMA_COUNTER_SIZE_KB) * 1024UL)
 // Max dict size to keep memory consumption reasonable
 #define DECOMPRESSOR_MAX_DICT_SIZE  ((LZMA_DICT_SIZE_KB) * 1024UL)
-// 512 B input buffer to give LZMA lib a good chunk of work at a time
+// The parser passes the tag in pieces of up to GBL_PARSER_BUFFER_SIZE bytes.
+// They are collected, so that each call of the decoder has enough input to
+// make up for its setup and for symbols split between calls. The decoder
+// consumes all input unless it runs out of output space, and then continues
+// where it stopped, so input is never moved.
 #define INPUT_BUFFER_SIZE           (512UL)
-// Output buffer >> input buffer, so that most input will be consumed every time
-#define OUTPUT_BUFFER_SIZE          (768UL)
+// Decompressed data is written straight into the flash page buffer of the
+// core where there is one, and is otherwise staged in the output buffer. It
+// is written out in whole words, up to three bytes are carried over to the
+// next call of the decoder.
+#define OUTPUT_BUFFER_SIZE          (1024UL)
+
+#if defined(LZMA_DECODE_LC3_LP0) && (LZMA_DECODE_LC3_LP0 == 1)
+#if (LZMA_COUNTER_SIZE_KB < 16UL)
+#error "LZMA_COUNTER_SIZE_KB is too small for lc = 3"
+#endif
+#endif
+
+#if defined(LZMA_DICT_READ_BACK) && (LZMA_DICT_READ_BACK == 1)
+// Matches are up to 273 bytes long. Decompressed data can only be read back
+// once it is written out, which happens after every call of the decoder, so
+// each call decodes at most OUTPUT_BUFFER_SIZE bytes.
+#if (DECOMPRESSOR_MAX_DICT_SIZE < (OUTPUT_BUFFER_SIZE + 276UL))
+#error "LZMA_DICT_SIZE_KB is too small to hold the output buffer"
+#endif
+#endif
 
 // --------------------------------
 // Prototypes
 
+static uint8_t *getOutputSpace(const ParserContext_t               *ctx,
+                               const BootloaderParserCallbacks_t *callbacks,
+                               size_t                            *length);
 static int32_t decompressAndFlash(ParserContext_t                   *ctx,
                                   const BootloaderParserCallbacks_t *callbacks,
                                   bool                              finish);
@@ -74,6 +101,9 @@ static int32_t decompressData(uint8_t          *dstBuffer,
                               ELzmaStatus      *status);
 static void *lzmaAlloc(ISzAllocPtr p, size_t size);
 static void lzmaFree(ISzAllocPtr p, void *address);
+#if defined(LZMA_DICT_READ_BACK) && (LZMA_DICT_READ_BACK == 1)
+static void lzmaReadBack(IDicReaderPtr p, UInt32 pos, Byte *dest, SizeT size);
+#endif
 
 // --------------------------------
 // Static variables
@@ -85,14 +115,14 @@ static uint8_t heapArray[DECOMPRESSOR_HEAP_SIZE] SL_ATTRIBUTE_ALIGN(4);
 SL_ALIGN(4)
 static uint8_t dict[DECOMPRESSOR_MAX_DICT_SIZE] SL_ATTRIBUTE_ALIGN(4);
 
-// Output buffer needs to be bigger than input buffer
-SL_ALIGN(4)
-static uint8_t inputBuffer[INPUT_BUFFER_SIZE] SL_ATTRIBUTE_ALIGN(4);
+static uint8_t inputBuffer[INPUT_BUFFER_SIZE];
 static size_t inputBufferPos;
 
 SL_ALIGN(4)
 static uint8_t outputBuffer[OUTPUT_BUFFER_SIZE] SL_ATTRIBUTE_ALIGN(4);
-static size_t outputBufferPos;
+// Decompressed bytes that don't make up a whole word yet
+static uint8_t outputTail[4];
+static size_t outputTailLength;
 
 static CLzmaDec decompressorState;
 static bool firstCallInProgTag;
@@ -100,6 +130,34 @@ static bool firstCallInProgTag;
 static ISzAlloc lzmaAllocator = { &lzmaAlloc, &lzmaFree };
 static int allocSeq = 0;
 
+#if defined(LZMA_DICT_READ_BACK) && (LZMA_DICT_READ_BACK == 1)
+static const IDicReader dictReader = { &lzmaReadBack };
+// Address the decompressed data of the tag starts at
+static uint32_t outputStartAddress;
+// Where the decompressed data was written to, valid while decompressing
+static const ParserContext_t *readBackCtx;
+static const BootloaderParserCallbacks_t *readBackCallbacks;
+#endif
+
+// Decompressor state that persists between calls, in the order it is saved
+static const struct {
+  void    *data;
+  size_t  length;
+} stateRegions[] = {
+  { &decompressorState, sizeof(decompressorState) },
+  { heapArray, sizeof(heapArray) },
+  { dict, sizeof(dict) },
+  { inputBuffer, sizeof(inputBuffer) },
+  { &inputBufferPos, sizeof(inputBufferPos) },
+  { outputTail, sizeof(outputTail) },
+  { &outputTailLength, sizeof(outputTailLength) },
+  { &firstCallInProgTag, sizeof(firstCallInProgTag) },
+  { &allocSeq, sizeof(allocSeq) },
+#if defined(LZMA_DICT_READ_BACK) && (LZMA_DICT_READ_BACK == 1)
+  { &outputStartAddress, sizeof(outputStartAddress) },
+#endif
+};
+
 // --------------------------------
 // LZMA Allocators
 
@@ -145,6 +203,21 @@ static void lzmaFree(ISzAllocPtr p, void *address)
   }
 }
 
+#if defined(LZMA_DICT_READ_BACK) && (LZMA_DICT_READ_BACK == 1)
+// --------------------------------
+// LZMA dictionary read back
+
+static void lzmaReadBack(IDicReaderPtr p, UInt32 pos, Byte *dest, SizeT size)
+{
+  (void)p;
+  gbl_readProgData(readBackCtx,
+                   outputStartAddress + pos,
+                   dest,
+                   size,
+                   readBackCallbacks);
+}
+#endif
+
 // --------------------------------
 // LZMA decompression implementation
 
@@ -158,6 +231,7 @@ static int32_t decompressData(uint8_t          *dstBuffer,
 
   // We might not have large enough output buffer and need "more decompression rounds",
   // Use "LZMA_FINISH_ANY" mode and get so much of data asked for.
+  BTL_PROFILE_BEGIN(LZMA_DECODE);
   res = LzmaDec_DecodeToBuf(&decompressorState,
                             dstBuffer,
                             dstBufferLen,
@@ -165,6 +239,7 @@ static int32_t decompressData(uint8_t          *dstBuffer,
                             srcBufferLen,
                             LZMA_FINISH_ANY,
                             status);
+  BTL_PROFILE_END(LZMA_DECODE, *dstBufferLen);
 
   BTL_DEBUG_PRINT("Decompressed ");
   BTL_DEBUG_PRINT_WORD_HEX(*srcBufferLen);
@@ -205,77 +280,95 @@ static int32_t decompressData(uint8_t          *dstBuffer,
   return BOOTLOADER_OK;
 }
 
+// Space to decompress into: the page buffer of the core at the programming
+// address, or the output buffer
+static uint8_t *getOutputSpace(const ParserContext_t               *ctx,
+                               const BootloaderParserCallbacks_t *callbacks,
+                               size_t                            *length)
+{
+  uint8_t *space = NULL;
+
+  // Delta patches are not written to the application, and only the
+  // application callback of the core takes data from its page buffer
+  if ((ctx->customTagId != GBL_TAG_ID_DELTA_LZMA)
+      && (callbacks->applicationCallback == bootload_applicationCallback)) {
+    space = bootload_getApplicationBuffer(ctx->programmingAddress, length);
+  }
+  if ((space == NULL) || (*length <= outputTailLength)) {
+    space = outputBuffer;
+    *length = OUTPUT_BUFFER_SIZE;
+  }
+#if defined(LZMA_DICT_READ_BACK) && (LZMA_DICT_READ_BACK == 1)
+  *length = SL_MIN(*length, OUTPUT_BUFFER_SIZE);
+#endif
+  return space;
+}
+
 static int32_t decompressAndFlash(ParserContext_t                   *ctx,
                                   const BootloaderParserCallbacks_t *callbacks,
                                   bool                              finish)
 {
   int32_t ret = BOOTLOADER_OK;
   ELzmaStatus status = LZMA_STATUS_NOT_FINISHED;
+  const uint8_t *input = inputBuffer;
+  size_t inputLength = inputBufferPos;
+#if defined(LZMA_DICT_READ_BACK) && (LZMA_DICT_READ_BACK == 1)
+  readBackCtx = ctx;
+  readBackCallbacks = callbacks;
+#endif
   while (status == LZMA_STATUS_NOT_FINISHED) {
-    // outputPos starts out as the size of the output buffer less any leftover
-    // data already in the buffer, or the remaining expected input size,
-    // whichever is smaller
-    unsigned int outputPos = OUTPUT_BUFFER_SIZE - outputBufferPos;
+    size_t spaceLength;
+    uint8_t *output = getOutputSpace(ctx, callbacks, &spaceLength);
+    // outputLength starts out as the space left after the carried over bytes
+    size_t outputLength = spaceLength - outputTailLength;
     // inputPos starts out as the size of the available input data
-    unsigned int inputPos = inputBufferPos;
+    size_t inputPos = inputLength;
 
     BTL_DEBUG_PRINT("Decompress ");
     BTL_DEBUG_PRINT_WORD_HEX(inputPos);
-    BTL_DEBUG_PRINT(" bytes to output buffer offset ");
-    BTL_DEBUG_PRINT_WORD_HEX(outputBufferPos);
+    BTL_DEBUG_PRINT(" bytes to ");
+    BTL_DEBUG_PRINT_WORD_HEX(outputLength);
+    BTL_DEBUG_PRINT(" bytes of space");
     BTL_DEBUG_PRINT_LF();
 
-    // Decompress data. The output buffer starts after any unaligned data left
-    // from a previous iteration.
-    ret = decompressData(&outputBuffer[outputBufferPos],
-                         &outputPos,
-                         inputBuffer,
+    // Decompress data after the bytes carried over. The decoder consumes all
+    // input unless the space fills up, holding on to any incomplete symbol
+    // at the end.
+    (void)memcpy(output, outputTail, outputTailLength);
+    ret = decompressData(&output[outputTailLength],
+                         &outputLength,
+                         input,
                          &inputPos,
                          &status);
     if (ret != BOOTLOADER_OK) {
       return ret;
     }
-    // outputPos is now the actual size of the decompressed data
-    // inputPos is now the position in the input buffer after processing
-
-    // Flash word-aligned decompressed data, consisting of any leftover data
-    // from a previous iteration + newly decompressed data
-    size_t availableData = outputBufferPos + outputPos;
-    size_t alignedAvailableData = availableData & ~3UL;
+    // outputLength is now the actual size of the decompressed data
+    // inputPos is now the number of input bytes consumed
+    input += inputPos;
+    inputLength -= inputPos;
+
+    // Flash whole words, and carry the rest over. gbl_writeProgData may
+    // start a background write from the page buffer, so the rest is taken
+    // out first.
+    size_t decompressed = outputTailLength + outputLength;
+    size_t alignedLength = decompressed & ~3UL;
+    outputTailLength = decompressed - alignedLength;
+    (void)memcpy(outputTail, &output[alignedLength], outputTailLength);
+    if (alignedLength > 0U) {
 #if defined(BTL_PARSER_SUPPORT_DELTA_DFU)
-    if (ctx->customTagId == GBL_TAG_ID_DELTA_LZMA) {
-      ctx->lengthOfPatch += alignedAvailableData;
-      ret = gbl_writeProgData(ctx, outputBuffer, alignedAvailableData, callbacks);
-    } else {
+      if (ctx->customTagId == GBL_TAG_ID_DELTA_LZMA) {
+        ctx->lengthOfPatch += alignedLength;
+      }
 #endif
-    ret = gbl_writeProgData(ctx, outputBuffer, alignedAvailableData, callbacks);
-#if defined(BTL_PARSER_SUPPORT_DELTA_DFU)
-  }
-#endif
-    // Store any unaligned bytes at the beginning of the output buffer
-    if ((availableData - alignedAvailableData) > 0) {
-      BTL_DEBUG_PRINT("  Output data remaining: 0x");
-      BTL_DEBUG_PRINT_WORD_HEX(availableData - alignedAvailableData);
-      BTL_DEBUG_PRINT_LF();
-
-      memmove(&outputBuffer[0],
-              &outputBuffer[alignedAvailableData],
-              availableData - alignedAvailableData);
+      ret = gbl_writeProgData(ctx, output, alignedLength, callbacks);
+      if (ret != BOOTLOADER_OK) {
+        return ret;
+      }
     }
-    outputBufferPos = availableData - alignedAvailableData;
-
-    // Move remaining input to the beginning of the input buffer
-    if (inputBufferPos > inputPos) {
-      BTL_DEBUG_PRINT("  Input data remaining: 0x");
-      BTL_DEBUG_PRINT_WORD_HEX(inputBufferPos - inputPos);
-      BTL_DEBUG_PRINT_LF();
-
-      memmove(&inputBuffer[0],
-              &inputBuffer[inputPos],
-              inputBufferPos - inputPos);
-    }
-    inputBufferPos -= inputPos;
   }
+  // All input is consumed once the decoder needs more, or has finished
+  inputBufferPos = 0U;
 
   // Verify that decompression finished if this was expected to be the last data
   if (finish
@@ -298,8 +391,8 @@ int32_t gbl_lzmaEnterProgTag(ParserContext_t *ctx)
   memset(&decompressorState, 0, sizeof(CLzmaDec));
   LzmaDec_Construct(&decompressorState);
   firstCallInProgTag = true;
-  outputBufferPos = 0;
   inputBufferPos = 0;
+  outputTailLength = 0;
 
   return BOOTLOADER_OK;
 }
@@ -311,7 +404,6 @@ int32_t gbl_lzmaParseProgTag(ParserContext_t *ctx,
 {
   const uint8_t *dataArray = (uint8_t *)data;
   size_t dataOffset = 0UL;
-  int32_t ret;
 
   if (callbacks->applicationCallback == NULL) {
     // Nothing to do
@@ -332,7 +424,7 @@ int32_t gbl_lzmaParseProgTag(ParserContext_t *ctx,
       ctx->programmingAddress = ctx->deltaPatchAddress;
     } else {
 #endif
-    ctx->programmingAddress = *(uint32_t *)data;
+    (void)memcpy(&ctx->programmingAddress, data, sizeof(ctx->programmingAddress));
 #if defined(BTL_PARSER_SUPPORT_DELTA_DFU)
   }
 #endif
@@ -346,10 +438,33 @@ int32_t gbl_lzmaParseProgTag(ParserContext_t *ctx,
       dataArrayOffset = 12;
     }
 #endif
+#if defined(LZMA_DICT_READ_BACK) && (LZMA_DICT_READ_BACK == 1)
+    outputStartAddress = ctx->programmingAddress;
+    SRes res;
+#if defined(BOOTLOADER_DELTA_OTW) && (BOOTLOADER_DELTA_OTW == 1)
+    // A patch applied without storage can't be read back, so its dictionary
+    // must fit in RAM
+    if (ctx->customTagId == GBL_TAG_ID_DELTA_LZMA) {
+      res = LzmaDec_Allocate(&decompressorState,
+                             &dataArray[dataArrayOffset],
+                             LZMA_PROPS_SIZE,
+                             &lzmaAllocator);
+    } else
+#endif
+    {
+      res = LzmaDec_AllocateWindow(&decompressorState,
+                                   &dataArray[dataArrayOffset],
+                                   LZMA_PROPS_SIZE,
+                                   DECOMPRESSOR_MAX_DICT_SIZE,
+                                   &dictReader,
+                                   &lzmaAllocator);
+    }
+#else
     SRes res = LzmaDec_Allocate(&decompressorState,
                                 &dataArray[dataArrayOffset],
                                 LZMA_PROPS_SIZE,
                                 &lzmaAllocator);
+#endif
     if (res != SZ_OK) {
       return BOOTLOADER_ERROR_COMPRESSION_MEM;
     }
@@ -364,33 +479,36 @@ int32_t gbl_lzmaParseProgTag(ParserContext_t *ctx,
     }
   }
 
-  size_t remainingInputBytes = length - dataOffset;
-
-  // Accumulate input data until the input buffer is nearly full
-  if (remainingInputBytes > (INPUT_BUFFER_SIZE - inputBufferPos)) {
-    // Input buffer full, decompress the data
-    ret = decompressAndFlash(ctx, callbacks, false);
-    if (ret != BOOTLOADER_OK) {
-      return ret;
-    }
-
-    // If we can't fit new data after flushing what we have, we can't do
-    // much -- need to increase output buffer size compared to input buffer
-    // size, or try decompressing again until status != NOT_FINISHED
-    if (remainingInputBytes > (INPUT_BUFFER_SIZE - inputBufferPos)) {
-      return BOOTLOADER_ERROR_COMPRESSION_DATALEN;
+  // Collect the input, and decompress it once the input buffer is full
+  while (dataOffset < length) {
+    size_t chunk = SL_MIN(length - dataOffset,
+                          INPUT_BUFFER_SIZE - inputBufferPos);
+    (void)memcpy(&inputBuffer[inputBufferPos], &dataArray[dataOffset], chunk);
+    inputBufferPos += chunk;
+    dataOffset += chunk;
+
+    if (inputBufferPos == INPUT_BUFFER_SIZE) {
+      int32_t ret = decompressAndFlash(ctx, callbacks, false);
+      if (ret != BOOTLOADER_OK) {
+        return ret;
+      }
     }
   }
 
-  // Put new input data into input buffer
-  memcpy(&inputBuffer[inputBufferPos],
-         &dataArray[dataOffset],
-         remainingInputBytes);
-  inputBufferPos += remainingInputBytes;
-
   return BOOTLOADER_OK;
 }
 
+void *gbl_lzmaGetState(size_t index, size_t *length)
+{
+  if (index >= (sizeof(stateRegions) / sizeof(stateRegions[0]))) {
+    *length = 0U;
+    return NULL;
+  }
+
+  *length = stateRegions[index].length;
+  return stateRegions[index].data;
+}
+
 size_t gbl_lzmaNumBytesRequired(ParserContext_t *ctx)
 {
   if (ctx->offsetInTag == 0) {
@@ -427,32 +545,33 @@ int32_t gbl_lzmaExitProgTag(ParserContext_t *ctx,
     return BOOTLOADER_OK;
   }
 
-  // Finish decompressing remaining data
+  // Finish decompressing the collected input and data still held by the
+  // decoder
   ret = decompressAndFlash(ctx, callbacks, true);
   if (ret != BOOTLOADER_OK) {
     return ret;
   }
 
-  if (outputBufferPos > 0) {
+  if (outputTailLength > 0U) {
     // We have some remaining unaligned data
-    for (size_t i = outputBufferPos; i < 4UL; i++) {
+    size_t remaining = outputTailLength;
+    (void)memcpy(outputBuffer, outputTail, remaining);
+    for (size_t i = remaining; i < 4UL; i++) {
       outputBuffer[i] = 0xFFU;
     }
     BTL_DEBUG_PRINT("Finish: data len = ");
-    BTL_DEBUG_PRINT_WORD_HEX(outputBufferPos);
+    BTL_DEBUG_PRINT_WORD_HEX(remaining);
     BTL_DEBUG_PRINT(" aligned len = ");
     BTL_DEBUG_PRINT_WORD_HEX(4UL);
     BTL_DEBUG_PRINT_LF();
 #if defined(BTL_PARSER_SUPPORT_DELTA_DFU)
     if (ctx->customTagId == GBL_TAG_ID_DELTA_LZMA) {
-      ctx->lengthOfPatch += outputBufferPos;
-      ret = gbl_writeProgData(ctx, outputBuffer, 4UL, callbacks);
-    } else {
+      ctx->lengthOfPatch += remaining;
+    }
+#else
+    (void)remaining;
 #endif
     ret = gbl_writeProgData(ctx, outputBuffer, 4UL, callbacks);
-#if defined(BTL_PARSER_SUPPORT_DELTA_DFU)
-  }
-#endif
     if (ret != BOOTLOADER_OK) {
       return ret;
     }
@@ -76,6 +76,33 @@
 #define LZMA_DICT_SIZE_KB           (8UL)
 #endif
 
+#ifndef LZMA_DICT_READ_BACK
+/// @brief Read the dictionary back from the written image.
+/// When enabled, LZMA payloads with a dictionary of any size can be
+/// decompressed. @ref LZMA_DICT_SIZE_KB then only sets the size of the most
+/// recent part of the dictionary kept in RAM. Matches reaching back further
+/// are read from the image data written earlier in the tag, in flash.
+/// Simplicity Commander does not set the LZMA dictionary size; build images
+/// with a larger dictionary with tools/mkgbl.py --lzma-dict.
+#define LZMA_DICT_READ_BACK         (0)
+#endif
+
+#ifndef LZMA_DECODE_SPEED_OPT
+/// @brief Build the LZMA decoder for speed rather than size.
+/// When enabled, the remaining bit-tree loops of the decoder are unrolled and
+/// the literal context is computed with a single mask. This increases the
+/// code size of the decoder.
+#define LZMA_DECODE_SPEED_OPT       (0)
+#endif
+
+#ifndef LZMA_DECODE_LC3_LP0
+/// @brief Only decode LZMA payloads compressed with lc = 3 and lp = 0.
+/// When enabled, the literal context of the decoder is fixed to the default
+/// LZMA properties. LZMA payloads with other LC and LP constants are rejected.
+/// Requires @ref LZMA_COUNTER_SIZE_KB of at least 16.
+#define LZMA_DECODE_LC3_LP0         (0)
+#endif
+
 /***************************************************************************//**
  * Enter an LZMA compressed programming tag.
  * @param ctx Parser context
@@ -116,6 +143,20 @@ int32_t gbl_lzmaExitProgTag(ParserContext_t                   *ctx,
  ******************************************************************************/
 size_t gbl_lzmaNumBytesRequired(ParserContext_t *ctx);
 
+/***************************************************************************//**
+ * Get a region of the decompressor state.
+ *
+ * The decompressor keeps its state in static memory between calls. Saving all
+ * regions and copying them back later resumes decompression where it left
+ * off, as long as the parser context is restored along with it.
+ *
+ * @param[in]  index  Index of the region, starting at 0
+ * @param[out] length Size of the region in bytes, 0 if index is out of range
+ *
+ * @return Start of the region, or NULL if index is out of range
+ ******************************************************************************/
+void *gbl_lzmaGetState(size_t index, size_t *length);
+
 /** @} addtogroup LzmaProgTag */
 /** @} addtogroup CustomTags */
 /** @} addtogroup GblParser */
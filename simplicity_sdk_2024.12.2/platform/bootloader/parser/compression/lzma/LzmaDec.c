@@ -44,6 +44,11 @@
 
 /* #define _LZMA_SIZE_OPT */
 
+/* _LZMA_SPEED_OPT unrolls the remaining bit-tree loops and computes the
+   literal context with a single mask.
+   _LZMA_LIT_LC3_LP0 fixes the literal context to lc = 3, lp = 0, and
+   rejects streams with other properties. */
+
 #ifdef _LZMA_SIZE_OPT
 #define TREE_6_DECODE(probs, i) TREE_DECODE(probs, (1 << 6), i)
 #else
@@ -136,6 +141,9 @@ StopCompilingDueBUG
 
 #define LZMA_DIC_MIN (1 << 12)
 
+/* Distances beyond the dictionary buffer only occur with LzmaDec_AllocateWindow */
+#define DIC_READ_BACK(p, pos, dest, size) (p)->dicReader->Read((p)->dicReader, (pos), (dest), (size))
+
 /* First LZMA-symbol is always decoded.
 And it decodes new LZMA-symbols while (buf < bufLimit), but "buf" is without last normalization
 Out:
@@ -156,8 +164,14 @@ static int MY_FAST_CALL LzmaDec_DecodeReal(CLzmaDec *p, SizeT limit, const Byte
   unsigned state = p->state;
   UInt32 rep0 = p->reps[0], rep1 = p->reps[1], rep2 = p->reps[2], rep3 = p->reps[3];
   unsigned pbMask = ((unsigned)1 << (p->prop.pb)) - 1;
+  #if defined(_LZMA_LIT_LC3_LP0)
+  #elif defined(_LZMA_SPEED_OPT)
+  unsigned lc = p->prop.lc;
+  unsigned lpMask = ((unsigned)0x100 << p->prop.lp) - ((unsigned)0x100 >> lc);
+  #else
   unsigned lpMask = ((unsigned)1 << (p->prop.lp)) - 1;
   unsigned lc = p->prop.lc;
+  #endif
 
   Byte *dic = p->dic;
   SizeT dicBufSize = p->dicBufSize;
@@ -185,8 +199,17 @@ static int MY_FAST_CALL LzmaDec_DecodeReal(CLzmaDec *p, SizeT limit, const Byte
       UPDATE_0(prob);
       prob = probs + Literal;
       if (processedPos != 0 || checkDicSize != 0)
+      {
+        #if defined(_LZMA_LIT_LC3_LP0)
+        prob += (UInt32)LZMA_LIT_SIZE * (dic[(dicPos == 0 ? dicBufSize : dicPos) - 1] >> 5);
+        #elif defined(_LZMA_SPEED_OPT)
+        prob += (UInt32)3 * ((((processedPos << 8) +
+            dic[(dicPos == 0 ? dicBufSize : dicPos) - 1]) & lpMask) << lc);
+        #else
         prob += ((UInt32)LZMA_LIT_SIZE * (((processedPos & lpMask) << lc) +
             (dic[(dicPos == 0 ? dicBufSize : dicPos) - 1] >> (8 - lc))));
+        #endif
+      }
       processedPos++;
 
       if (state < kNumLitStates)
@@ -208,8 +231,16 @@ static int MY_FAST_CALL LzmaDec_DecodeReal(CLzmaDec *p, SizeT limit, const Byte
       }
       else
       {
-        unsigned matchByte = dic[dicPos - rep0 + (dicPos < rep0 ? dicBufSize : 0)];
+        unsigned matchByte;
         unsigned offs = 0x100;
+        if (rep0 > dicBufSize)
+        {
+          Byte b;
+          DIC_READ_BACK(p, processedPos - 1 - rep0, &b, 1);
+          matchByte = b;
+        }
+        else
+          matchByte = dic[dicPos - rep0 + (dicPos < rep0 ? dicBufSize : 0)];
         state -= (state < 10) ? 3 : 6;
         symbol = 1;
         #ifdef _LZMA_SIZE_OPT
@@ -262,7 +293,10 @@ static int MY_FAST_CALL LzmaDec_DecodeReal(CLzmaDec *p, SizeT limit, const Byte
           IF_BIT_0(prob)
           {
             UPDATE_0(prob);
-            dic[dicPos] = dic[dicPos - rep0 + (dicPos < rep0 ? dicBufSize : 0)];
+            if (rep0 > dicBufSize)
+              DIC_READ_BACK(p, processedPos - rep0, dic + dicPos, 1);
+            else
+              dic[dicPos] = dic[dicPos - rep0 + (dicPos < rep0 ? dicBufSize : 0)];
             dicPos++;
             processedPos++;
             state = state < kNumLitStates ? 9 : 11;
@@ -367,8 +401,21 @@ static int MY_FAST_CALL LzmaDec_DecodeReal(CLzmaDec *p, SizeT limit, const Byte
           {
             UPDATE_1(probLen);
             probLen = prob + LenHigh;
+            #ifdef _LZMA_SPEED_OPT
+            len = 1;
+            TREE_GET_BIT(probLen, len);
+            TREE_GET_BIT(probLen, len);
+            TREE_GET_BIT(probLen, len);
+            TREE_GET_BIT(probLen, len);
+            TREE_GET_BIT(probLen, len);
+            TREE_GET_BIT(probLen, len);
+            TREE_GET_BIT(probLen, len);
+            TREE_GET_BIT(probLen, len);
+            len -= (1 << kLenNumHighBits) - kLenNumLowSymbols - kLenNumMidSymbols;
+            #else
             TREE_DECODE(probLen, (1 << kLenNumHighBits), len);
             len += kLenNumLowSymbols + kLenNumMidSymbols;
+            #endif
           }
         }
       }
@@ -477,6 +524,16 @@ static int MY_FAST_CALL LzmaDec_DecodeReal(CLzmaDec *p, SizeT limit, const Byte
         }
         
         curLen = ((rem < len) ? (unsigned)rem : len);
+
+        if (rep0 > dicBufSize)
+        {
+          DIC_READ_BACK(p, processedPos - rep0, dic + dicPos, curLen);
+          processedPos += curLen;
+          len -= curLen;
+          dicPos += curLen;
+          continue;
+        }
+
         pos = dicPos - rep0 + (dicPos < rep0 ? dicBufSize : 0);
 
         processedPos += curLen;
@@ -542,6 +599,12 @@ static void MY_FAST_CALL LzmaDec_WriteRem(CLzmaDec *p, SizeT limit)
 
     p->processedPos += len;
     p->remainLen -= len;
+    if (rep0 > dicBufSize)
+    {
+      DIC_READ_BACK(p, p->processedPos - len - (UInt32)rep0, dic + dicPos, len);
+      dicPos += len;
+      len = 0;
+    }
     while (len != 0)
     {
       len--;
@@ -622,10 +685,18 @@ static ELzmaDummy LzmaDec_TryDummy(const CLzmaDec *p, const Byte *buf, SizeT inS
       }
       else
       {
-        unsigned matchByte = p->dic[p->dicPos - p->reps[0] +
-            (p->dicPos < p->reps[0] ? p->dicBufSize : 0)];
+        unsigned matchByte;
         unsigned offs = 0x100;
         unsigned symbol = 1;
+        if (p->reps[0] > p->dicBufSize)
+        {
+          Byte b;
+          DIC_READ_BACK(p, p->processedPos - p->reps[0], &b, 1);
+          matchByte = b;
+        }
+        else
+          matchByte = p->dic[p->dicPos - p->reps[0] +
+              (p->dicPos < p->reps[0] ? p->dicBufSize : 0)];
         do
         {
           unsigned bit;
@@ -1034,6 +1105,10 @@ SRes LzmaProps_Decode(CLzmaProps *p, const Byte *data, unsigned size)
 static SRes LzmaDec_AllocateProbs2(CLzmaDec *p, const CLzmaProps *propNew, ISzAllocPtr alloc)
 {
   UInt32 numProbs = LzmaProps_GetNumProbs(propNew);
+  #ifdef _LZMA_LIT_LC3_LP0
+  if (propNew->lc != 3 || propNew->lp != 0)
+    return SZ_ERROR_UNSUPPORTED;
+  #endif
   if (!p->probs || numProbs != p->numProbs)
   {
     LzmaDec_FreeProbs(p, alloc);
@@ -1054,15 +1129,14 @@ SRes LzmaDec_AllocateProbs(CLzmaDec *p, const Byte *props, unsigned propsSize, I
   return SZ_OK;
 }
 
-SRes LzmaDec_Allocate(CLzmaDec *p, const Byte *props, unsigned propsSize, ISzAllocPtr alloc)
+static SRes LzmaDec_Allocate2(CLzmaDec *p, const CLzmaProps *propNew, SizeT windowSize,
+    IDicReaderPtr dicReader, ISzAllocPtr alloc)
 {
-  CLzmaProps propNew;
   SizeT dicBufSize;
-  RINOK(LzmaProps_Decode(&propNew, props, propsSize));
-  RINOK(LzmaDec_AllocateProbs2(p, &propNew, alloc));
+  RINOK(LzmaDec_AllocateProbs2(p, propNew, alloc));
 
   {
-    UInt32 dictSize = propNew.dicSize;
+    UInt32 dictSize = propNew->dicSize;
     SizeT mask = ((UInt32)1 << 12) - 1;
          if (dictSize >= ((UInt32)1 << 30)) mask = ((UInt32)1 << 22) - 1;
     else if (dictSize >= ((UInt32)1 << 22)) mask = ((UInt32)1 << 20) - 1;;
@@ -1071,6 +1145,13 @@ SRes LzmaDec_Allocate(CLzmaDec *p, const Byte *props, unsigned propsSize, ISzAll
       dicBufSize = dictSize;
   }
 
+  p->dicReader = 0;
+  if (dicReader && dicBufSize > windowSize)
+  {
+    dicBufSize = windowSize;
+    p->dicReader = dicReader;
+  }
+
   if (!p->dic || dicBufSize != p->dicBufSize)
   {
     LzmaDec_FreeDict(p, alloc);
@@ -1082,10 +1163,27 @@ SRes LzmaDec_Allocate(CLzmaDec *p, const Byte *props, unsigned propsSize, ISzAll
     }
   }
   p->dicBufSize = dicBufSize;
-  p->prop = propNew;
+  p->prop = *propNew;
   return SZ_OK;
 }
 
+SRes LzmaDec_Allocate(CLzmaDec *p, const Byte *props, unsigned propsSize, ISzAllocPtr alloc)
+{
+  CLzmaProps propNew;
+  RINOK(LzmaProps_Decode(&propNew, props, propsSize));
+  return LzmaDec_Allocate2(p, &propNew, 0, 0, alloc);
+}
+
+SRes LzmaDec_AllocateWindow(CLzmaDec *p, const Byte *props, unsigned propsSize,
+    SizeT windowSize, IDicReaderPtr dicReader, ISzAllocPtr alloc)
+{
+  CLzmaProps propNew;
+  if (windowSize <= kMatchSpecLenStart + kMatchMinLen)
+    return SZ_ERROR_PARAM;
+  RINOK(LzmaProps_Decode(&propNew, props, propsSize));
+  return LzmaDec_Allocate2(p, &propNew, windowSize, dicReader, alloc);
+}
+
 SRes LzmaDecode(Byte *dest, SizeT *destLen, const Byte *src, SizeT *srcLen,
     const Byte *propData, unsigned propSize, ELzmaFinishMode finishMode,
     ELzmaStatus *status, ISzAllocPtr alloc)
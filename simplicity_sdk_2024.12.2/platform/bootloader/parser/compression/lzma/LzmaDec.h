@@ -57,6 +57,17 @@ SRes LzmaProps_Decode(CLzmaProps *p, const Byte *data, unsigned size);
 
 #define LZMA_REQUIRED_INPUT_MAX 20
 
+/* IDicReader reads back data decoded earlier, from the offset pos in the
+   decoded stream. See LzmaDec_AllocateWindow. */
+
+typedef struct IDicReader IDicReader;
+typedef const IDicReader * IDicReaderPtr;
+
+struct IDicReader
+{
+  void (*Read)(IDicReaderPtr p, UInt32 pos, Byte *dest, SizeT size);
+};
+
 typedef struct
 {
   CLzmaProps prop;
@@ -76,9 +87,10 @@ typedef struct
   UInt32 numProbs;
   unsigned tempBufSize;
   Byte tempBuf[LZMA_REQUIRED_INPUT_MAX];
+  IDicReaderPtr dicReader;
 } CLzmaDec;
 
-#define LzmaDec_Construct(p) { (p)->dic = 0; (p)->probs = 0; }
+#define LzmaDec_Construct(p) { (p)->dic = 0; (p)->probs = 0; (p)->dicReader = 0; }
 
 void LzmaDec_Init(CLzmaDec *p);
 
@@ -147,6 +159,19 @@ void LzmaDec_FreeProbs(CLzmaDec *p, ISzAllocPtr alloc);
 SRes LzmaDec_Allocate(CLzmaDec *state, const Byte *prop, unsigned propsSize, ISzAllocPtr alloc);
 void LzmaDec_Free(CLzmaDec *state, ISzAllocPtr alloc);
 
+/* LzmaDec_AllocateWindow
+
+   Like LzmaDec_Allocate, but the dictionary buffer holds at most windowSize
+   bytes, whatever the dictionary size of the stream. Matches reaching back
+   further are read through dicReader, so data decoded since LzmaDec_Init
+   must stay readable. Reads only cover data decoded at least
+   (windowSize - 273) bytes before the current position, so the caller can
+   hold back that much output before making it readable.
+*/
+
+SRes LzmaDec_AllocateWindow(CLzmaDec *p, const Byte *props, unsigned propsSize,
+    SizeT windowSize, IDicReaderPtr dicReader, ISzAllocPtr alloc);
+
 /* ---------- Dictionary Interface ---------- */
 
 /* You can use it, if you want to eliminate the overhead for data copying from
@@ -19,4 +19,12 @@
 #include "Compiler.h"
 /* #include "7zTypes.h" */
 
+#if defined(LZMA_DECODE_SPEED_OPT) && (LZMA_DECODE_SPEED_OPT == 1)
+#define _LZMA_SPEED_OPT
+#endif
+
+#if defined(LZMA_DECODE_LC3_LP0) && (LZMA_DECODE_LC3_LP0 == 1)
+#define _LZMA_LIT_LC3_LP0
+#endif
+
 #endif
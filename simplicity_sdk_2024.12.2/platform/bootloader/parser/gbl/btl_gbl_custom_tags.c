@@ -35,7 +35,10 @@ const GblCustomTag_t gblCustomTags[] = {
     .numBytesRequired = gbl_lz4NumBytesRequired
   },
 #endif
-#if defined(BTL_PARSER_SUPPORT_LZ4) && defined(BTL_PARSER_SUPPORT_DELTA_DFU)
+// LZ4 reads matches back from the decompressed patch, which isn't kept when
+// delta patches are applied without storage
+#if defined(BTL_PARSER_SUPPORT_LZ4) && defined(BTL_PARSER_SUPPORT_DELTA_DFU) \
+  && !(defined(BOOTLOADER_DELTA_OTW) && (BOOTLOADER_DELTA_OTW == 1))
   {
     .tagId = GBL_TAG_ID_DELTA_LZ4,
     .enterTag = gbl_lz4EnterProgTag,
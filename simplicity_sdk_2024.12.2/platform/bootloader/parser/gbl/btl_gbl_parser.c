@@ -33,6 +33,9 @@
 
 #include "core/btl_util.h"
 #include "core/btl_bootload.h"
+#if defined(BOOTLOADER_DELTA_OTW) && (BOOTLOADER_DELTA_OTW == 1)
+#include "core/btl_delta.h"
+#endif
 
 #if defined (BTL_PARSER_SUPPORT_DELTA_DFU)
 #include <stddef.h>
@@ -178,6 +181,21 @@ static int32_t gbl_getData(ParserContext_t  *context,
                            bool             applySHA,
                            bool             decrypt);
 
+// Get data from the input buffer without copying it, and advance the parser
+// state.
+static uint8_t *gbl_getDataInPlace(ParserContext_t  *context,
+                                   GblInputBuffer_t *input,
+                                   size_t           outputLength,
+                                   bool             applySHA,
+                                   bool             decrypt);
+
+// Checksum, hash and decrypt retrieved data, and advance the parser state.
+static void gbl_processData(ParserContext_t *context,
+                            uint8_t         buffer[],
+                            size_t          length,
+                            bool            applySHA,
+                            bool            decrypt);
+
 // -----------------------------------------------------------------------------
 // Local functions
 
@@ -197,23 +215,35 @@ static bool gbl_storeData(ParserContext_t  *context,
                           GblInputBuffer_t *input)
 {
   size_t position;
+  size_t count;
+  size_t chunk;
 
   if (input->offset >= input->length) {
     return false; // Shouldn't happen, but be safe anyway
   }
 
-  if ((input->length - input->offset) + context->bytesInInternalBuffer
+  count = input->length - input->offset;
+  if (count + context->bytesInInternalBuffer
       > sizeof(context->internalBuffer)) {
     return false; // Buffer overflow
   }
 
-  while (input->offset < input->length) {
-    position = ((size_t)context->internalBufferOffset + (size_t)context->bytesInInternalBuffer)
-               % sizeof(context->internalBuffer);
-    context->internalBuffer[position] = input->buffer[input->offset];
-    input->offset++;
-    context->bytesInInternalBuffer++;
-  }
+  // Copy in at most two chunks: up to the end of the internal buffer, and
+  // the remainder wrapping around to its start
+  BTL_PROFILE_BEGIN(GBL_COPY);
+  position = ((size_t)context->internalBufferOffset + (size_t)context->bytesInInternalBuffer)
+             % sizeof(context->internalBuffer);
+  chunk = SL_MIN(count, sizeof(context->internalBuffer) - position);
+  (void) memcpy(&context->internalBuffer[position],
+                &input->buffer[input->offset],
+                chunk);
+  (void) memcpy(&context->internalBuffer[0],
+                &input->buffer[input->offset + chunk],
+                count - chunk);
+  BTL_PROFILE_END(GBL_COPY, count);
+
+  input->offset += count;
+  context->bytesInInternalBuffer += (uint8_t)count;
 
   return true;
 }
@@ -244,28 +274,38 @@ static int32_t gbl_useData(ParserContext_t  *context,
   if (numberOfBytes > outputBufferSize) {
     return BOOTLOADER_ERROR_PARSER_UNEXPECTED;
   }
-  size_t bytesProcessed = 0UL;
-  // Get data from local buffer first
-  while ((context->bytesInInternalBuffer > 0U)
-         && (bytesProcessed < numberOfBytes)) {
-    // Copy byte from localbuffer
-    outputBuffer[bytesProcessed] =
-      context->internalBuffer[context->internalBufferOffset];
-
-    // Mark byte in storage as read
-    context->internalBufferOffset = (context->internalBufferOffset + 1U)
-                                    % sizeof(context->internalBuffer);
-
-    context->bytesInInternalBuffer--;
-    bytesProcessed++;
-  }
+  size_t bytesProcessed;
+  size_t chunk;
+
+  // Get data from local buffer first, in at most two chunks
+  BTL_PROFILE_BEGIN(GBL_COPY);
+  bytesProcessed = SL_MIN(numberOfBytes,
+                          (size_t)context->bytesInInternalBuffer);
+  chunk = SL_MIN(bytesProcessed,
+                 sizeof(context->internalBuffer)
+                 - (size_t)context->internalBufferOffset);
+  (void) memcpy(outputBuffer,
+                &context->internalBuffer[context->internalBufferOffset],
+                chunk);
+  (void) memcpy(&outputBuffer[chunk],
+                &context->internalBuffer[0],
+                bytesProcessed - chunk);
+
+  // Mark bytes in storage as read
+  context->internalBufferOffset = (uint8_t)(((size_t)context->internalBufferOffset
+                                             + bytesProcessed)
+                                            % sizeof(context->internalBuffer));
+  context->bytesInInternalBuffer -= (uint8_t)bytesProcessed;
 
   // Get data from new buffer when local buffer exhausted
-  while ((input->offset < input->length) && (bytesProcessed < numberOfBytes)) {
-    outputBuffer[bytesProcessed] = input->buffer[input->offset];
-    input->offset++;
-    bytesProcessed++;
-  }
+  chunk = SL_MIN(numberOfBytes - bytesProcessed,
+                 input->length - input->offset);
+  (void) memcpy(&outputBuffer[bytesProcessed],
+                &input->buffer[input->offset],
+                chunk);
+  input->offset += chunk;
+  bytesProcessed += chunk;
+  BTL_PROFILE_END(GBL_COPY, bytesProcessed);
 
   if (bytesProcessed == numberOfBytes) {
     return BOOTLOADER_OK;
@@ -444,23 +484,79 @@ static int32_t gbl_getData(ParserContext_t  *context,
     return retval;
   }
 
+  gbl_processData(context, outputBuffer, outputLength, applySHA, decrypt);
+
+  return BOOTLOADER_ERROR_PARSER_PARSED;
+}
+
+/***************************************************************************//**
+ * Take data directly from the input buffer without copying it, and advance the
+ * parser state. The data is decrypted in place.
+ *
+ * Only used when the internal buffer is empty, so the data is contiguous in the
+ * input buffer.
+ *
+ * @param context            GBL parser context
+ * @param input              Input data
+ * @param outputLength       Number of bytes to take from the input buffer
+ * @param applySHA           Update SHA256 in the GBL parser context
+ * @param decrypt            Decrypt the data
+ *
+ * @return Pointer to the data in the input buffer
+ ******************************************************************************/
+static uint8_t *gbl_getDataInPlace(ParserContext_t  *context,
+                                   GblInputBuffer_t *input,
+                                   size_t           outputLength,
+                                   bool             applySHA,
+                                   bool             decrypt)
+{
+  uint8_t *data = &input->buffer[input->offset];
+
+  input->offset += outputLength;
+  gbl_processData(context, data, outputLength, applySHA, decrypt);
+
+  return data;
+}
+
+/***************************************************************************//**
+ * Checksum, hash and decrypt data taken from the input, and advance the parser
+ * state
+ *
+ * @param context            GBL parser context
+ * @param buffer             Data, decrypted in place
+ * @param length             Data length
+ * @param applySHA           Update SHA256 in the GBL parser context
+ * @param decrypt            Decrypt the data
+ ******************************************************************************/
+static void gbl_processData(ParserContext_t *context,
+                            uint8_t         buffer[],
+                            size_t          length,
+                            bool            applySHA,
+                            bool            decrypt)
+{
   // Update checksum
-  context->fileCrc = btl_crc32Stream(outputBuffer,
-                                     outputLength,
+  BTL_PROFILE_BEGIN(GBL_CRC32);
+  context->fileCrc = btl_crc32Stream(buffer,
+                                     length,
                                      context->fileCrc);
+  BTL_PROFILE_END(GBL_CRC32, length);
 
   // Update SHA256 when requested
   if (applySHA) {
-    btl_updateSha256(context->shaContext, outputBuffer, outputLength);
+    BTL_PROFILE_BEGIN(SHA_UPDATE);
+    btl_updateSha256(context->shaContext, buffer, length);
+    BTL_PROFILE_END(SHA_UPDATE, length);
   }
 
 #ifndef BTL_PARSER_NO_SUPPORT_ENCRYPTION
   // Decrypt data when requested
   if (decrypt && (context->inEncryptedContainer)) {
+    BTL_PROFILE_BEGIN(AES_CTR);
     btl_processAesCtrData(context->aesContext,
-                          outputBuffer,
-                          outputBuffer,
-                          outputLength);
+                          buffer,
+                          buffer,
+                          length);
+    BTL_PROFILE_END(AES_CTR, length);
   }
 #else
   (void) decrypt;
@@ -470,9 +566,7 @@ static int32_t gbl_getData(ParserContext_t  *context,
   // into the parsing logic
   // Note: This has to happen after decryption, since the function updates
   //       the encryption container state
-  gbl_advanceParser(context, outputLength);
-
-  return BOOTLOADER_ERROR_PARSER_PARSED;
+  gbl_advanceParser(context, length);
 }
 
 // -----------------------------------------------------------------------------
@@ -492,11 +586,17 @@ int32_t gbl_writeProgData(ParserContext_t *context,
     return BOOTLOADER_OK;
   }
 
-  if ((uint32_t)buffer & 0x3U) {
-    BTL_DEBUG_PRINTLN("  Unaligned input buffer");
-    // Buffer is unaligned
-    return BOOTLOADER_ERROR_PARSER_BUFFER;
+#if defined(BOOTLOADER_DELTA_OTW) && (BOOTLOADER_DELTA_OTW == 1)
+  if (context->newFwCRC != 0U) {
+    // Delta patch data is applied as it arrives instead of being stored. The
+    // application is only written once the rebuilt image is verified.
+    int32_t retval = delta_applyPatch(context->programmingAddress,
+                                      buffer,
+                                      length);
+    context->programmingAddress += length;
+    return retval;
   }
+#endif
 
   // If application initial PC or reset vectors are in this call, store them and
   // override to FF. Data will be passed to the callback at the end when entire
@@ -549,15 +649,59 @@ int32_t gbl_writeProgData(ParserContext_t *context,
   }
 #endif //BTL_PARSER_SUPPORT_DELTA_DFU
 
+  BTL_PROFILE_BEGIN(FLASH_CALLBACK);
   callbacks->applicationCallback(context->programmingAddress,
                                  buffer,
                                  length,
                                  callbacks->context);
+  BTL_PROFILE_END(FLASH_CALLBACK, length);
   context->programmingAddress += length;
 
   return BOOTLOADER_OK;
 }
 
+// Put back withheld bytes overlapping a buffer read from address
+static void restoreWithheldData(uint32_t      address,
+                                uint8_t       buffer[],
+                                size_t        length,
+                                uint32_t      withheldAddress,
+                                const uint8_t withheld[],
+                                size_t        withheldLength)
+{
+  if ((address < (withheldAddress + withheldLength))
+      && ((address + length) > withheldAddress)) {
+    uint32_t start = SL_MAX(address, withheldAddress);
+    uint32_t end = SL_MIN(address + length, withheldAddress + withheldLength);
+    (void) memcpy(&buffer[start - address],
+                  &withheld[start - withheldAddress],
+                  end - start);
+  }
+}
+
+void gbl_readProgData(const ParserContext_t *context,
+                      uint32_t address,
+                      uint8_t buffer[],
+                      size_t length,
+                      const BootloaderParserCallbacks_t *callbacks)
+{
+  bootload_readApplicationData(address, buffer, length, callbacks->context);
+
+  // gbl_writeProgData replaced these with 0xFF. Every write is a multiple of
+  // a word, so the upgrade vector was withheld if it was written at all.
+  restoreWithheldData(address,
+                      buffer,
+                      length,
+                      (uint32_t) mainBootloaderTable->startOfAppSpace + 4UL,
+                      context->withheldApplicationVectors,
+                      sizeof(context->withheldApplicationVectors));
+  restoreWithheldData(address,
+                      buffer,
+                      length,
+                      BTL_UPGRADE_LOCATION + 4UL,
+                      context->withheldUpgradeVectors,
+                      sizeof(context->withheldUpgradeVectors));
+}
+
 // -----------------------------------------------------------------------------
 // Parser implementation
 
@@ -566,6 +710,9 @@ int32_t gbl_writeProgData(ParserContext_t *context,
  ******************************************************************************/
 int32_t parser_init(void *context, void *decryptContext, void *authContext, uint8_t flags)
 {
+  // Profiling statistics cover a single image
+  BTL_PROFILE_RESET();
+
   // Clean up internal state
   ParserContext_t* parserContext = (ParserContext_t*)context;
   parserContext->internalState = GblParserStateInit;
@@ -601,6 +748,10 @@ int32_t parser_init(void *context, void *decryptContext, void *authContext, uint
   parserContext->newFwCRC = 0x0U;
   parserContext->enableGBLLengthCount = false;
   parserContext->endOfStorageSlot = 0U;
+#if defined(BOOTLOADER_DELTA_OTW) && (BOOTLOADER_DELTA_OTW == 1)
+  // Without storage, the patch is addressed by its offset
+  parserContext->deltaPatchAddress = 0U;
+#endif
 #endif
 
   if (PARSER_REQUIRE_CONFIDENTIALITY && (decryptContext == NULL)) {
@@ -1693,7 +1844,12 @@ static int32_t parser_parseDelta(ParserContext_t  *parserContext,
 
     if (parserContext->lengthOfTag > 4UL) {
       // Only set programmingAddress if the tag actually contains data
+#if defined(BOOTLOADER_DELTA_OTW) && (BOOTLOADER_DELTA_OTW == 1)
+      (void)temporaryWord;
+      parserContext->programmingAddress = parserContext->deltaPatchAddress;
+#else
       parserContext->programmingAddress = temporaryWord;
+#endif
     }
   }
   parserContext->internalState = GblParserStateDeltaData;
@@ -1721,7 +1877,9 @@ static int32_t parser_parseData(ParserContext_t                   *parserContext
 {
   volatile int32_t retval;
   uint8_t tagBuffer[GBL_PARSER_BUFFER_SIZE];
+  uint8_t *data;
   size_t tmpSize;
+  bool inPlace;
 
   while (parserContext->offsetInTag < parserContext->lengthOfTag) {
     // Get amount of bytes left in this tag
@@ -1747,46 +1905,75 @@ static int32_t parser_parseData(ParserContext_t                   *parserContext
     } else {
       // There is less than a word left of this tag, and we have it all
     }
-    // The amount of data we're going to parse in this cycle equals
-    // min(bytes in buffer, bytes left in tag, size of internal buffer)
-    if (tmpSize > GBL_PARSER_BUFFER_SIZE) {
-      tmpSize = GBL_PARSER_BUFFER_SIZE;
-    }
-    if (tmpSize > gbl_getBytesAvailable(parserContext, input)) {
-      tmpSize = gbl_getBytesAvailable(parserContext, input);
-    }
 
-    // Make sure to read word-sized chunks from the buffer for as long
-    // as possible.
-    // We can safely do the rounding down since we already verified
-    // there are 4+ bytes available, or we're at the end of the tag.
-    if (tmpSize >= 4UL) {
+    // Application data is taken in place at any alignment, see
+    // gbl_writeProgData; data for the other callbacks only if word aligned
+    inPlace = ((parserContext->flags & PARSER_FLAG_IN_PLACE) != 0U)
+              && ((parserContext->internalState == GblParserStateProgData)
+                  || ((((uint32_t)&input->buffer[input->offset]) & 0x3UL) == 0UL));
+
+    if (inPlace
+        && (parserContext->bytesInInternalBuffer == 0U)
+        && (tmpSize >= 4UL)
+        && ((input->length - input->offset) >= 4UL)) {
+      // Nothing held back from a previous call: consume as many whole words
+      // as available without copying them.
+      // min(bytes in buffer, bytes left in tag)
+      if (tmpSize > (input->length - input->offset)) {
+        tmpSize = input->length - input->offset;
+      }
       tmpSize &= ~3UL;
-    }
 
-    // Consume data
-    retval = gbl_getData(parserContext,
-                         input,
-                         tagBuffer,
-                         GBL_PARSER_BUFFER_SIZE,
-                         tmpSize,
-                         true,
-                         true);
-    if (retval != BOOTLOADER_ERROR_PARSER_PARSED) {
-      return retval;
+      data = gbl_getDataInPlace(parserContext, input, tmpSize, true, true);
+    } else {
+      // The amount of data we're going to parse in this cycle equals
+      // min(bytes in buffer, bytes left in tag, size of internal buffer)
+      if (tmpSize > GBL_PARSER_BUFFER_SIZE) {
+        tmpSize = GBL_PARSER_BUFFER_SIZE;
+      }
+      if (tmpSize > gbl_getBytesAvailable(parserContext, input)) {
+        tmpSize = gbl_getBytesAvailable(parserContext, input);
+      }
+
+      // Make sure to read word-sized chunks from the buffer for as long
+      // as possible.
+      // We can safely do the rounding down since we already verified
+      // there are 4+ bytes available, or we're at the end of the tag.
+      if (tmpSize >= 4UL) {
+        tmpSize &= ~3UL;
+      }
+      // Only complete the words held back, and take the rest in place
+      if (inPlace
+          && (parserContext->bytesInInternalBuffer != 0U)
+          && (tmpSize > (((size_t)parserContext->bytesInInternalBuffer + 3UL) & ~3UL))) {
+        tmpSize = ((size_t)parserContext->bytesInInternalBuffer + 3UL) & ~3UL;
+      }
+
+      // Consume data
+      retval = gbl_getData(parserContext,
+                           input,
+                           tagBuffer,
+                           GBL_PARSER_BUFFER_SIZE,
+                           tmpSize,
+                           true,
+                           true);
+      if (retval != BOOTLOADER_ERROR_PARSER_PARSED) {
+        return retval;
+      }
+      data = tagBuffer;
     }
 
     // Push back data
     if ((parserContext->internalState == GblParserStateMetadataData)
         && (callbacks->metadataCallback != NULL)) {
       callbacks->metadataCallback(parserContext->tagAddress,
-                                  tagBuffer,
+                                  data,
                                   tmpSize,
                                   callbacks->context);
       parserContext->tagAddress += tmpSize;
     } else {
       while (tmpSize < 4UL) {
-        tagBuffer[tmpSize] = 0xFFU;
+        data[tmpSize] = 0xFFU;
         tmpSize++;
       }
 
@@ -1803,7 +1990,7 @@ static int32_t parser_parseData(ParserContext_t                   *parserContext
         }
 #endif
         // Application data
-        retval = gbl_writeProgData(parserContext, tagBuffer, tmpSize, callbacks);
+        retval = gbl_writeProgData(parserContext, data, tmpSize, callbacks);
         if (retval != BOOTLOADER_OK) {
           return retval;
         }
@@ -1817,7 +2004,7 @@ static int32_t parser_parseData(ParserContext_t                   *parserContext
         if ((parserContext->tagAddress <= 4UL)
             && ((parserContext->tagAddress + tmpSize) >= 7UL)) {
           uint32_t bufferedBtlPcAddress =
-            ((uint32_t)tagBuffer)
+            ((uint32_t)data)
             + (4UL - parserContext->tagAddress);
           (void) memcpy(parserContext->withheldBootloaderVectors,
                         (void*)bufferedBtlPcAddress,
@@ -1828,7 +2015,7 @@ static int32_t parser_parseData(ParserContext_t                   *parserContext
         }
 
         callbacks->bootloaderCallback(parserContext->tagAddress,
-                                      tagBuffer,
+                                      data,
                                       tmpSize,
                                       callbacks->context);
         parserContext->tagAddress += tmpSize;
@@ -1841,7 +2028,7 @@ static int32_t parser_parseData(ParserContext_t                   *parserContext
 #if !defined(BOOTLOADER_SE_UPGRADE_NO_STAGING) \
         || (BOOTLOADER_SE_UPGRADE_NO_STAGING == 0)
         callbacks->bootloaderCallback(parserContext->tagAddress,
-                                      tagBuffer,
+                                      data,
                                       tmpSize,
                                       callbacks->context);
         parserContext->tagAddress += tmpSize;
@@ -1851,7 +2038,7 @@ static int32_t parser_parseData(ParserContext_t                   *parserContext
 #if defined(BTL_PARSER_SUPPORT_DELTA_DFU)
       else if (parserContext->internalState == GblParserStateDeltaData) {
         if (callbacks->applicationCallback != NULL) {
-          retval = gbl_writeProgData(parserContext, tagBuffer, tmpSize, callbacks);
+          retval = gbl_writeProgData(parserContext, data, tmpSize, callbacks);
           if (retval != BOOTLOADER_OK) {
             return retval;
           }
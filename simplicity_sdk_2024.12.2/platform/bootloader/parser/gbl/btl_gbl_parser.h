@@ -53,9 +53,14 @@
 #define PARSER_FLAG_ENCRYPTED               (1U << 0U)
 /// Parse custom tags rather than silently traversing them
 #define PARSER_FLAG_PARSE_CUSTOM_TAGS       (1U << 5U)
+/// Allow the parser to process data in place in the buffer passed to
+/// @ref parser_parse, rather than copying it first. The contents of the
+/// buffer are modified (decrypted, withheld vectors erased).
+#define PARSER_FLAG_IN_PLACE                (1U << 6U)
 
 /// Some flags are public, some are internal to the parser
-#define PARSER_FLAGS_PUBLIC_MASK            PARSER_FLAG_PARSE_CUSTOM_TAGS
+#define PARSER_FLAGS_PUBLIC_MASK            (PARSER_FLAG_PARSE_CUSTOM_TAGS \
+                                             | PARSER_FLAG_IN_PLACE)
 
 /// GBL parser buffer size
 #define GBL_PARSER_BUFFER_SIZE              64UL
@@ -297,7 +302,7 @@ typedef struct {
 /// GBL parser input buffer
 typedef struct {
   /// Pointer to a buffer
-  const uint8_t *buffer;
+  uint8_t       *buffer;
   /// Length of the buffer
   const size_t  length;
   /// Offset of the buffer
@@ -344,7 +349,8 @@ int32_t parser_init(void *context,
  *
  * @param context Pointer to the specific parser's context variable
  * @param imageProperties Pointer to the image file state variable
- * @param buffer Pointer to byte array containing data to parse
+ * @param buffer Pointer to byte array containing data to parse. If the parser
+ *   was initialized with @ref PARSER_FLAG_IN_PLACE, the contents are modified.
  * @param length Size in bytes of the data in buffer
  * @param callbacks Struct containing function pointers to be called by the
  *   parser to pass the extracted binary data back to BTL.
@@ -402,7 +408,8 @@ int32_t parser_verifyCertificate(void *context,
  * @ref GblProg_t structured content.
  *
  * @param context     GBL parser context
- * @param buffer      Input buffer containing data to be written
+ * @param buffer      Input buffer containing data to be written. With
+ *                    @ref PARSER_FLAG_IN_PLACE, it need not be word aligned.
  * @param length      Size of input buffer
  * @param callbacks   GBL Parser callbacks for writing data
  *
@@ -413,6 +420,25 @@ int32_t gbl_writeProgData(ParserContext_t *context,
                           size_t length,
                           const BootloaderParserCallbacks_t *callbacks);
 
+/***************************************************************************//**
+ * Read back application data written with @ref gbl_writeProgData during the
+ * current tag.
+ *
+ * Decompressors use this to refer to earlier output without keeping it in
+ * RAM. Withheld vectors read back as they were passed in.
+ *
+ * @param context     GBL parser context
+ * @param address     Address the data was written to
+ * @param buffer      Buffer to read into
+ * @param length      Number of bytes to read
+ * @param callbacks   GBL Parser callbacks the data was written with
+ ******************************************************************************/
+void gbl_readProgData(const ParserContext_t *context,
+                      uint32_t address,
+                      uint8_t buffer[],
+                      size_t length,
+                      const BootloaderParserCallbacks_t *callbacks);
+
 /** @} addtogroup GblParser */
 /** @} addtogroup ImageParser */
 /** @} addtogroup Components */
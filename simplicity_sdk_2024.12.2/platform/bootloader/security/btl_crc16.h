@@ -33,6 +33,17 @@
 
 /// CRC16 start value
 #define BTL_CRC16_START             0xFFFFU
+/// CRC16 polynomial (CCITT, as used by XMODEM)
+#define BTL_CRC16_POLY              0x1021U
+
+/// Bit-serial CRC16 engine, smallest code size
+#define BTL_CRC16_ENGINE_BITWISE    0
+/// CRC16 engine using a 256-entry lookup table
+#define BTL_CRC16_ENGINE_TABLE      1
+/// CRC16 engine using four lookup tables, processing four bytes per step
+#define BTL_CRC16_ENGINE_SLICE_BY_4 2
+/// CRC16 engine using the GPCRC peripheral
+#define BTL_CRC16_ENGINE_GPCRC      3
 
 /***************************************************************************//**
  * Calculate CRC16 on input.
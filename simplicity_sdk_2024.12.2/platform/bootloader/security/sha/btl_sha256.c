@@ -28,6 +28,7 @@
 #include <string.h>
 
 #include "security/sha/btl_sha256.h"
+#include "em_device.h"
 
 static const uint8_t init_state_sha256[32] =
 {
@@ -167,6 +168,112 @@ int sha_x_finish(SHA_Type_t algo, uint8_t* state, unsigned char *buffer, uint32_
   return 0;
 }
 
+#if !defined(SEMAILBOX_PRESENT) && !defined(CRYPTOACC_PRESENT) \
+  && !defined(CRYPTO_PRESENT)
+// No hash accelerator on this target (e.g. a host build of the parser with a
+// stub em_device.h). Provide a portable SHA-256 block function operating on
+// the same big-endian state layout as the hardware implementations.
+
+static const uint32_t sha256_k[64] =
+{
+  0x428A2F98, 0x71374491, 0xB5C0FBCF, 0xE9B5DBA5,
+  0x3956C25B, 0x59F111F1, 0x923F82A4, 0xAB1C5ED5,
+  0xD807AA98, 0x12835B01, 0x243185BE, 0x550C7DC3,
+  0x72BE5D74, 0x80DEB1FE, 0x9BDC06A7, 0xC19BF174,
+  0xE49B69C1, 0xEFBE4786, 0x0FC19DC6, 0x240CA1CC,
+  0x2DE92C6F, 0x4A7484AA, 0x5CB0A9DC, 0x76F988DA,
+  0x983E5152, 0xA831C66D, 0xB00327C8, 0xBF597FC7,
+  0xC6E00BF3, 0xD5A79147, 0x06CA6351, 0x14292967,
+  0x27B70A85, 0x2E1B2138, 0x4D2C6DFC, 0x53380D13,
+  0x650A7354, 0x766A0ABB, 0x81C2C92E, 0x92722C85,
+  0xA2BFE8A1, 0xA81A664B, 0xC24B8B70, 0xC76C51A3,
+  0xD192E819, 0xD6990624, 0xF40E3585, 0x106AA070,
+  0x19A4C116, 0x1E376C08, 0x2748774C, 0x34B0BCB5,
+  0x391C0CB3, 0x4ED8AA4A, 0x5B9CCA4F, 0x682E6FF3,
+  0x748F82EE, 0x78A5636F, 0x84C87814, 0x8CC70208,
+  0x90BEFFFA, 0xA4506CEB, 0xBEF9A3F7, 0xC67178F2
+};
+
+#define SHA256_ROTR(x, n)  (((x) >> (n)) | ((x) << (32 - (n))))
+#define SHA256_S0(x)       (SHA256_ROTR(x, 2) ^ SHA256_ROTR(x, 13) ^ SHA256_ROTR(x, 22))
+#define SHA256_S1(x)       (SHA256_ROTR(x, 6) ^ SHA256_ROTR(x, 11) ^ SHA256_ROTR(x, 25))
+#define SHA256_G0(x)       (SHA256_ROTR(x, 7) ^ SHA256_ROTR(x, 18) ^ ((x) >> 3))
+#define SHA256_G1(x)       (SHA256_ROTR(x, 17) ^ SHA256_ROTR(x, 19) ^ ((x) >> 10))
+
+static uint32_t sha256_loadBe32(const uint8_t *p)
+{
+  return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16)
+         | ((uint32_t)p[2] << 8) | (uint32_t)p[3];
+}
+
+static void sha256_storeBe32(uint8_t *p, uint32_t v)
+{
+  p[0] = (uint8_t)(v >> 24);
+  p[1] = (uint8_t)(v >> 16);
+  p[2] = (uint8_t)(v >> 8);
+  p[3] = (uint8_t)v;
+}
+
+int sha_x_process(SHA_Type_t algo,
+                  uint8_t* state_in,
+                  const unsigned char *blockdata,
+                  uint8_t* state_out,
+                  uint32_t num_blocks)
+{
+  uint32_t h[8];
+  uint32_t w[64];
+
+  if (algo != SHA256) {
+    return MBEDTLS_ERR_MD_FEATURE_UNAVAILABLE;
+  }
+
+  for (size_t i = 0; i < 8; i++) {
+    h[i] = sha256_loadBe32(&state_in[i * 4]);
+  }
+
+  while (num_blocks-- > 0) {
+    uint32_t a = h[0], b = h[1], c = h[2], d = h[3];
+    uint32_t e = h[4], f = h[5], g = h[6], k = h[7];
+
+    for (size_t i = 0; i < 16; i++) {
+      w[i] = sha256_loadBe32(&blockdata[i * 4]);
+    }
+    for (size_t i = 16; i < 64; i++) {
+      w[i] = SHA256_G1(w[i - 2]) + w[i - 7] + SHA256_G0(w[i - 15]) + w[i - 16];
+    }
+
+    for (size_t i = 0; i < 64; i++) {
+      uint32_t t1 = k + SHA256_S1(e) + ((e & f) ^ (~e & g)) + sha256_k[i] + w[i];
+      uint32_t t2 = SHA256_S0(a) + ((a & b) ^ (a & c) ^ (b & c));
+      k = g;
+      g = f;
+      f = e;
+      e = d + t1;
+      d = c;
+      c = b;
+      b = a;
+      a = t1 + t2;
+    }
+
+    h[0] += a;
+    h[1] += b;
+    h[2] += c;
+    h[3] += d;
+    h[4] += e;
+    h[5] += f;
+    h[6] += g;
+    h[7] += k;
+    blockdata += 64;
+  }
+
+  for (size_t i = 0; i < 8; i++) {
+    sha256_storeBe32(&state_out[i * 4], h[i]);
+  }
+
+  return 0;
+}
+#endif // !SEMAILBOX_PRESENT && !CRYPTOACC_PRESENT && !CRYPTO_PRESENT
+
 void btl_sha256_init(btl_sha256_context *ctx)
 {
   memset(ctx, 0, sizeof(btl_sha256_context));
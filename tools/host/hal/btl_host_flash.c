@@ -0,0 +1,174 @@
+/***************************************************************************//**
+ * @file
+ * @brief Model of the internal flash, mapped at its target address.
+ *
+ * The bootloader reads flash through plain pointers, so the flash contents
+ * are mapped read-only at FLASH_BASE, and modified through a second, writable
+ * mapping of the same memory. Erase and program operations replace the
+ * emlib MSC functions, charge the configured flash timing to the virtual
+ * clock, and keep the semantics of NOR flash: programming can only clear
+ * bits.
+ ******************************************************************************/
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "em_device.h"
+#include "em_msc.h"
+
+#include "btl_host_internal.h"
+
+static uint8_t *flash;
+static BtlHostFlashStats_t stats;
+
+static void flashMap(void)
+{
+  int fd;
+  void *view;
+
+  if (flash != NULL) {
+    return;
+  }
+  fd = memfd_create("btl_host_flash", 0);
+  if (fd < 0 || ftruncate(fd, FLASH_SIZE) != 0) {
+    perror("btl_host: flash");
+    exit(2);
+  }
+  view = mmap((void *)FLASH_BASE, FLASH_SIZE, PROT_READ,
+              MAP_SHARED | MAP_FIXED_NOREPLACE, fd, 0);
+  if (view != (void *)FLASH_BASE) {
+    perror("btl_host: flash at FLASH_BASE");
+    exit(2);
+  }
+  flash = mmap(NULL, FLASH_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  if (flash == MAP_FAILED) {
+    perror("btl_host: flash");
+    exit(2);
+  }
+  close(fd);
+}
+
+void btl_host_flashReset(void)
+{
+  flashMap();
+  memset(&stats, 0, sizeof(stats));
+}
+
+void btl_host_flashErase(void)
+{
+  flashMap();
+  memset(flash, 0xFF, FLASH_SIZE);
+}
+
+void btl_host_flashLoad(uint32_t address, const void *data, size_t length)
+{
+  flashMap();
+  if (!btl_host_flashContains(address, (uint32_t)length)) {
+    fprintf(stderr, "btl_host: load outside flash at 0x%08x\n", (unsigned)address);
+    exit(2);
+  }
+  memcpy(flash + (address - FLASH_BASE), data, length);
+}
+
+const BtlHostFlashStats_t *btl_host_flashStats(void)
+{
+  return &stats;
+}
+
+bool btl_host_flashContains(uint32_t address, uint32_t length)
+{
+  return (address >= FLASH_BASE)
+         && (length <= FLASH_SIZE)
+         && ((address - FLASH_BASE) <= (FLASH_SIZE - length));
+}
+
+bool btl_host_flashProgram(uint32_t address, uint32_t word)
+{
+  uint32_t current;
+
+  if ((address & 3U) != 0U || !btl_host_flashContains(address, 4U)) {
+    return false;
+  }
+  memcpy(&current, flash + (address - FLASH_BASE), sizeof(current));
+  if ((current & word) != word) {
+    stats.badWrites++;
+  }
+  current &= word;
+  memcpy(flash + (address - FLASH_BASE), &current, sizeof(current));
+  stats.wordWrites++;
+  return true;
+}
+
+// -----------------------------------------------------------------------------
+// emlib MSC
+
+void MSC_Init(void)
+{
+}
+
+void MSC_Deinit(void)
+{
+}
+
+MSC_Status_TypeDef MSC_ErasePage(uint32_t *startAddress)
+{
+  uint32_t address = (uint32_t)(uintptr_t)startAddress;
+
+  btl_host_sync();
+  if ((address & (FLASH_PAGE_SIZE - 1U)) != 0U) {
+    return mscReturnUnaligned;
+  }
+  if (!btl_host_flashContains(address, FLASH_PAGE_SIZE)) {
+    return mscReturnInvalidAddr;
+  }
+  memset(flash + (address - FLASH_BASE), 0xFF, FLASH_PAGE_SIZE);
+  stats.pageErases++;
+  btl_host_advance((uint64_t)btl_host_timing.pageEraseUs * 1000000U);
+  return mscReturnOk;
+}
+
+static MSC_Status_TypeDef writeWords(uint32_t *address,
+                                     const void *data,
+                                     uint32_t numBytes)
+{
+  uint32_t dst = (uint32_t)(uintptr_t)address;
+  const uint8_t *src = (const uint8_t *)data;
+
+  btl_host_sync();
+  if ((dst & 3U) != 0U || (numBytes & 3U) != 0U) {
+    return mscReturnUnaligned;
+  }
+  if (!btl_host_flashContains(dst, numBytes)) {
+    return mscReturnInvalidAddr;
+  }
+  for (uint32_t i = 0; i < numBytes; i += 4U) {
+    uint32_t word;
+    memcpy(&word, src + i, sizeof(word));
+    (void)btl_host_flashProgram(dst + i, word);
+  }
+  btl_host_advance((uint64_t)(numBytes / 4U) * btl_host_timing.wordWriteNs * 1000U);
+  return mscReturnOk;
+}
+
+MSC_Status_TypeDef MSC_WriteWord(uint32_t *address,
+                                 void const *data,
+                                 uint32_t numBytes)
+{
+  return writeWords(address, data, numBytes);
+}
+
+MSC_Status_TypeDef MSC_WriteWordDma(int ch,
+                                    uint32_t *address,
+                                    const void *data,
+                                    uint32_t numBytes)
+{
+  (void)ch;
+  // The LDMA transfers whole words from word aligned addresses
+  if (((uintptr_t)data & 3U) != 0U) {
+    return mscReturnUnaligned;
+  }
+  return writeWords(address, data, numBytes);
+}
@@ -0,0 +1,12 @@
+/***************************************************************************//**
+ * @file
+ * @brief GBL tag table of the bootloader, built for the host.
+ *
+ * The host build has no SE, so the parser has no state for SE upgrade tags
+ * while the series 2 tag table still lists them. Such tags are rejected.
+ ******************************************************************************/
+#include "parser/gbl/btl_gbl_parser.h"
+
+#define GblParserStateSe GblParserStateError
+
+#include "parser/gbl/btl_gbl_format.c"
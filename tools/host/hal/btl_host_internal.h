@@ -0,0 +1,39 @@
+/***************************************************************************//**
+ * @file
+ * @brief Interfaces between the parts of the host platform.
+ ******************************************************************************/
+#ifndef BTL_HOST_INTERNAL_H
+#define BTL_HOST_INTERNAL_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "btl_host.h"
+
+/// Picoseconds per core clock cycle, rounded to the nearest picosecond
+#define BTL_HOST_CYCLE_PS \
+  ((BTL_HOST_PS_PER_S + (btl_host_timing.cpuHz / 2U)) / btl_host_timing.cpuHz)
+
+/// Let the peripheral models act on the register writes made since the last
+/// peripheral access
+void btl_host_sync(void);
+
+/// Reset the peripheral and line models
+void btl_host_periphReset(void);
+
+/// Restart TIMER0 counting, with a prescaler
+void btl_host_timerStart(uint32_t prescale);
+
+/// Reset the flash model
+void btl_host_flashReset(void);
+
+/// Whether an address is in flash
+bool btl_host_flashContains(uint32_t address, uint32_t length);
+
+/// Program a word of flash, ANDing it with the current contents
+bool btl_host_flashProgram(uint32_t address, uint32_t word);
+
+/// Reset the platform state of the bootloader: tokens and keys
+void btl_host_platformReset(void);
+
+#endif // BTL_HOST_INTERNAL_H
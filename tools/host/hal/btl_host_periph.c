@@ -0,0 +1,959 @@
+/***************************************************************************//**
+ * @file
+ * @brief Models of the peripherals the bootloader drives: LDMA, USART0,
+ *   TIMER0, GPIO, GPCRC and the flash controller, and of the serial line
+ *   between the host and USART0.
+ *
+ * The bootloader writes the register blocks in host memory directly. The
+ * models act on those writes at the next access through the LDMA, TIMER0
+ * and MSC accessors, which the bootloader polls in all of its wait loops.
+ * The SET, CLR and TGL aliases of each register block are folded into the
+ * registers, and command registers are executed and cleared.
+ *
+ * Timing is modelled as follows:
+ * - Each accessor call costs btl_host_timing.accessCycles core cycles.
+ * - Bytes travel on the line in ten bit times each (8N1), back to back as
+ *   long as the host has data and, with flow control, RTS allows it.
+ * - USART0 holds two received frames; the LDMA moves them into memory as
+ *   long as the current descriptor lets it. Frames arriving at a full FIFO
+ *   are lost (overrun).
+ * - The TIMECMP1 comparator counts bit times from the end of a received
+ *   frame, stops when the next frame starts, and restarts on expiry when
+ *   RESTARTEN is set.
+ * - TIMER0 counts prescaled core cycles and wraps at 16 bits.
+ * - The LDMA writes flash words one per btl_host_timing.wordWriteNs.
+ * - GPCRC computes without cost. Only byte input (INPUTDATABYTE) is
+ *   modelled, and only where the bootloader is built with BTL_HOST_GPCRC.
+ ******************************************************************************/
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "em_device.h"
+#include "em_ldma.h"
+#include "btl_uart_driver_cfg.h"
+
+#include "btl_host_internal.h"
+
+// -----------------------------------------------------------------------------
+// Register blocks
+
+USART_TypeDef    btl_host_usart0;
+GPIO_TypeDef     btl_host_gpio;
+CMU_TypeDef      btl_host_cmu;
+HFRCO_TypeDef    btl_host_hfrco0;
+LDMAXBAR_TypeDef btl_host_ldmaxbar;
+CoreDebug_Type   btl_host_coredebug;
+
+static LDMA_TypeDef  ldma;
+static TIMER_TypeDef timer0;
+static DWT_Type      dwt;
+static MSC_TypeDef   msc;
+static GPCRC_TypeDef gpcrc;
+
+BtlHostTiming_t btl_host_timing = {
+  .cpuHz = 19000000UL,
+  .accessCycles = 20U,
+  .pageEraseUs = 12000U,
+  .wordWriteNs = 11000U,
+};
+
+BtlHostLine_t btl_host_line = {
+  .lossPpm = 0U,
+  .seed = 1U,
+  .ctsLagBytes = 0U,
+  .flowControl = true,
+};
+
+// Offset of the SET, CLR and TGL aliases of series 2 register blocks, in words
+#define ALIAS_SET_WORDS            (0x1000U / 4U)
+#define ALIAS_CLR_WORDS            (0x2000U / 4U)
+#define ALIAS_TGL_WORDS            (0x3000U / 4U)
+
+// Write to TXDATA not seen yet
+#define USART_TXDATA_IDLE          0xFFFFFFFFUL
+// Write to ADDRB not seen yet
+#define MSC_ADDRB_IDLE             0xFFFFFFFFUL
+// Write to INPUTDATABYTE not seen yet
+#define GPCRC_INPUT_IDLE           0xFFFFFFFFUL
+// Polynomial of the CRC32 mode of GPCRC, bit reversed
+#define GPCRC_CRC32_POLY_REV       0xEDB88320UL
+
+#define RX_FIFO_DEPTH              2U
+#define TX_FIFO_DEPTH              2U
+#define TX_QUEUE_SIZE              256U
+#define BITS_PER_FRAME             10U
+#define NO_EVENT                   UINT64_MAX
+
+// Writes a register that is read-only for the bootloader
+#define HW(reg)                    (*(volatile uint32_t *)&(reg))
+
+// -----------------------------------------------------------------------------
+// Model state
+
+typedef struct {
+  bool              active;
+  uint32_t          descAddress;   // Address of the current descriptor
+  LDMA_Descriptor_t desc;          // Current descriptor
+  uint32_t          remaining;     // Units left in an XFER descriptor
+} Channel_t;
+
+static struct {
+  uint64_t now;                    // Virtual time, ps
+  bool     hostProfileClock;
+
+  // LDMA
+  Channel_t channel[LDMA_CH_NUM];
+  uint32_t  sync;                  // Synchronization trigger bits
+  uint32_t  chen;                  // CHEN as last seen
+
+  // USART0
+  uint8_t  rxFifo[RX_FIFO_DEPTH];
+  uint32_t rxFifoCount;
+  uint8_t  txFifo[TX_QUEUE_SIZE];  // Frames waiting for the shifter
+  uint32_t txFifoHead;
+  uint32_t txFifoCount;
+  uint32_t timecmp1;               // TIMECMP1 as last seen
+  bool     idleTimerRunning;
+  uint64_t idleTimerStart;
+  uint64_t idleExpiries;           // Comparator expiries flagged so far
+
+  // TIMER0
+  uint64_t timerStart;
+  uint64_t timerTickPs;
+  uint64_t timerWrapsAcked;
+
+  // GPIO
+  bool     rts;                    // RTS allows the host to send
+  uint64_t rtsDeassertedAt;
+
+  // MSC
+  uint32_t mscAddress;             // Next word the LDMA writes to
+  bool     mscWordBusy;
+  uint64_t mscWordDone;
+
+  // Line, host to device
+  uint8_t  *lineQueue;
+  size_t   lineQueueSize;
+  size_t   lineHead;
+  size_t   lineCount;
+  bool     rxBusy;                 // A frame is on the line
+  bool     rxLost;                 // The frame on the line will be lost
+  uint8_t  rxByte;
+  uint64_t rxDone;
+  uint32_t ctsBudget;              // Frames the host sends after RTS drops
+  uint64_t lossState;
+
+  // Line, device to host
+  bool     txBusy;
+  uint8_t  txByte;
+  uint64_t txDone;
+
+  uint64_t hostTimer;
+  BtlHostLineHandler_t handler;
+  BtlHostLineStats_t   stats;
+} model;
+
+static void advanceTo(uint64_t target);
+
+// -----------------------------------------------------------------------------
+// Helpers
+
+// Fold writes to the SET, CLR and TGL aliases of the registers in the first
+// live bytes of a register block into the registers
+static void foldAliases(void *block, size_t live)
+{
+  // The registers are only written by the bootloader between calls, so the
+  // aliases are scanned without volatile accesses first
+  uint32_t *word = (uint32_t *)block;
+  uint32_t any = 0U;
+
+  for (size_t i = 0; i < live / 4U; i++) {
+    any |= word[ALIAS_SET_WORDS + i] | word[ALIAS_CLR_WORDS + i]
+           | word[ALIAS_TGL_WORDS + i];
+  }
+  if (any == 0U) {
+    return;
+  }
+  for (size_t i = 0; i < live / 4U; i++) {
+    uint32_t set = word[ALIAS_SET_WORDS + i];
+    uint32_t clr = word[ALIAS_CLR_WORDS + i];
+    uint32_t tgl = word[ALIAS_TGL_WORDS + i];
+
+    word[i] = ((word[i] | set) & ~clr) ^ tgl;
+    word[ALIAS_SET_WORDS + i] = 0U;
+    word[ALIAS_CLR_WORDS + i] = 0U;
+    word[ALIAS_TGL_WORDS + i] = 0U;
+  }
+}
+
+static uint32_t baudRate(void)
+{
+  uint32_t clkdiv = btl_host_usart0.CLKDIV & _USART_CLKDIV_DIV_MASK;
+  uint64_t baud = ((uint64_t)btl_host_timing.cpuHz * 256U)
+                  / (16U * (256U + (uint64_t)clkdiv));
+
+  return (baud == 0U) ? 1U : (uint32_t)baud;
+}
+
+static uint64_t bitPs(void)
+{
+  return BTL_HOST_PS_PER_S / baudRate();
+}
+
+// xorshift64, one step per byte sent to the device
+static bool nextByteLost(void)
+{
+  uint64_t x = model.lossState;
+
+  x ^= x << 13;
+  x ^= x >> 7;
+  x ^= x << 17;
+  model.lossState = x;
+  return (x % 1000000U) < btl_host_line.lossPpm;
+}
+
+// -----------------------------------------------------------------------------
+// USART0 receive idle timer
+
+static uint64_t idlePeriodPs(void)
+{
+  uint32_t bits = (model.timecmp1 & _USART_TIMECMP1_TCMPVAL_MASK)
+                  >> _USART_TIMECMP1_TCMPVAL_SHIFT;
+
+  return (uint64_t)bits * bitPs();
+}
+
+// Raise TCMP1 for comparator expiries up to now
+static void idleTimerUpdate(void)
+{
+  uint64_t period = idlePeriodPs();
+  uint64_t expiries;
+
+  if (!model.idleTimerRunning || period == 0U) {
+    return;
+  }
+  expiries = (model.now - model.idleTimerStart) / period;
+  if ((model.timecmp1 & USART_TIMECMP1_RESTARTEN) == 0U && expiries > 1U) {
+    expiries = 1U;
+  }
+  if (expiries > model.idleExpiries) {
+    model.idleExpiries = expiries;
+    btl_host_usart0.IF |= USART_IF_TCMP1;
+  }
+}
+
+static void idleTimerStart(void)
+{
+  if ((model.timecmp1 & _USART_TIMECMP1_TSTART_MASK) == USART_TIMECMP1_TSTART_RXEOF) {
+    model.idleTimerRunning = true;
+    model.idleTimerStart = model.now;
+    model.idleExpiries = 0U;
+  }
+}
+
+static void idleTimerStop(void)
+{
+  idleTimerUpdate();
+  if ((model.timecmp1 & _USART_TIMECMP1_TSTOP_MASK) == USART_TIMECMP1_TSTOP_RXACT) {
+    model.idleTimerRunning = false;
+  }
+}
+
+// -----------------------------------------------------------------------------
+// LDMA
+
+static uint32_t channelRequest(unsigned ch)
+{
+  return btl_host_ldmaxbar.CH[ch].REQSEL;
+}
+
+static void channelStop(unsigned ch)
+{
+  model.channel[ch].active = false;
+  ldma.CHEN &= ~(1UL << ch);
+  HW(ldma.CHSTATUS) &= ~(1UL << ch);
+  model.chen &= ~(1UL << ch);
+}
+
+static void channelLoad(unsigned ch, uint32_t address)
+{
+  Channel_t *c = &model.channel[ch];
+
+  c->descAddress = address;
+  memcpy(&c->desc, (const void *)(uintptr_t)address, sizeof(c->desc));
+  c->active = true;
+  ldma.CHEN |= 1UL << ch;
+  HW(ldma.CHSTATUS) |= 1UL << ch;
+  model.chen |= 1UL << ch;
+
+  if (c->desc.xfer.structType == ldmaCtrlStructTypeXfer) {
+    c->remaining = c->desc.xfer.xferCnt + 1U;
+    ldma.CH[ch].SRC = c->desc.xfer.srcAddr;
+    ldma.CH[ch].DST = c->desc.xfer.dstAddr;
+  } else if (c->desc.xfer.structType == ldmaCtrlStructTypeSync) {
+    const uint32_t *words = (const uint32_t *)&c->desc;
+
+    model.sync |= c->desc.sync.syncSet;
+    model.sync &= ~(uint32_t)c->desc.sync.syncClr;
+    c->remaining = 0U;
+    // While a SYNC descriptor waits, DST reads back its match word
+    ldma.CH[ch].DST = words[2];
+  }
+}
+
+// Start a channel from its CTRL, SRC and DST registers
+static void channelStartFromRegisters(unsigned ch)
+{
+  Channel_t *c = &model.channel[ch];
+  uint32_t ctrl = ldma.CH[ch].CTRL;
+
+  memset(&c->desc, 0, sizeof(c->desc));
+  c->desc.xfer.structType = ldmaCtrlStructTypeXfer;
+  c->desc.xfer.xferCnt = (ctrl & _LDMA_CH_CTRL_XFERCNT_MASK) >> _LDMA_CH_CTRL_XFERCNT_SHIFT;
+  c->desc.xfer.size = (ctrl & _LDMA_CH_CTRL_SIZE_MASK) >> _LDMA_CH_CTRL_SIZE_SHIFT;
+  c->desc.xfer.srcInc = (ctrl & _LDMA_CH_CTRL_SRCINC_MASK) >> _LDMA_CH_CTRL_SRCINC_SHIFT;
+  c->desc.xfer.dstInc = (ctrl & _LDMA_CH_CTRL_DSTINC_MASK) >> _LDMA_CH_CTRL_DSTINC_SHIFT;
+  c->desc.xfer.doneIfs = (ctrl & _LDMA_CH_CTRL_DONEIEN_MASK) >> _LDMA_CH_CTRL_DONEIEN_SHIFT;
+  c->desc.xfer.srcAddr = ldma.CH[ch].SRC;
+  c->desc.xfer.dstAddr = ldma.CH[ch].DST;
+  c->descAddress = 0U;
+  c->remaining = c->desc.xfer.xferCnt + 1U;
+  c->active = true;
+  HW(ldma.CHSTATUS) |= 1UL << ch;
+}
+
+static void channelComplete(unsigned ch)
+{
+  Channel_t *c = &model.channel[ch];
+
+  if (c->desc.xfer.doneIfs || !c->desc.xfer.link) {
+    ldma.CHDONE |= 1UL << ch;
+  }
+  if (c->desc.xfer.link) {
+    uint32_t next;
+
+    if (c->desc.xfer.linkMode == ldmaLinkModeRel) {
+      next = c->descAddress + (uint32_t)(c->desc.xfer.linkAddr * 4);
+    } else {
+      next = (uint32_t)c->desc.xfer.linkAddr << 2;
+    }
+    channelLoad(ch, next);
+  } else {
+    channelStop(ch);
+  }
+}
+
+static uint32_t unitSize(const LDMA_Descriptor_t *desc)
+{
+  return 1UL << desc->xfer.size;
+}
+
+static uint32_t increment(uint32_t inc, uint32_t size)
+{
+  // ldmaCtrlSrcIncNone is 3; the others count units
+  return (inc == ldmaCtrlSrcIncNone) ? 0U : ((1UL << inc) * size);
+}
+
+// Move data for all channels as far as the peripherals allow at this time
+static void ldmaService(void)
+{
+  bool progress;
+
+  do {
+    progress = false;
+    for (unsigned ch = 0; ch < LDMA_CH_NUM; ch++) {
+      Channel_t *c = &model.channel[ch];
+      uint32_t request;
+
+      if (!c->active) {
+        continue;
+      }
+      if (c->desc.xfer.structType == ldmaCtrlStructTypeSync) {
+        uint32_t en = c->desc.sync.matchEn;
+        if ((model.sync & en) == (c->desc.sync.matchVal & en)) {
+          channelComplete(ch);
+          progress = true;
+        }
+        continue;
+      }
+      if (c->desc.xfer.structType != ldmaCtrlStructTypeXfer) {
+        channelComplete(ch);
+        progress = true;
+        continue;
+      }
+
+      request = channelRequest(ch);
+      if (request == ldmaPeripheralSignal_USART0_RXDATAV) {
+        while (c->remaining > 0U && model.rxFifoCount > 0U) {
+          *(uint8_t *)(uintptr_t)ldma.CH[ch].DST = model.rxFifo[0];
+          model.rxFifo[0] = model.rxFifo[1];
+          model.rxFifoCount--;
+          ldma.CH[ch].DST += increment(c->desc.xfer.dstInc, 1U);
+          c->remaining--;
+          progress = true;
+        }
+      } else if (request == ldmaPeripheralSignal_USART0_TXBL) {
+        while (c->remaining > 0U && model.txFifoCount < TX_FIFO_DEPTH) {
+          uint32_t tail = (model.txFifoHead + model.txFifoCount) % TX_QUEUE_SIZE;
+          model.txFifo[tail] = *(const uint8_t *)(uintptr_t)ldma.CH[ch].SRC;
+          model.txFifoCount++;
+          ldma.CH[ch].SRC += increment(c->desc.xfer.srcInc, 1U);
+          c->remaining--;
+          progress = true;
+        }
+      } else if (request == ldmaPeripheralSignal_MSC_WDATA) {
+        if (c->remaining > 0U && !model.mscWordBusy) {
+          model.mscWordBusy = true;
+          model.mscWordDone = model.now
+                              + (uint64_t)btl_host_timing.wordWriteNs * 1000U;
+        }
+      } else {
+        // Memory to memory
+        while (c->remaining > 0U) {
+          uint32_t size = unitSize(&c->desc);
+          memcpy((void *)(uintptr_t)ldma.CH[ch].DST,
+                 (const void *)(uintptr_t)ldma.CH[ch].SRC, size);
+          ldma.CH[ch].SRC += increment(c->desc.xfer.srcInc, size);
+          ldma.CH[ch].DST += increment(c->desc.xfer.dstInc, size);
+          c->remaining--;
+        }
+        progress = true;
+      }
+      if (c->active && c->remaining == 0U
+          && c->desc.xfer.structType == ldmaCtrlStructTypeXfer) {
+        channelComplete(ch);
+        progress = true;
+      }
+    }
+  } while (progress);
+}
+
+static void mscWordComplete(void)
+{
+  for (unsigned ch = 0; ch < LDMA_CH_NUM; ch++) {
+    Channel_t *c = &model.channel[ch];
+
+    if (!c->active || c->remaining == 0U
+        || channelRequest(ch) != ldmaPeripheralSignal_MSC_WDATA) {
+      continue;
+    }
+    uint32_t word;
+    memcpy(&word, (const void *)(uintptr_t)ldma.CH[ch].SRC, sizeof(word));
+    if (!btl_host_flashProgram(model.mscAddress, word)) {
+      HW(msc.STATUS) |= MSC_STATUS_INVADDR;
+    }
+    model.mscAddress += 4U;
+    ldma.CH[ch].SRC += increment(c->desc.xfer.srcInc, 4U);
+    c->remaining--;
+    break;
+  }
+  model.mscWordBusy = false;
+  ldmaService();
+}
+
+static void ldmaCommit(void)
+{
+  uint32_t bits;
+
+  foldAliases(&ldma, offsetof(LDMA_TypeDef, RESERVED0));
+
+  if (ldma.SYNCSWSET != 0U) {
+    model.sync |= ldma.SYNCSWSET;
+    ldma.SYNCSWSET = 0U;
+  }
+  if (ldma.SYNCSWCLR != 0U) {
+    model.sync &= ~ldma.SYNCSWCLR;
+    ldma.SYNCSWCLR = 0U;
+  }
+  HW(ldma.SYNCSTATUS) = model.sync;
+
+  bits = ldma.CHDIS;
+  ldma.CHDIS = 0U;
+  for (unsigned ch = 0; ch < LDMA_CH_NUM; ch++) {
+    if (bits & (1UL << ch)) {
+      channelStop(ch);
+    }
+  }
+
+  bits = ldma.LINKLOAD;
+  ldma.LINKLOAD = 0U;
+  for (unsigned ch = 0; ch < LDMA_CH_NUM; ch++) {
+    if (bits & (1UL << ch)) {
+      channelLoad(ch, ldma.CH[ch].LINK & _LDMA_CH_LINK_LINKADDR_MASK);
+    }
+  }
+
+  // Channels enabled or disabled by writing CHEN
+  for (unsigned ch = 0; ch < LDMA_CH_NUM; ch++) {
+    uint32_t bit = 1UL << ch;
+
+    if ((ldma.CHEN & bit) && !(model.chen & bit)) {
+      channelStartFromRegisters(ch);
+    } else if (!(ldma.CHEN & bit) && (model.chen & bit)) {
+      channelStop(ch);
+    }
+  }
+  model.chen = ldma.CHEN;
+
+  ldmaService();
+}
+
+// -----------------------------------------------------------------------------
+// USART0, GPIO, TIMER0 and MSC registers
+
+static void usartCommit(void)
+{
+  foldAliases(&btl_host_usart0, offsetof(USART_TypeDef, RESERVED0));
+
+  if (btl_host_usart0.CMD != 0U) {
+    if (btl_host_usart0.CMD & USART_CMD_CLEARRX) {
+      model.rxFifoCount = 0U;
+    }
+    if (btl_host_usart0.CMD & USART_CMD_CLEARTX) {
+      model.txFifoCount = 0U;
+    }
+    btl_host_usart0.CMD = 0U;
+  }
+  if (btl_host_usart0.TXDATA != USART_TXDATA_IDLE) {
+    if (model.txFifoCount < TX_QUEUE_SIZE) {
+      uint32_t tail = (model.txFifoHead + model.txFifoCount) % TX_QUEUE_SIZE;
+      model.txFifo[tail] = (uint8_t)btl_host_usart0.TXDATA;
+      model.txFifoCount++;
+    }
+    btl_host_usart0.TXDATA = USART_TXDATA_IDLE;
+  }
+  if (btl_host_usart0.TIMECMP1 != model.timecmp1) {
+    // The comparator starts on the next end of frame
+    model.timecmp1 = btl_host_usart0.TIMECMP1;
+    model.idleTimerRunning = false;
+  }
+  HW(btl_host_usart0.STATUS) = USART_STATUS_TXBL | USART_STATUS_TXC | USART_STATUS_TXIDLE
+                           | ((model.rxFifoCount > 0U) ? USART_STATUS_RXDATAV : 0U);
+}
+
+static bool rtsPinAsserted(void)
+{
+#if defined(SL_SERIAL_UART_RTS_PORT) && (SL_SERIAL_UART_FLOW_CONTROL == 1)
+  // RTS is active low
+  return (btl_host_gpio.P[SL_SERIAL_UART_RTS_PORT].DOUT
+          & (1UL << SL_SERIAL_UART_RTS_PIN)) == 0U;
+#else
+  return true;
+#endif
+}
+
+static void gpioCommit(void)
+{
+  bool rts;
+
+  // Only the port registers are modelled
+  foldAliases(&btl_host_gpio, offsetof(GPIO_TypeDef, RESERVED1));
+  rts = rtsPinAsserted();
+  if (rts != model.rts) {
+    model.rts = rts;
+    if (!rts) {
+      model.stats.rtsDeassertions++;
+      model.rtsDeassertedAt = model.now;
+      model.ctsBudget = btl_host_line.ctsLagBytes;
+    } else {
+      model.stats.rtsDeassertedPs += model.now - model.rtsDeassertedAt;
+    }
+  }
+}
+
+static void timerCommit(void)
+{
+  foldAliases(&timer0, offsetof(TIMER_TypeDef, RESERVED3));
+}
+
+// Bring the counter and overflow flag of TIMER0 up to date
+static void timerUpdate(void)
+{
+  uint64_t ticks;
+
+  if (model.timerTickPs == 0U) {
+    return;
+  }
+  ticks = (model.now - model.timerStart) / model.timerTickPs;
+  timer0.CNT = (uint32_t)(ticks & 0xFFFFU);
+  if ((ticks >> 16) > model.timerWrapsAcked) {
+    timer0.IF |= TIMER_IF_OF;
+  }
+}
+
+static void timerAcknowledge(void)
+{
+  // An overflow flag cleared by software stays clear until the next wrap
+  if ((timer0.IF & TIMER_IF_OF) == 0U && model.timerTickPs != 0U) {
+    model.timerWrapsAcked = ((model.now - model.timerStart) / model.timerTickPs) >> 16;
+  }
+}
+
+static void mscCommit(void)
+{
+  foldAliases(&msc, offsetof(MSC_TypeDef, RESERVED12));
+  if (msc.ADDRB != MSC_ADDRB_IDLE) {
+    if (btl_host_flashContains(msc.ADDRB, 4U)) {
+      HW(msc.STATUS) &= ~MSC_STATUS_INVADDR;
+    } else {
+      HW(msc.STATUS) |= MSC_STATUS_INVADDR;
+    }
+    model.mscAddress = msc.ADDRB;
+  }
+  msc.WRITECMD = 0U;
+  HW(msc.STATUS) |= MSC_STATUS_WDATAREADY;
+}
+
+// Shift a byte into the CRC, least significant bit first
+static void gpcrcInput(uint8_t byte)
+{
+  bool crc16 = (gpcrc.CTRL & _GPCRC_CTRL_POLYSEL_MASK) == GPCRC_CTRL_POLYSEL_CRC16;
+  uint32_t poly = crc16 ? (gpcrc.POLY & 0xFFFFU) : GPCRC_CRC32_POLY_REV;
+  uint32_t data = gpcrc.DATA;
+
+  if (gpcrc.CTRL & GPCRC_CTRL_BITREVERSE) {
+    byte = (uint8_t)(btl_host_rbit(byte) >> 24);
+  }
+  data ^= byte;
+  for (unsigned bit = 0; bit < 8U; bit++) {
+    data = (data & 1U) ? ((data >> 1) ^ poly) : (data >> 1);
+  }
+  HW(gpcrc.DATA) = crc16 ? (data & 0xFFFFU) : data;
+}
+
+static void gpcrcCommit(void)
+{
+  foldAliases(&gpcrc, offsetof(GPCRC_TypeDef, RESERVED0));
+  if ((gpcrc.EN & GPCRC_EN_EN) == 0U) {
+    gpcrc.INPUTDATABYTE = GPCRC_INPUT_IDLE;
+    return;
+  }
+  if (gpcrc.CMD & GPCRC_CMD_INIT) {
+    HW(gpcrc.DATA) = gpcrc.INIT;
+    gpcrc.CMD = 0U;
+  }
+  if (gpcrc.INPUTDATABYTE != GPCRC_INPUT_IDLE) {
+    gpcrcInput((uint8_t)gpcrc.INPUTDATABYTE);
+    gpcrc.INPUTDATABYTE = GPCRC_INPUT_IDLE;
+  }
+}
+
+void btl_host_sync(void)
+{
+  gpioCommit();
+  usartCommit();
+  timerCommit();
+  timerAcknowledge();
+  mscCommit();
+  ldmaCommit();
+}
+
+// Commit writes, charge an access, and bring readable state up to date
+static void access(void)
+{
+  btl_host_sync();
+  advanceTo(model.now + (uint64_t)btl_host_timing.accessCycles * BTL_HOST_CYCLE_PS);
+  idleTimerUpdate();
+  timerUpdate();
+  usartCommit();
+}
+
+LDMA_TypeDef *btl_host_ldma(void)
+{
+  access();
+  return &ldma;
+}
+
+TIMER_TypeDef *btl_host_timer0(void)
+{
+  access();
+  return &timer0;
+}
+
+MSC_TypeDef *btl_host_msc(void)
+{
+  access();
+  msc.ADDRB = MSC_ADDRB_IDLE;
+  gpcrc.INPUTDATABYTE = GPCRC_INPUT_IDLE;
+  return &msc;
+}
+
+GPCRC_TypeDef *btl_host_gpcrc(void)
+{
+  // Each write is seen at the next access, which is at the latest the read
+  // of the result
+  gpcrcCommit();
+  return &gpcrc;
+}
+
+DWT_Type *btl_host_dwt(void)
+{
+  dwt.CYCCNT = btl_host_profileClock();
+  return &dwt;
+}
+
+void btl_host_timerStart(uint32_t prescale)
+{
+  model.timerStart = model.now;
+  model.timerTickPs = (uint64_t)prescale * BTL_HOST_CYCLE_PS;
+  model.timerWrapsAcked = 0U;
+  timer0.CNT = 0U;
+  timer0.IF = 0U;
+}
+
+// -----------------------------------------------------------------------------
+// Line
+
+static bool hostMaySend(void)
+{
+  if (!btl_host_line.flowControl || model.rts) {
+    return true;
+  }
+  if (model.ctsBudget > 0U) {
+    model.ctsBudget--;
+    return true;
+  }
+  return false;
+}
+
+static void lineStart(void)
+{
+  if (!model.rxBusy && model.lineCount > 0U && hostMaySend()) {
+    model.rxByte = model.lineQueue[model.lineHead];
+    model.lineHead = (model.lineHead + 1U) % model.lineQueueSize;
+    model.lineCount--;
+    model.rxBusy = true;
+    model.rxLost = nextByteLost();
+    model.rxDone = model.now + BITS_PER_FRAME * bitPs();
+    if (!model.rxLost) {
+      // Receive activity at the start bit
+      idleTimerStop();
+    }
+  }
+  if (!model.txBusy && model.txFifoCount > 0U) {
+    model.txByte = model.txFifo[model.txFifoHead];
+    model.txFifoHead = (model.txFifoHead + 1U) % TX_QUEUE_SIZE;
+    model.txFifoCount--;
+    model.txBusy = true;
+    model.txDone = model.now + BITS_PER_FRAME * bitPs();
+    ldmaService();
+  }
+}
+
+static void rxComplete(void)
+{
+  model.rxBusy = false;
+  if (model.rxLost) {
+    model.stats.bytesLost++;
+    return;
+  }
+  if (model.rxFifoCount < RX_FIFO_DEPTH) {
+    model.rxFifo[model.rxFifoCount++] = model.rxByte;
+    model.stats.bytesToDevice++;
+  } else {
+    model.stats.bytesOverrun++;
+  }
+  idleTimerStart();
+  ldmaService();
+}
+
+static void txComplete(void)
+{
+  model.txBusy = false;
+  model.stats.bytesFromDevice++;
+  if (model.handler.receive != NULL) {
+    model.handler.receive(model.handler.context, model.txByte);
+  }
+}
+
+static void advanceTo(uint64_t target)
+{
+  for (;;) {
+    uint64_t next = NO_EVENT;
+
+    lineStart();
+    if (model.rxBusy && model.rxDone < next) {
+      next = model.rxDone;
+    }
+    if (model.txBusy && model.txDone < next) {
+      next = model.txDone;
+    }
+    if (model.mscWordBusy && model.mscWordDone < next) {
+      next = model.mscWordDone;
+    }
+    if (model.hostTimer != 0U && model.hostTimer < next) {
+      next = model.hostTimer;
+    }
+    if (next > target) {
+      break;
+    }
+    if (next > model.now) {
+      model.now = next;
+    }
+    if (model.rxBusy && model.rxDone <= model.now) {
+      idleTimerUpdate();
+      rxComplete();
+    }
+    if (model.txBusy && model.txDone <= model.now) {
+      txComplete();
+    }
+    if (model.mscWordBusy && model.mscWordDone <= model.now) {
+      mscWordComplete();
+    }
+    if (model.hostTimer != 0U && model.hostTimer <= model.now) {
+      model.hostTimer = 0U;
+      if (model.handler.timer != NULL) {
+        model.handler.timer(model.handler.context);
+      }
+    }
+  }
+  if (target > model.now) {
+    model.now = target;
+  }
+}
+
+// -----------------------------------------------------------------------------
+// Public interface
+
+void btl_host_periphReset(void)
+{
+  static const uint8_t frequencies[] = { 4, 0, 0, 7, 0, 0, 13, 16, 19, 0, 26, 32, 38, 48, 56, 64, 80 };
+  uint32_t freqRange = 8U;
+
+  free(model.lineQueue);
+  memset(&model, 0, sizeof(model));
+  memset(&ldma, 0, sizeof(ldma));
+  memset(&timer0, 0, sizeof(timer0));
+  memset(&msc, 0, sizeof(msc));
+  memset(&gpcrc, 0, sizeof(gpcrc));
+  memset(&btl_host_usart0, 0, sizeof(btl_host_usart0));
+  memset(&btl_host_gpio, 0, sizeof(btl_host_gpio));
+  memset(&btl_host_cmu, 0, sizeof(btl_host_cmu));
+  memset(&btl_host_hfrco0, 0, sizeof(btl_host_hfrco0));
+  memset(&btl_host_ldmaxbar, 0, sizeof(btl_host_ldmaxbar));
+  memset(&dwt, 0, sizeof(dwt));
+  memset(&btl_host_coredebug, 0, sizeof(btl_host_coredebug));
+
+  // Core clock from the HFRCO, at the frequency band matching the timing
+  for (uint32_t i = 0; i < sizeof(frequencies); i++) {
+    if (frequencies[i] != 0U && frequencies[i] * 1000000UL == btl_host_timing.cpuHz) {
+      freqRange = i;
+    }
+  }
+  btl_host_timing.cpuHz = frequencies[freqRange] * 1000000UL;
+  btl_host_hfrco0.CAL = freqRange << _HFRCO_CAL_FREQRANGE_SHIFT;
+  btl_host_cmu.SYSCLKCTRL = CMU_SYSCLKCTRL_CLKSEL_HFRCODPLL;
+
+  btl_host_usart0.TXDATA = USART_TXDATA_IDLE;
+  btl_host_usart0.CLKDIV = _USART_CLKDIV_RESETVALUE;
+  msc.ADDRB = MSC_ADDRB_IDLE;
+
+#if defined(SL_SERIAL_UART_RTS_PORT) && (SL_SERIAL_UART_FLOW_CONTROL == 1)
+  // RTS is deasserted until the driver initializes
+  btl_host_gpio.P[SL_SERIAL_UART_RTS_PORT].DOUT = 1UL << SL_SERIAL_UART_RTS_PIN;
+#endif
+  model.rts = rtsPinAsserted();
+  model.lossState = ((uint64_t)btl_host_line.seed << 1) | 1U;
+  model.lineQueueSize = 4096U;
+  model.lineQueue = malloc(model.lineQueueSize);
+}
+
+uint64_t btl_host_time(void)
+{
+  return model.now;
+}
+
+void btl_host_advance(uint64_t ps)
+{
+  btl_host_sync();
+  advanceTo(model.now + ps);
+  idleTimerUpdate();
+  timerUpdate();
+  usartCommit();
+}
+
+void btl_host_spend(uint64_t cycles)
+{
+  btl_host_advance(cycles * BTL_HOST_CYCLE_PS);
+}
+
+uint32_t btl_host_profileClock(void)
+{
+  if (model.hostProfileClock) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint32_t)((uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec);
+  }
+  return (uint32_t)(model.now / BTL_HOST_CYCLE_PS);
+}
+
+void btl_host_setProfileClock(bool hostTime)
+{
+  model.hostProfileClock = hostTime;
+}
+
+void btl_host_lineSetHandler(const BtlHostLineHandler_t *handler)
+{
+  model.handler = *handler;
+}
+
+void btl_host_lineSend(const uint8_t *data, size_t length)
+{
+  if (model.lineCount + length > model.lineQueueSize) {
+    size_t size = model.lineQueueSize;
+    uint8_t *queue;
+
+    while (model.lineCount + length > size) {
+      size *= 2U;
+    }
+    queue = malloc(size);
+    for (size_t i = 0; i < model.lineCount; i++) {
+      queue[i] = model.lineQueue[(model.lineHead + i) % model.lineQueueSize];
+    }
+    free(model.lineQueue);
+    model.lineQueue = queue;
+    model.lineQueueSize = size;
+    model.lineHead = 0U;
+  }
+  for (size_t i = 0; i < length; i++) {
+    model.lineQueue[(model.lineHead + model.lineCount) % model.lineQueueSize] = data[i];
+    model.lineCount++;
+  }
+}
+
+size_t btl_host_linePending(void)
+{
+  return model.lineCount;
+}
+
+void btl_host_lineDiscard(void)
+{
+  model.lineCount = 0U;
+}
+
+void btl_host_lineSetTimer(uint64_t ps)
+{
+  model.hostTimer = ps;
+}
+
+uint32_t btl_host_lineBaudRate(void)
+{
+  return baudRate();
+}
+
+bool btl_host_lineRts(void)
+{
+  return model.rts;
+}
+
+const BtlHostLineStats_t *btl_host_lineStats(void)
+{
+  if (!model.rts) {
+    // Account for an RTS deassertion still in progress
+    model.stats.rtsDeassertedPs += model.now - model.rtsDeassertedAt;
+    model.rtsDeassertedAt = model.now;
+  }
+  return &model.stats;
+}
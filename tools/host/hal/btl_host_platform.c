@@ -0,0 +1,233 @@
+/***************************************************************************//**
+ * @file
+ * @brief Platform functions of the bootloader on the host: emlib and core
+ *   functions without a register model, the bootloader table, reset, ECDSA
+ *   verification and keys.
+ ******************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <openssl/bn.h>
+#include <openssl/ec.h>
+#include <openssl/ecdsa.h>
+#include <openssl/obj_mac.h>
+#include <openssl/pem.h>
+
+#include "em_device.h"
+#include "em_cmu.h"
+#include "em_gpio.h"
+#include "em_timer.h"
+
+#include "config/btl_config.h"
+#include "api/btl_interface.h"
+#include "core/btl_reset.h"
+#include "security/btl_security_ecdsa.h"
+#include "security/btl_security_tokens.h"
+
+#include "btl_host_internal.h"
+
+// Offset of the GBL decryption key in the lockbits page
+#define DECRYPT_KEY_OFFSET         0x286U
+
+// -----------------------------------------------------------------------------
+// Core and emlib
+
+uint32_t btl_host_rbit(uint32_t value)
+{
+  uint32_t result = 0U;
+
+  for (unsigned i = 0; i < 32U; i++) {
+    result = (result << 1) | (value & 1U);
+    value >>= 1;
+  }
+  return result;
+}
+
+void sli_delay_loop(uint32_t n)
+{
+  // Three cycles per loop on the Cortex-M33
+  btl_host_spend((uint64_t)n * 3U);
+}
+
+void CMU_ClockEnable(CMU_Clock_TypeDef clock, bool enable)
+{
+  // All clocks of the model run
+  (void)clock;
+  (void)enable;
+}
+
+void TIMER_Init(TIMER_TypeDef *timer, const TIMER_Init_TypeDef *init)
+{
+  (void)timer;
+  // The prescaler divides by its value plus one
+  btl_host_timerStart((uint32_t)init->prescale + 1U);
+}
+
+void GPIO_PinModeSet(GPIO_Port_TypeDef port,
+                     unsigned int pin,
+                     GPIO_Mode_TypeDef mode,
+                     unsigned int out)
+{
+  (void)mode;
+  if (out != 0U) {
+    btl_host_gpio.P[port].DOUT |= 1UL << pin;
+  } else {
+    btl_host_gpio.P[port].DOUT &= ~(1UL << pin);
+  }
+}
+
+// -----------------------------------------------------------------------------
+// Bootloader
+
+static MainBootloaderTable_t hostTable = {
+  .header = {
+    .type = BOOTLOADER_MAGIC_MAIN,
+    .layout = BOOTLOADER_HEADER_VERSION_MAIN,
+    .version = BOOTLOADER_VERSION_MAIN
+  },
+};
+
+MainBootloaderTable_t *mainBootloaderTable = &hostTable;
+
+__attribute__((constructor))
+static void hostTableInit(void)
+{
+  hostTable.startOfAppSpace = (BareBootTable_t *)(uintptr_t)(BTL_APPLICATION_BASE);
+  hostTable.endOfAppSpace = (uint32_t *)(uintptr_t)(BTL_APPLICATION_BASE + BTL_APP_SPACE_SIZE);
+}
+
+void reset_resetWithReason(uint16_t resetReason)
+{
+  btl_host_stop(resetReason);
+}
+
+void reset_setResetReason(uint16_t resetReason)
+{
+  (void)resetReason;
+}
+
+int32_t btl_verifyEcdsaP256r1(const uint8_t *sha256,
+                              const uint8_t *signatureR,
+                              const uint8_t *signatureS,
+                              const uint8_t *keyX,
+                              const uint8_t *keyY)
+{
+  int32_t retval = BOOTLOADER_ERROR_SECURITY_REJECTED;
+  EC_KEY *key = EC_KEY_new_by_curve_name(NID_X9_62_prime256v1);
+  ECDSA_SIG *sig = ECDSA_SIG_new();
+  BIGNUM *x = BN_bin2bn(keyX, 32, NULL);
+  BIGNUM *y = BN_bin2bn(keyY, 32, NULL);
+  BIGNUM *r = BN_bin2bn(signatureR, 32, NULL);
+  BIGNUM *s = BN_bin2bn(signatureS, 32, NULL);
+
+  if (key != NULL && sig != NULL
+      && EC_KEY_set_public_key_affine_coordinates(key, x, y) == 1
+      && ECDSA_SIG_set0(sig, r, s) == 1) {
+    r = NULL;
+    s = NULL;
+    if (ECDSA_do_verify(sha256, 32, sig, key) == 1) {
+      retval = BOOTLOADER_OK;
+    }
+  }
+  BN_free(x);
+  BN_free(y);
+  BN_free(r);
+  BN_free(s);
+  ECDSA_SIG_free(sig);
+  EC_KEY_free(key);
+  return retval;
+}
+
+// -----------------------------------------------------------------------------
+// Keys
+
+void btl_host_setSignKey(const uint8_t key[64])
+{
+  btl_host_flashLoad(LOCKBITS_BASE + PUBKEY_OFFSET_X, key, 32U);
+  btl_host_flashLoad(LOCKBITS_BASE + PUBKEY_OFFSET_Y, key + 32, 32U);
+}
+
+void btl_host_setDecryptKey(const uint8_t key[16])
+{
+  btl_host_flashLoad(LOCKBITS_BASE + DECRYPT_KEY_OFFSET, key, 16U);
+}
+
+static int loadSignKey(const char *file)
+{
+  FILE *f = fopen(file, "r");
+  EC_KEY *key;
+  uint8_t point[65];
+
+  if (f == NULL) {
+    perror(file);
+    return -1;
+  }
+  key = PEM_read_ECPrivateKey(f, NULL, NULL, NULL);
+  fclose(f);
+  if (key == NULL
+      || EC_POINT_point2oct(EC_KEY_get0_group(key), EC_KEY_get0_public_key(key),
+                            POINT_CONVERSION_UNCOMPRESSED, point, sizeof(point),
+                            NULL) != sizeof(point)) {
+    fprintf(stderr, "%s: no P-256 private key\n", file);
+    EC_KEY_free(key);
+    return -1;
+  }
+  EC_KEY_free(key);
+  btl_host_setSignKey(point + 1);
+  return 0;
+}
+
+static int loadDecryptKey(const char *file)
+{
+  FILE *f = fopen(file, "r");
+  char line[256];
+  uint8_t key[16];
+
+  if (f == NULL) {
+    perror(file);
+    return -1;
+  }
+  while (fgets(line, sizeof(line), f) != NULL) {
+    const char *hex = strstr(line, "TOKEN_MFG_SECURE_BOOTLOADER_KEY:");
+    if (hex == NULL) {
+      continue;
+    }
+    hex += strlen("TOKEN_MFG_SECURE_BOOTLOADER_KEY:");
+    while (*hex == ' ') {
+      hex++;
+    }
+    for (size_t i = 0; i < sizeof(key); i++) {
+      unsigned int byte;
+      if (sscanf(hex + (2U * i), "%2x", &byte) != 1) {
+        break;
+      }
+      key[i] = (uint8_t)byte;
+      if (i == sizeof(key) - 1U) {
+        fclose(f);
+        btl_host_setDecryptKey(key);
+        return 0;
+      }
+    }
+  }
+  fclose(f);
+  fprintf(stderr, "%s: no TOKEN_MFG_SECURE_BOOTLOADER_KEY\n", file);
+  return -1;
+}
+
+int btl_host_loadKeys(const char *signKeyFile, const char *decryptKeyFile)
+{
+  if (signKeyFile != NULL && loadSignKey(signKeyFile) != 0) {
+    return -1;
+  }
+  if (decryptKeyFile != NULL && loadDecryptKey(decryptKeyFile) != 0) {
+    return -1;
+  }
+  return 0;
+}
+
+void btl_host_reset(void)
+{
+  btl_host_periphReset();
+  btl_host_flashReset();
+}
@@ -0,0 +1,68 @@
+/***************************************************************************//**
+ * @file
+ * @brief Running bootloader code on the host.
+ *
+ * The bootloader keeps addresses of its stack variables in 32-bit
+ * variables, such as the source address of flash writes. Its functions are
+ * therefore run on a stack in the low 4 GB of the address space, and
+ * leaving them on reset returns to the caller of btl_host_run().
+ ******************************************************************************/
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <ucontext.h>
+
+#include "btl_host.h"
+
+#define STACK_SIZE                 (1024U * 1024U)
+
+static ucontext_t hostContext;
+static ucontext_t btlContext;
+static void *stack;
+static void (*runFunction)(void *argument);
+static void *runArgument;
+static int runCode;
+
+void *btl_host_alloc(size_t size)
+{
+  void *memory = mmap(NULL, size, PROT_READ | PROT_WRITE,
+                      MAP_PRIVATE | MAP_ANONYMOUS | MAP_32BIT, -1, 0);
+
+  if (memory == MAP_FAILED) {
+    perror("btl_host: memory below 4 GB");
+    exit(2);
+  }
+  return memory;
+}
+
+static void trampoline(void)
+{
+  runFunction(runArgument);
+  runCode = 0;
+}
+
+int btl_host_run(void (*function)(void *argument), void *argument)
+{
+  if (stack == NULL) {
+    stack = btl_host_alloc(STACK_SIZE);
+  }
+  runFunction = function;
+  runArgument = argument;
+  runCode = 0;
+
+  (void)getcontext(&btlContext);
+  btlContext.uc_stack.ss_sp = stack;
+  btlContext.uc_stack.ss_size = STACK_SIZE;
+  btlContext.uc_link = &hostContext;
+  makecontext(&btlContext, trampoline, 0);
+  (void)swapcontext(&hostContext, &btlContext);
+  return runCode;
+}
+
+void btl_host_stop(int code)
+{
+  runCode = code;
+  (void)setcontext(&hostContext);
+  abort();
+}
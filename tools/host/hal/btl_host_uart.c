@@ -0,0 +1,57 @@
+/***************************************************************************//**
+ * @file
+ * @brief UART driver of the bootloader, built for the host.
+ *
+ * The driver initializes its LDMA descriptors statically with the addresses
+ * of its buffers cast to 32 bits, which is not a constant expression on a
+ * 64-bit host. The descriptors are built without the addresses here, and
+ * the addresses are filled in before the driver runs.
+ ******************************************************************************/
+#include "em_device.h"
+#include "em_ldma.h"
+
+#undef LDMA_DESCRIPTOR_SINGLE_M2P_BYTE
+#define LDMA_DESCRIPTOR_SINGLE_M2P_BYTE(src, dest, count) \
+  {                                                       \
+    .xfer =                                               \
+    {                                                     \
+      .structType   = ldmaCtrlStructTypeXfer,             \
+      .xferCnt      = (count) - 1,                        \
+      .blockSize    = ldmaCtrlBlockSizeUnit1,             \
+      .doneIfs      = 1,                                  \
+      .reqMode      = ldmaCtrlReqModeBlock,               \
+      .srcInc       = ldmaCtrlSrcIncOne,                  \
+      .size         = ldmaCtrlSizeByte,                   \
+      .dstInc       = ldmaCtrlDstIncNone,                 \
+    }                                                     \
+  }
+
+#undef LDMA_DESCRIPTOR_LINKREL_P2M_BYTE
+#define LDMA_DESCRIPTOR_LINKREL_P2M_BYTE(src, dest, count, linkjmp)    \
+  {                                                                    \
+    .xfer =                                                            \
+    {                                                                  \
+      .structType   = ldmaCtrlStructTypeXfer,                          \
+      .xferCnt      = (count) - 1,                                     \
+      .blockSize    = ldmaCtrlBlockSizeUnit1,                          \
+      .doneIfs      = 1,                                               \
+      .reqMode      = ldmaCtrlReqModeBlock,                            \
+      .srcInc       = ldmaCtrlSrcIncNone,                              \
+      .size         = ldmaCtrlSizeByte,                                \
+      .dstInc       = ldmaCtrlDstIncOne,                               \
+      .linkMode     = ldmaLinkModeRel,                                 \
+      .link         = 1,                                               \
+      .linkAddr     = (linkjmp) * LDMA_DESCRIPTOR_NON_EXTEND_SIZE_WORD \
+    }                                                                  \
+  }
+
+#include "driver/btl_driver_uart.c"
+
+__attribute__((constructor))
+static void btl_host_uartDescriptors(void)
+{
+  ldmaTxDesc.xfer.srcAddr = (uint32_t)(uintptr_t)txBuffer;
+  ldmaRxDesc[0].xfer.dstAddr = (uint32_t)(uintptr_t)&rxBuffer[0];
+  ldmaRxDesc[2].xfer.dstAddr
+    = (uint32_t)(uintptr_t)&rxBuffer[SL_DRIVER_UART_RX_BUFFER_SIZE / 2];
+}
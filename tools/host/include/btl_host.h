@@ -0,0 +1,163 @@
+/***************************************************************************//**
+ * @file
+ * @brief Host platform of the bootloader: virtual time, flash and serial
+ *   line models, and running bootloader code.
+ *
+ * The bootloader runs unmodified against register blocks in host memory. A
+ * virtual clock advances with each peripheral access, with flash operations
+ * and with the processing cost charged by the test programs. Serial data,
+ * flash latencies, timers and the LDMA are evaluated against that clock, so
+ * that throughput and timeout behaviour can be measured deterministically.
+ ******************************************************************************/
+#ifndef BTL_HOST_H
+#define BTL_HOST_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// -----------------------------------------------------------------------------
+// Virtual time
+
+/// Picoseconds per second
+#define BTL_HOST_PS_PER_S          1000000000000ULL
+
+/// Timing of the modelled target
+typedef struct {
+  uint32_t cpuHz;                  ///< Core clock frequency
+  uint32_t accessCycles;           ///< Cycles charged per peripheral access
+  uint32_t pageEraseUs;            ///< Flash page erase time
+  uint32_t wordWriteNs;            ///< Flash word write time
+} BtlHostTiming_t;
+
+/// Timing of the modelled target, to be set before btl_host_reset()
+extern BtlHostTiming_t btl_host_timing;
+
+/// Reset the virtual time and the peripheral, flash and line models
+void btl_host_reset(void);
+
+/// Virtual time in picoseconds
+uint64_t btl_host_time(void);
+
+/// Advance the virtual time, letting the models run
+void btl_host_advance(uint64_t ps);
+
+/// Charge a number of core clock cycles to the virtual time
+void btl_host_spend(uint64_t cycles);
+
+/// Profiling time base; see btl_host_setProfileClock()
+uint32_t btl_host_profileClock(void);
+
+/// Count virtual core clock cycles (default), or host nanoseconds when
+/// measuring the host implementation
+void btl_host_setProfileClock(bool hostTime);
+
+// -----------------------------------------------------------------------------
+// Flash
+
+/// Flash statistics
+typedef struct {
+  uint32_t pageErases;             ///< Pages erased
+  uint32_t wordWrites;             ///< Words programmed
+  uint32_t badWrites;              ///< Words programmed that were not erased
+} BtlHostFlashStats_t;
+
+/// Erase all of flash, without charging time
+void btl_host_flashErase(void);
+
+/// Store data in flash directly, without charging time
+void btl_host_flashLoad(uint32_t address, const void *data, size_t length);
+
+/// Flash statistics since btl_host_reset()
+const BtlHostFlashStats_t *btl_host_flashStats(void);
+
+// -----------------------------------------------------------------------------
+// Serial line between the host and the bootloader UART
+
+/// Serial line parameters
+typedef struct {
+  uint32_t lossPpm;                ///< Bytes to the device lost, per million
+  uint32_t seed;                   ///< Seed of the loss pattern
+  uint32_t ctsLagBytes;            ///< Bytes sent after RTS is deasserted
+  bool     flowControl;            ///< Host honours RTS of the device
+} BtlHostLine_t;
+
+/// Serial line statistics
+typedef struct {
+  uint64_t bytesToDevice;          ///< Bytes the device received
+  uint64_t bytesLost;              ///< Bytes lost on the line
+  uint64_t bytesOverrun;           ///< Bytes lost in a full receive FIFO
+  uint64_t bytesFromDevice;        ///< Bytes the host received
+  uint32_t rtsDeassertions;        ///< Times RTS was deasserted
+  uint64_t rtsDeassertedPs;        ///< Time RTS was deasserted
+} BtlHostLineStats_t;
+
+/// Handlers of the host side of the line
+typedef struct {
+  /// A byte from the device was received
+  void (*receive)(void *context, uint8_t byte);
+  /// The timer set with btl_host_lineSetTimer() expired
+  void (*timer)(void *context);
+  void *context;
+} BtlHostLineHandler_t;
+
+/// Serial line parameters, to be set before btl_host_reset()
+extern BtlHostLine_t btl_host_line;
+
+/// Set the handlers of the host side of the line
+void btl_host_lineSetHandler(const BtlHostLineHandler_t *handler);
+
+/// Queue data for the host to send to the device
+void btl_host_lineSend(const uint8_t *data, size_t length);
+
+/// Number of bytes queued for sending to the device
+size_t btl_host_linePending(void);
+
+/// Drop the data queued for sending to the device
+void btl_host_lineDiscard(void);
+
+/// Call the timer handler at a virtual time, 0 to cancel
+void btl_host_lineSetTimer(uint64_t ps);
+
+/// Baud rate the device UART is set to
+uint32_t btl_host_lineBaudRate(void);
+
+/// Whether RTS of the device allows the host to send
+bool btl_host_lineRts(void);
+
+/// Serial line statistics since btl_host_reset()
+const BtlHostLineStats_t *btl_host_lineStats(void);
+
+// -----------------------------------------------------------------------------
+// Running bootloader code
+
+/// Run a function on a stack addressable with 32 bits, as on the target.
+/// Returns 0 when the function returns, or the code passed to
+/// btl_host_stop().
+int btl_host_run(void (*function)(void *argument), void *argument);
+
+/// Leave the function started with btl_host_run()
+void btl_host_stop(int code) __attribute__((noreturn));
+
+/// Allocate memory addressable with 32 bits, as on the target
+void *btl_host_alloc(size_t size);
+
+/// Set the key used to verify signed GBL files, as X and Y coordinates
+void btl_host_setSignKey(const uint8_t key[64]);
+
+/// Set the key used to decrypt GBL files
+void btl_host_setDecryptKey(const uint8_t key[16]);
+
+/// Read the signing and decryption keys from the key files of the repository
+/// (PEM encoded private key, and commander token file). Either may be NULL.
+int btl_host_loadKeys(const char *signKeyFile, const char *decryptKeyFile);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // BTL_HOST_H
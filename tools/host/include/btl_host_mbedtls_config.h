@@ -0,0 +1,13 @@
+/***************************************************************************//**
+ * @file
+ * @brief Mbed TLS configuration for the host build of the bootloader.
+ *
+ * Only the software AES the bootloader uses for GBL decryption is built.
+ ******************************************************************************/
+#ifndef BTL_HOST_MBEDTLS_CONFIG_H
+#define BTL_HOST_MBEDTLS_CONFIG_H
+
+#define MBEDTLS_AES_C
+#define MBEDTLS_CIPHER_MODE_CTR
+
+#endif // BTL_HOST_MBEDTLS_CONFIG_H
@@ -0,0 +1,111 @@
+/***************************************************************************//**
+ * @file
+ * @brief Device header for building the bootloader on a Linux host.
+ *
+ * Wraps the EFR32ZG23 device header. The peripherals the bootloader drives
+ * are redirected to register blocks in host memory, which the peripheral
+ * model in hal/btl_host_periph.c brings to life. Hardware accelerators
+ * without a model are hidden, so that the software fallbacks of the
+ * bootloader are built instead.
+ ******************************************************************************/
+#ifndef BTL_HOST_EM_DEVICE_H
+#define BTL_HOST_EM_DEVICE_H
+
+// CMSIS intrinsics using Arm instructions; replaced below
+#define __disable_irq   btl_host_cmsis_disable_irq
+#define __enable_irq    btl_host_cmsis_enable_irq
+#define __DSB           btl_host_cmsis_dsb
+#define __ISB           btl_host_cmsis_isb
+#define __DMB           btl_host_cmsis_dmb
+#define __get_PRIMASK   btl_host_cmsis_get_primask
+#define __set_PRIMASK   btl_host_cmsis_set_primask
+#define __RBIT          btl_host_cmsis_rbit
+
+#include_next "em_device.h"
+
+#undef __disable_irq
+#undef __enable_irq
+#undef __DSB
+#undef __ISB
+#undef __DMB
+#undef __NOP
+#undef __get_PRIMASK
+#undef __set_PRIMASK
+#undef __RBIT
+#define __disable_irq()       do {} while (0)
+#define __enable_irq()        do {} while (0)
+#define __DSB()               do {} while (0)
+#define __ISB()               do {} while (0)
+#define __DMB()               do {} while (0)
+#define __NOP()               do {} while (0)
+#define __get_PRIMASK()       (0U)
+#define __set_PRIMASK(x)      ((void)(x))
+#define __RBIT(x)             btl_host_rbit(x)
+
+// No model of the hardware accelerators; use the software implementations.
+// The GPCRC model only takes byte input, which suffices for the CRC16 engine;
+// it is used where BTL_HOST_GPCRC is defined.
+#undef SEMAILBOX_PRESENT
+#undef CRYPTOACC_PRESENT
+#if !defined(BTL_HOST_GPCRC)
+#undef GPCRC_PRESENT
+#endif
+
+// Without the SE, the signing and decryption keys are read from the topmost
+// flash page, as on devices without an SE
+#define LOCKBITS_BASE       ((FLASH_BASE) + (FLASH_SIZE) - (FLASH_PAGE_SIZE))
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+uint32_t btl_host_rbit(uint32_t value);
+
+// Register blocks in host memory, including the SET/CLR/TGL aliases
+extern USART_TypeDef    btl_host_usart0;
+extern GPIO_TypeDef     btl_host_gpio;
+extern CMU_TypeDef      btl_host_cmu;
+extern HFRCO_TypeDef    btl_host_hfrco0;
+extern LDMAXBAR_TypeDef btl_host_ldmaxbar;
+extern CoreDebug_Type   btl_host_coredebug;
+
+// Accessors of the modelled peripherals. Each access lets the model catch up
+// with register writes since the previous access and advances the virtual
+// time by the cost of a peripheral access.
+LDMA_TypeDef  *btl_host_ldma(void);
+TIMER_TypeDef *btl_host_timer0(void);
+MSC_TypeDef   *btl_host_msc(void);
+GPCRC_TypeDef *btl_host_gpcrc(void);
+
+// The cycle counter of the DWT counts the profiling clock of the model; see
+// btl_host_setProfileClock()
+DWT_Type      *btl_host_dwt(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#undef USART0
+#undef GPIO
+#undef CMU
+#undef HFRCO0
+#undef LDMAXBAR
+#undef LDMA
+#undef TIMER0
+#undef MSC
+#undef GPCRC
+#undef DWT
+#undef CoreDebug
+#define USART0              (&btl_host_usart0)
+#define GPIO                (&btl_host_gpio)
+#define CMU                 (&btl_host_cmu)
+#define HFRCO0              (&btl_host_hfrco0)
+#define LDMAXBAR            (&btl_host_ldmaxbar)
+#define DWT                 (btl_host_dwt())
+#define CoreDebug           (&btl_host_coredebug)
+#define LDMA                (btl_host_ldma())
+#define TIMER0              (btl_host_timer0())
+#define MSC                 (btl_host_msc())
+#define GPCRC               (btl_host_gpcrc())
+
+#endif // BTL_HOST_EM_DEVICE_H
@@ -0,0 +1,195 @@
+/***************************************************************************//**
+ * @file
+ * @brief Conformance check and benchmark of the CRC16 engines.
+ *
+ * security/btl_crc16.c is built once per engine of BTL_CRC16_ENGINE, with
+ * btl_crc16Stream() renamed after the engine (see CMakeLists.txt); the
+ * GPCRC engine runs on the GPCRC model. Each engine is checked against a
+ * bit-serial reference: the XMODEM and CCITT-FALSE check values of
+ * "123456789", and pseudo-random buffers at all alignments, split into
+ * pseudo-random pieces.
+ *
+ * With --bench, each software engine computes the CRC of 1 KiB packets as
+ * XMODEM-1K does, and the throughput on the host is written as one JSON
+ * object per line. Throughput on the target is in the xmodem_crc stage of
+ * the profile menu. The GPCRC engine is not timed, as the host only runs a
+ * model of it.
+ *
+ *   crc16_check [--bench] [--repeat N]
+ ******************************************************************************/
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "btl_host.h"
+
+#include "security/btl_crc16.h"
+
+#define PACKET_SIZE                1024U
+#define BENCH_BYTES                (16U * 1024U * 1024U)
+
+typedef uint16_t (*Crc16Stream_t)(const uint8_t *buffer, size_t length,
+                                  uint16_t prevResult);
+
+uint16_t btl_crc16Stream_bitwise(const uint8_t *buffer, size_t length,
+                                 uint16_t prevResult);
+uint16_t btl_crc16Stream_table(const uint8_t *buffer, size_t length,
+                               uint16_t prevResult);
+uint16_t btl_crc16Stream_slice_by_4(const uint8_t *buffer, size_t length,
+                                    uint16_t prevResult);
+uint16_t btl_crc16Stream_gpcrc(const uint8_t *buffer, size_t length,
+                               uint16_t prevResult);
+
+static const struct {
+  const char    *name;
+  Crc16Stream_t stream;
+  unsigned      tableBytes;
+  bool          timed;
+} engines[] = {
+  { "bitwise",    btl_crc16Stream_bitwise,    0U,    true  },
+  { "table",      btl_crc16Stream_table,      512U,  true  },
+  { "slice_by_4", btl_crc16Stream_slice_by_4, 2048U, true  },
+  { "gpcrc",      btl_crc16Stream_gpcrc,      0U,    false },
+};
+
+#define ENGINE_COUNT               (sizeof(engines) / sizeof(engines[0]))
+
+// CRC16-CCITT, most significant bit first
+static uint16_t reference(const uint8_t *data, size_t length, uint16_t crc)
+{
+  for (size_t i = 0; i < length; i++) {
+    crc ^= (uint16_t)data[i] << 8;
+    for (unsigned bit = 0; bit < 8U; bit++) {
+      crc = (crc & 0x8000U) ? (uint16_t)((crc << 1) ^ BTL_CRC16_POLY)
+            : (uint16_t)(crc << 1);
+    }
+  }
+  return crc;
+}
+
+static uint32_t nextRandom(uint32_t *state)
+{
+  *state ^= *state << 13;
+  *state ^= *state >> 17;
+  *state ^= *state << 5;
+  return *state;
+}
+
+static bool checkValue(unsigned e, const char *what, uint16_t got,
+                       uint16_t expected)
+{
+  if (got != expected) {
+    fprintf(stderr, "%s: %s is 0x%04x, expected 0x%04x\n", engines[e].name,
+            what, (unsigned)got, (unsigned)expected);
+    return false;
+  }
+  return true;
+}
+
+static bool check(unsigned e)
+{
+  static const uint8_t checkString[] = "123456789";
+  static uint8_t data[4U + 2U * PACKET_SIZE];
+  Crc16Stream_t stream = engines[e].stream;
+  uint32_t state = 1U;
+
+  if (!checkValue(e, "XMODEM check value",
+                  stream(checkString, 9U, 0x0000U), 0x31C3U)
+      || !checkValue(e, "CCITT-FALSE check value",
+                     stream(checkString, 9U, BTL_CRC16_START), 0x29B1U)
+      || !checkValue(e, "CRC of nothing", stream(checkString, 0U, 0x1234U),
+                     0x1234U)) {
+    return false;
+  }
+
+  for (size_t i = 0; i < sizeof(data); i++) {
+    data[i] = (uint8_t)nextRandom(&state);
+  }
+  for (unsigned run = 0; run < 2000U; run++) {
+    size_t offset = nextRandom(&state) % 4U;
+    size_t length = nextRandom(&state) % (2U * PACKET_SIZE);
+    uint16_t start = (uint16_t)nextRandom(&state);
+    uint16_t crc = start;
+
+    // Split into pieces, as when a packet is checked in parts
+    for (size_t done = 0; done < length; ) {
+      size_t piece = 1U + (nextRandom(&state) % (length - done));
+      crc = stream(&data[offset + done], piece, crc);
+      done += piece;
+    }
+    if (crc != reference(&data[offset], length, start)) {
+      fprintf(stderr, "%s: CRC of %zu bytes at offset %zu is wrong\n",
+              engines[e].name, length, offset);
+      return false;
+    }
+  }
+  return true;
+}
+
+static uint64_t hostNs(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+static void bench(unsigned e, unsigned repeat)
+{
+  static uint8_t packet[PACKET_SIZE];
+  uint64_t bestNs = UINT64_MAX;
+  volatile uint16_t sink = 0U;
+
+  for (size_t i = 0; i < sizeof(packet); i++) {
+    packet[i] = (uint8_t)(i * 31U);
+  }
+  for (unsigned run = 0; run < repeat; run++) {
+    uint64_t start = hostNs();
+    uint64_t ns;
+
+    for (size_t done = 0; done < BENCH_BYTES; done += PACKET_SIZE) {
+      sink ^= engines[e].stream(packet, PACKET_SIZE, 0x0000U);
+    }
+    ns = hostNs() - start;
+    if (ns < bestNs) {
+      bestNs = ns;
+    }
+  }
+  (void)sink;
+  printf("{\"engine\": \"%s\", \"table_bytes\": %u, \"packet\": %u, "
+         "\"ns_per_byte\": %.3f, \"bytes_per_s\": %.0f}\n",
+         engines[e].name, engines[e].tableBytes, PACKET_SIZE,
+         (double)bestNs / BENCH_BYTES, (double)BENCH_BYTES * 1e9 / bestNs);
+}
+
+int main(int argc, char **argv)
+{
+  bool benchmark = false;
+  unsigned repeat = 5U;
+  int status = 0;
+
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--bench") == 0) {
+      benchmark = true;
+    } else if (strcmp(argv[i], "--repeat") == 0 && i + 1 < argc) {
+      repeat = (unsigned)strtoul(argv[++i], NULL, 0);
+    } else {
+      fprintf(stderr, "usage: crc16_check [--bench] [--repeat N]\n");
+      return 2;
+    }
+  }
+
+  btl_host_reset();
+  for (unsigned e = 0; e < ENGINE_COUNT; e++) {
+    if (!check(e)) {
+      status = 1;
+    } else if (benchmark && engines[e].timed) {
+      bench(e, repeat);
+    } else if (!benchmark) {
+      printf("%s: OK\n", engines[e].name);
+    }
+  }
+  return status;
+}
@@ -0,0 +1,107 @@
+#!/usr/bin/env python3
+"""Compare the LZ4 and LZMA decompressors: decode throughput and RAM.
+
+Runs gbl_bench on compressed GBL files, and takes the time spent in the
+decoder from its lz4_decode and lzma_decode profiling stages, which cover
+the decoder calls only, not the flash writes of the decoded data. The
+static RAM of each decompressor is the size of the .bss and .data symbols
+of its modules in the bootloader library, as listed by nm. Pointers are 8
+bytes on the host, so the state structures are slightly larger than on the
+target; the buffers and LZMA tables dominate and are the same size.
+
+The time of the parse outside the top-level profiling stages (CRC32, the
+copies of the GBL parser, SHA-256, AES, decoding and the flash callback) is
+reported as other_ns:
+the GBL parser itself and the staging of decoder input and output. The
+time of the flash callback, which copies into the flash page buffer when
+it is enabled, is reported as flash_ns.
+
+One JSON object is written per line for each image and chunk size given:
+
+  decompress_bench.py [--nm NM] --library LIB [--chunk N,...] [--repeat N]
+                      NAME=FILE.gbl... -- GBL_BENCH [OPTION...]
+
+Decode cycles on the target are in the same stages of the profile menu.
+"""
+
+import argparse
+import json
+import subprocess
+import sys
+
+# Profiling stages that don't nest in other stages
+TOP_STAGES = ['gbl_crc32', 'gbl_copy', 'sha_update', 'aes_ctr',
+              'lzma_decode', 'lz4_decode', 'flash_callback']
+
+# Modules of each decompressor, as object files in the library
+DECODERS = {
+    'lz4_decode': ('lz4', ['btl_decompress_lz4.c.o']),
+    'lzma_decode': ('lzma', ['btl_decompress_lzma.c.o', 'LzmaDec.c.o']),
+}
+
+
+def static_ram(nm, library):
+    """Bytes of .bss and .data per object file of the library."""
+    out = subprocess.run([nm, '-S', '--defined-only', library], check=True,
+                         capture_output=True, text=True).stdout
+    ram = {}
+    member = None
+    for line in out.splitlines():
+        if line.endswith(':'):
+            member = line[:-1]
+            continue
+        fields = line.split()
+        if member is None or len(fields) != 4 or fields[2] not in 'bBdD':
+            continue
+        ram[member] = ram.get(member, 0) + int(fields[1], 16)
+    return ram
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument('--nm', default='nm')
+    parser.add_argument('--library', required=True,
+                        help='bootloader library gbl_bench is linked to')
+    parser.add_argument('--chunk', default='1024',
+                        help='chunk sizes, as for gbl_bench')
+    parser.add_argument('--repeat', default='5')
+    parser.add_argument('images', nargs='+', metavar='NAME=FILE.gbl')
+    argv = sys.argv[1:]
+    if '--' not in argv:
+        parser.error('missing -- GBL_BENCH [OPTION...]')
+    split = argv.index('--')
+    args = parser.parse_args(argv[:split])
+    gbl_bench = argv[split + 1:]
+
+    ram = static_ram(args.nm, args.library)
+    result = subprocess.run(gbl_bench
+                            + ['--chunk', args.chunk, '--repeat', args.repeat]
+                            + args.images,
+                            check=True, capture_output=True, text=True)
+    for line in result.stdout.splitlines():
+        run = json.loads(line)
+        for stage, (decoder, modules) in DECODERS.items():
+            if stage not in run['stages']:
+                continue
+            decode = run['stages'][stage]
+            other = run['ns'] - sum(run['stages'][s]['ns'] for s in TOP_STAGES
+                                    if s in run['stages'])
+            print(json.dumps({
+                'image': run['image'],
+                'decoder': decoder,
+                'chunk': run['chunk'],
+                'gbl_bytes': run['gbl_bytes'],
+                'decoded_bytes': decode['bytes'],
+                'ratio': round(run['gbl_bytes'] / decode['bytes'], 3),
+                'decode_ns': decode['ns'],
+                'decode_mb_per_s': round(decode['bytes_per_s'] / 1e6, 1),
+                'parse_mb_per_s': round(run['bytes_per_s'] / 1e6, 1),
+                'other_ns': other,
+                'flash_ns': run['stages'].get('flash_callback', {}).get('ns', 0),
+                'static_ram_bytes': sum(ram.get(m, 0) for m in modules),
+            }))
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
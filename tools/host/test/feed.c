@@ -0,0 +1,136 @@
+/***************************************************************************//**
+ * @file
+ * @brief Feeding GBL files through the image parser of the bootloader.
+ *
+ * Parses a file in chunks of a fixed or random size, the way the
+ * communication interfaces pass received packets, with the application and
+ * bootloader callbacks of the bootloader writing to the flash model.
+ ******************************************************************************/
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "btl_host.h"
+#include "feed.h"
+
+#include "api/btl_errorcode.h"
+#include "core/btl_bootload.h"
+#include "parser/gbl/btl_gbl_parser.h"
+
+// Largest random chunk, the size of the XMODEM receive buffer in 1K mode
+#define RANDOM_CHUNK_MAX           4096U
+
+static const BootloaderParserCallbacks_t parseCb = {
+  .context = NULL,
+  .applicationCallback = bootload_applicationCallback,
+  .metadataCallback = NULL,
+  .bootloaderCallback = bootload_bootloaderCallback
+};
+
+static ParserContext_t  parserContext;
+static DecryptContext_t decryptContext;
+static AuthContext_t    authContext;
+
+// Packets are parsed from a receive buffer, which the parser may modify
+static uint8_t *packet;
+static size_t  packetSize;
+
+uint8_t *feed_readFile(const char *name, size_t *length)
+{
+  FILE *f = fopen(name, "rb");
+  uint8_t *data;
+  long size;
+
+  if (f == NULL) {
+    perror(name);
+    exit(2);
+  }
+  fseek(f, 0, SEEK_END);
+  size = ftell(f);
+  fseek(f, 0, SEEK_SET);
+  data = btl_host_alloc((size_t)size + 1U);
+  if (fread(data, 1, (size_t)size, f) != (size_t)size) {
+    perror(name);
+    exit(2);
+  }
+  fclose(f);
+  *length = (size_t)size;
+  return data;
+}
+
+static uint32_t nextRandom(uint32_t *state)
+{
+  *state ^= *state << 13;
+  *state ^= *state >> 17;
+  *state ^= *state << 5;
+  return *state;
+}
+
+// Runs on the bootloader stack
+static void feed(void *argument)
+{
+  Feed_t *f = (Feed_t *)argument;
+  uint32_t random = f->seed | 1U;
+  size_t offset = 0;
+  int32_t ret;
+
+  memset(&f->imageProps, 0, sizeof(f->imageProps));
+  ret = parser_init(&parserContext, &decryptContext, &authContext, f->flags);
+  while (ret == BOOTLOADER_OK && offset < f->gblLength) {
+    size_t length = f->chunk;
+
+    if (length == 0U) {
+      length = 1U + (nextRandom(&random) % RANDOM_CHUNK_MAX);
+    }
+    if (length > f->gblLength - offset) {
+      length = f->gblLength - offset;
+    }
+    memcpy(packet, &f->gbl[offset], length);
+    ret = parser_parse(&parserContext, &f->imageProps, packet, length, &parseCb);
+    offset += length;
+  }
+  bootload_flushFlashWrites();
+  f->result = ret;
+}
+
+int feed_run(Feed_t *f)
+{
+  if (packetSize < f->gblLength) {
+    packetSize = f->gblLength;
+    packet = btl_host_alloc(packetSize);
+  }
+  return btl_host_run(feed, f);
+}
+
+bool feed_check(const Feed_t *f, const char *name,
+                const uint8_t *expect, size_t expectLength, uint32_t address)
+{
+  // The parser returns EOF for data after the end tag only
+  if (f->result != BOOTLOADER_OK && f->result != BOOTLOADER_ERROR_PARSER_EOF) {
+    fprintf(stderr, "%s: parser returned 0x%04x\n", name, (unsigned)f->result);
+    return false;
+  }
+  if (!f->imageProps.imageCompleted || !f->imageProps.imageVerified) {
+    fprintf(stderr, "%s: image %s\n", name,
+            f->imageProps.imageCompleted ? "not verified" : "incomplete");
+    return false;
+  }
+  for (size_t i = 0; i < expectLength; i++) {
+    if (((const uint8_t *)(uintptr_t)address)[i] != expect[i]) {
+      fprintf(stderr, "%s: flash differs at 0x%08zx\n", name, address + i);
+      return false;
+    }
+  }
+  if (btl_host_flashStats()->badWrites != 0U) {
+    fprintf(stderr, "%s: %u words programmed without erase\n", name,
+            (unsigned)btl_host_flashStats()->badWrites);
+    return false;
+  }
+  return true;
+}
+
+size_t feed_parseChunk(const char *arg)
+{
+  return (strcmp(arg, "random") == 0) ? 0U : strtoul(arg, NULL, 0);
+}
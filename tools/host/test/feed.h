@@ -0,0 +1,40 @@
+/***************************************************************************//**
+ * @file
+ * @brief Feeding GBL files through the image parser of the bootloader.
+ ******************************************************************************/
+#ifndef FEED_H
+#define FEED_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "parser/gbl/btl_gbl_parser.h"
+
+/// A GBL file and how it is passed to the parser
+typedef struct {
+  const uint8_t *gbl;              ///< GBL file, below 4 GB
+  size_t   gblLength;              ///< Length of the GBL file
+  size_t   chunk;                  ///< Bytes per parser call, 0 for random
+  uint32_t seed;                   ///< Seed of the random chunk sizes
+  uint8_t  flags;                  ///< Parser flags
+  int32_t  result;                 ///< Return value of the last parser call
+  ImageProperties_t imageProps;    ///< Image properties after parsing
+} Feed_t;
+
+/// Read a file into memory below 4 GB, exit on failure
+uint8_t *feed_readFile(const char *name, size_t *length);
+
+/// Parse the GBL file of a feed on the bootloader stack and flush the
+/// flash writes. Returns the return code of btl_host_run().
+int feed_run(Feed_t *feed);
+
+/// Check the result of a feed, and that flash holds the expected image if
+/// one is given. Prints the reason and returns false on failure.
+bool feed_check(const Feed_t *feed, const char *name,
+                const uint8_t *expect, size_t expectLength, uint32_t address);
+
+/// Parse a chunk size option: a number, or "random"
+size_t feed_parseChunk(const char *arg);
+
+#endif // FEED_H
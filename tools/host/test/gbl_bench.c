@@ -0,0 +1,206 @@
+/***************************************************************************//**
+ * @file
+ * @brief Benchmark of the bootloader image processing path on the host.
+ *
+ * Feeds each GBL file given through the image parser with each chunk size,
+ * parsing in place (PARSER_FLAG_IN_PLACE) or copying through the internal
+ * buffer of the parser, and writes one JSON object per line with the throughput and the time
+ * spent per profiling stage (SL_DEBUG_PROFILE). Times are host nanoseconds,
+ * the best of a number of runs. Flash latency of the target is not part of
+ * the measured time; virtual_us is the time the peripheral models of the
+ * target took, mostly flash erase and write latency.
+ *
+ *   gbl_bench [--chunk 128,1024,4096,random] [--in-place yes,no]
+ *             [--repeat N] [--sign KEY] [--key TOKENS]
+ *             [--expect BIN --address ADDR] NAME=FILE.gbl...
+ ******************************************************************************/
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "btl_host.h"
+#include "feed.h"
+
+#include "debug/btl_debug.h"
+#include "parser/gbl/btl_gbl_parser.h"
+
+#define MAX_CHUNKS                 16U
+
+static const char * const stageNames[BTL_PROFILE_STAGE_COUNT] = {
+  [BTL_PROFILE_STAGE_UART_WAIT]      = "uart_wait",
+  [BTL_PROFILE_STAGE_XMODEM_CRC]     = "xmodem_crc",
+  [BTL_PROFILE_STAGE_GBL_CRC32]      = "gbl_crc32",
+  [BTL_PROFILE_STAGE_GBL_COPY]       = "gbl_copy",
+  [BTL_PROFILE_STAGE_SHA_UPDATE]     = "sha_update",
+  [BTL_PROFILE_STAGE_AES_CTR]        = "aes_ctr",
+  [BTL_PROFILE_STAGE_LZMA_DECODE]    = "lzma_decode",
+  [BTL_PROFILE_STAGE_LZ4_DECODE]     = "lz4_decode",
+  [BTL_PROFILE_STAGE_FLASH_CALLBACK] = "flash_callback",
+  [BTL_PROFILE_STAGE_PAGE_ERASE]     = "page_erase",
+  [BTL_PROFILE_STAGE_WORD_WRITE]     = "word_write",
+};
+
+typedef struct {
+  const char *signKey;
+  const char *decryptKey;
+  const uint8_t *expect;
+  size_t   expectLength;
+  uint32_t address;
+  unsigned repeat;
+} Bench_t;
+
+static uint64_t hostNs(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+static double perSecond(uint64_t bytes, uint64_t ns)
+{
+  return (ns == 0U) ? 0.0 : (double)bytes * 1e9 / (double)ns;
+}
+
+// Run one image with one chunk size, printing the best of the runs
+static bool bench(const Bench_t *b, const char *name, const char *file,
+                  Feed_t *f)
+{
+  BtlProfileStats_t stages[BTL_PROFILE_STAGE_COUNT];
+  uint64_t bestNs = UINT64_MAX;
+  uint64_t virtualPs = 0U;
+
+  for (unsigned run = 0; run < b->repeat; run++) {
+    uint64_t start;
+    uint64_t ns;
+
+    btl_host_reset();
+    btl_host_flashErase();
+    if (btl_host_loadKeys(b->signKey, b->decryptKey) != 0) {
+      exit(2);
+    }
+    btl_host_setProfileClock(true);
+
+    start = hostNs();
+    if (feed_run(f) != 0) {
+      fprintf(stderr, "%s: bootloader reset\n", file);
+      return false;
+    }
+    ns = hostNs() - start;
+    if (!feed_check(f, file, b->expect, b->expectLength, b->address)) {
+      return false;
+    }
+    if (ns < bestNs) {
+      bestNs = ns;
+      virtualPs = btl_host_time();
+      for (unsigned i = 0; i < BTL_PROFILE_STAGE_COUNT; i++) {
+        stages[i] = *btl_profileGetStats((BtlProfileStage_t)i);
+      }
+    }
+  }
+
+  printf("{\"image\": \"%s\", \"chunk\": ", name);
+  if (f->chunk == 0U) {
+    printf("\"random\"");
+  } else {
+    printf("%zu", f->chunk);
+  }
+  printf(", \"in_place\": %s, \"gbl_bytes\": %zu, \"ns\": %llu, "
+         "\"bytes_per_s\": %.0f, \"virtual_us\": %llu, \"stages\": {",
+         (f->flags & PARSER_FLAG_IN_PLACE) ? "true" : "false",
+         f->gblLength, (unsigned long long)bestNs,
+         perSecond(f->gblLength, bestNs),
+         (unsigned long long)(virtualPs / 1000000ULL));
+  for (unsigned i = 0, printed = 0; i < BTL_PROFILE_STAGE_COUNT; i++) {
+    if (stages[i].calls == 0U) {
+      continue;
+    }
+    printf("%s\"%s\": {\"calls\": %u, \"bytes\": %u, \"ns\": %llu, "
+           "\"bytes_per_s\": %.0f}",
+           (printed++ == 0U) ? "" : ", ", stageNames[i],
+           (unsigned)stages[i].calls, (unsigned)stages[i].bytes,
+           (unsigned long long)stages[i].cycles,
+           perSecond(stages[i].bytes, stages[i].cycles));
+  }
+  printf("}}\n");
+  fflush(stdout);
+  return true;
+}
+
+static int usage(void)
+{
+  fprintf(stderr,
+          "usage: gbl_bench [--chunk 128,1024,4096,random] "
+          "[--in-place yes,no] [--repeat N] [--sign KEY] [--key TOKENS] "
+          "[--expect BIN --address ADDR] NAME=FILE.gbl...\n");
+  return 2;
+}
+
+int main(int argc, char **argv)
+{
+  Bench_t b = { .address = 0x08006000UL, .repeat = 5U };
+  size_t chunks[MAX_CHUNKS] = { 128U, 1024U, 4096U, 0U };
+  size_t chunkCount = 4U;
+  uint8_t flags[2] = { PARSER_FLAG_PARSE_CUSTOM_TAGS | PARSER_FLAG_IN_PLACE };
+  size_t flagCount = 1U;
+  int first = argc;
+
+  for (int i = 1; i < argc && first == argc; i++) {
+    if (strcmp(argv[i], "--chunk") == 0 && i + 1 < argc) {
+      char *list = argv[++i];
+      chunkCount = 0U;
+      for (char *c = strtok(list, ","); c != NULL && chunkCount < MAX_CHUNKS;
+           c = strtok(NULL, ",")) {
+        chunks[chunkCount++] = feed_parseChunk(c);
+      }
+    } else if (strcmp(argv[i], "--in-place") == 0 && i + 1 < argc) {
+      char *list = argv[++i];
+      flagCount = 0U;
+      for (char *c = strtok(list, ","); c != NULL && flagCount < 2U;
+           c = strtok(NULL, ",")) {
+        flags[flagCount++] = PARSER_FLAG_PARSE_CUSTOM_TAGS
+                             | ((strcmp(c, "no") == 0) ? 0U : PARSER_FLAG_IN_PLACE);
+      }
+    } else if (strcmp(argv[i], "--repeat") == 0 && i + 1 < argc) {
+      b.repeat = (unsigned)strtoul(argv[++i], NULL, 0);
+    } else if (strcmp(argv[i], "--sign") == 0 && i + 1 < argc) {
+      b.signKey = argv[++i];
+    } else if (strcmp(argv[i], "--key") == 0 && i + 1 < argc) {
+      b.decryptKey = argv[++i];
+    } else if (strcmp(argv[i], "--expect") == 0 && i + 1 < argc) {
+      b.expect = feed_readFile(argv[++i], &b.expectLength);
+    } else if (strcmp(argv[i], "--address") == 0 && i + 1 < argc) {
+      b.address = strtoul(argv[++i], NULL, 0);
+    } else if (argv[i][0] != '-' && strchr(argv[i], '=') != NULL) {
+      first = i;
+    } else {
+      return usage();
+    }
+  }
+  if (first == argc || b.repeat == 0U || flagCount == 0U) {
+    return usage();
+  }
+
+  for (int i = first; i < argc; i++) {
+    char *file = strchr(argv[i], '=');
+    Feed_t f = { .seed = 1U };
+
+    if (file == NULL) {
+      return usage();
+    }
+    *file++ = '\0';
+    f.gbl = feed_readFile(file, &f.gblLength);
+    for (size_t p = 0; p < flagCount; p++) {
+      for (size_t c = 0; c < chunkCount; c++) {
+        f.flags = flags[p];
+        f.chunk = chunks[c];
+        if (!bench(&b, argv[i], file, &f)) {
+          return 1;
+        }
+      }
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,87 @@
+/***************************************************************************//**
+ * @file
+ * @brief Feed a GBL file through the bootloader image parser on the host.
+ *
+ * Checks that the image is complete and verified, and optionally that flash
+ * holds the expected application afterwards.
+ *
+ *   gbl_feed [--chunk N|random] [--seed N] [--sign KEY] [--key TOKENS]
+ *            [--expect BIN --address ADDR] FILE.gbl
+ ******************************************************************************/
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "btl_host.h"
+#include "feed.h"
+
+#include "parser/gbl/btl_gbl_parser.h"
+
+static int usage(void)
+{
+  fprintf(stderr,
+          "usage: gbl_feed [--chunk N|random] [--seed N] [--sign KEY] "
+          "[--key TOKENS] [--expect BIN --address ADDR] FILE.gbl\n");
+  return 2;
+}
+
+int main(int argc, char **argv)
+{
+  Feed_t f = { .chunk = 0U, .seed = 1U,
+               .flags = PARSER_FLAG_PARSE_CUSTOM_TAGS | PARSER_FLAG_IN_PLACE };
+  const char *signKey = NULL;
+  const char *decryptKey = NULL;
+  const char *expectFile = NULL;
+  const char *gblFile = NULL;
+  const uint8_t *expect = NULL;
+  size_t expectLength = 0U;
+  uint32_t address = 0x08006000UL;
+  int code;
+
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--chunk") == 0 && i + 1 < argc) {
+      f.chunk = feed_parseChunk(argv[++i]);
+    } else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+      f.seed = strtoul(argv[++i], NULL, 0);
+    } else if (strcmp(argv[i], "--sign") == 0 && i + 1 < argc) {
+      signKey = argv[++i];
+    } else if (strcmp(argv[i], "--key") == 0 && i + 1 < argc) {
+      decryptKey = argv[++i];
+    } else if (strcmp(argv[i], "--expect") == 0 && i + 1 < argc) {
+      expectFile = argv[++i];
+    } else if (strcmp(argv[i], "--address") == 0 && i + 1 < argc) {
+      address = strtoul(argv[++i], NULL, 0);
+    } else if (argv[i][0] != '-' && gblFile == NULL) {
+      gblFile = argv[i];
+    } else {
+      return usage();
+    }
+  }
+  if (gblFile == NULL) {
+    return usage();
+  }
+
+  btl_host_reset();
+  btl_host_flashErase();
+  if (btl_host_loadKeys(signKey, decryptKey) != 0) {
+    return 2;
+  }
+  f.gbl = feed_readFile(gblFile, &f.gblLength);
+  if (expectFile != NULL) {
+    expect = feed_readFile(expectFile, &expectLength);
+  }
+
+  code = feed_run(&f);
+  if (code != 0) {
+    fprintf(stderr, "%s: bootloader reset (%d)\n", gblFile, code);
+    return 1;
+  }
+  if (!feed_check(&f, gblFile, expect, expectLength, address)) {
+    return 1;
+  }
+  printf("%s: OK, %zu bytes, %u pages erased, %u words written\n", gblFile,
+         f.gblLength, (unsigned)btl_host_flashStats()->pageErases,
+         (unsigned)btl_host_flashStats()->wordWrites);
+  return 0;
+}
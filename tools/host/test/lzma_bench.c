@@ -0,0 +1,345 @@
+/***************************************************************************//**
+ * @file
+ * @brief Microbenchmark of the LZMA decoder build profiles.
+ *
+ * parser/compression/lzma/LzmaDec.c is built once per profile: stock, with
+ * _LZMA_SIZE_OPT, with LZMA_DECODE_SPEED_OPT, with LZMA_DECODE_LC3_LP0, and
+ * with both of the latter, with its functions renamed after the profile (see
+ * CMakeLists.txt). Each profile decodes the PROG_LZMA tag of each GBL file
+ * given into a 1 KiB output buffer, as the bootloader does without the flash
+ * page buffer, without the parser or flash. The output is checked against the application binary,
+ * and the best of a number of runs is written as one JSON object per line:
+ * decoded bytes per host nanosecond, and per core cycle where the kernel
+ * lets the process count its own cycles. Profiles that reject the LZMA
+ * properties of an image are reported as such.
+ *
+ * On the target, the lzma_decode stage of the profile menu reports decoded
+ * bytes and core cycles of the same decoder; tools/profile.py reports them
+ * in bytes per cycle.
+ *
+ *   lzma_bench [--repeat N] --expect BIN NAME=FILE.gbl...
+ ******************************************************************************/
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include "feed.h"
+
+#include "parser/compression/lzma/LzmaDec.h"
+
+#define TAG_PROG_LZMA              0xFD0707FDUL
+#define OUTPUT_BUFFER_SIZE         1024U
+
+typedef SRes (*Allocate_t)(CLzmaDec *state, const Byte *prop,
+                           unsigned propsSize, ISzAllocPtr alloc);
+typedef void (*Init_t)(CLzmaDec *state);
+typedef SRes (*DecodeToBuf_t)(CLzmaDec *p, Byte *dest, SizeT *destLen,
+                              const Byte *src, SizeT *srcLen,
+                              ELzmaFinishMode finishMode,
+                              ELzmaStatus *status);
+typedef void (*Free_t)(CLzmaDec *state, ISzAllocPtr alloc);
+
+#define PROFILE_FUNCTIONS(profile)                                            \
+  SRes LzmaDec_Allocate_##profile(CLzmaDec *state, const Byte *prop,          \
+                                  unsigned propsSize, ISzAllocPtr alloc);     \
+  void LzmaDec_Init_##profile(CLzmaDec *state);                               \
+  SRes LzmaDec_DecodeToBuf_##profile(CLzmaDec *p, Byte *dest,                 \
+                                     SizeT *destLen, const Byte *src,         \
+                                     SizeT *srcLen,                           \
+                                     ELzmaFinishMode finishMode,              \
+                                     ELzmaStatus *status);                    \
+  void LzmaDec_Free_##profile(CLzmaDec *state, ISzAllocPtr alloc);
+
+PROFILE_FUNCTIONS(stock)
+PROFILE_FUNCTIONS(size_opt)
+PROFILE_FUNCTIONS(speed_opt)
+PROFILE_FUNCTIONS(lc3_lp0)
+PROFILE_FUNCTIONS(speed_lc3_lp0)
+
+#define PROFILE(profile)                                                      \
+  { #profile, LzmaDec_Allocate_##profile, LzmaDec_Init_##profile,             \
+    LzmaDec_DecodeToBuf_##profile, LzmaDec_Free_##profile }
+
+static const struct {
+  const char    *name;
+  Allocate_t    allocate;
+  Init_t        init;
+  DecodeToBuf_t decodeToBuf;
+  Free_t        free;
+} profiles[] = {
+  PROFILE(stock),
+  PROFILE(size_opt),
+  PROFILE(speed_opt),
+  PROFILE(lc3_lp0),
+  PROFILE(speed_lc3_lp0),
+};
+
+#define PROFILE_COUNT              (sizeof(profiles) / sizeof(profiles[0]))
+
+// An LZMA stream: 5 bytes properties, 8 bytes decoded size, then the data
+typedef struct {
+  const uint8_t *props;
+  uint64_t decodedSize;
+  const uint8_t *data;
+  size_t   dataLength;
+} LzmaStream_t;
+
+static void *allocate(ISzAllocPtr p, size_t size)
+{
+  (void)p;
+  return malloc(size);
+}
+
+static void release(ISzAllocPtr p, void *address)
+{
+  (void)p;
+  free(address);
+}
+
+static const ISzAlloc allocator = { allocate, release };
+
+static uint32_t readWord(const uint8_t *p)
+{
+  return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16)
+         | ((uint32_t)p[3] << 24);
+}
+
+// Find the PROG_LZMA tag of an unencrypted GBL file
+static bool findStream(const uint8_t *gbl, size_t length, LzmaStream_t *s)
+{
+  for (size_t offset = 0; offset + 8U <= length; ) {
+    uint32_t id = readWord(&gbl[offset]);
+    uint32_t tagLength = readWord(&gbl[offset + 4U]);
+
+    if (tagLength > length - offset - 8U) {
+      return false;
+    }
+    if (id == TAG_PROG_LZMA && tagLength >= 4U + LZMA_PROPS_SIZE + 8U) {
+      const uint8_t *tag = &gbl[offset + 8U];
+      s->props = &tag[4];
+      s->decodedSize = readWord(&tag[4 + LZMA_PROPS_SIZE])
+                       | ((uint64_t)readWord(&tag[8 + LZMA_PROPS_SIZE]) << 32);
+      s->data = &tag[4 + LZMA_PROPS_SIZE + 8];
+      s->dataLength = tagLength - (4U + LZMA_PROPS_SIZE + 8U);
+      return true;
+    }
+    offset += 8U + tagLength;
+  }
+  return false;
+}
+
+// -----------------------------------------------------------------------------
+// Timing
+
+static uint64_t hostNs(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+static int cycleCounter = -1;
+
+// Count the core cycles of this process in user space, if allowed
+static void openCycleCounter(void)
+{
+#if defined(__linux__)
+  struct perf_event_attr attr;
+
+  memset(&attr, 0, sizeof(attr));
+  attr.type = PERF_TYPE_HARDWARE;
+  attr.size = sizeof(attr);
+  attr.config = PERF_COUNT_HW_CPU_CYCLES;
+  attr.disabled = 1;
+  attr.exclude_kernel = 1;
+  attr.exclude_hv = 1;
+  cycleCounter = (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+#endif
+}
+
+static void startCycles(void)
+{
+#if defined(__linux__)
+  if (cycleCounter >= 0) {
+    ioctl(cycleCounter, PERF_EVENT_IOC_RESET, 0);
+    ioctl(cycleCounter, PERF_EVENT_IOC_ENABLE, 0);
+  }
+#endif
+}
+
+static uint64_t stopCycles(void)
+{
+  uint64_t cycles = 0U;
+
+#if defined(__linux__)
+  if (cycleCounter >= 0) {
+    ioctl(cycleCounter, PERF_EVENT_IOC_DISABLE, 0);
+    if (read(cycleCounter, &cycles, sizeof(cycles)) != sizeof(cycles)) {
+      cycles = 0U;
+    }
+  }
+#endif
+  return cycles;
+}
+
+// -----------------------------------------------------------------------------
+// Decoding
+
+// Decode a stream with one profile, in output chunks as the bootloader
+// does, and check the output. Returns the SRes of the decoder, or
+// SZ_ERROR_DATA if the output differs.
+static SRes decode(unsigned p, const LzmaStream_t *s, const uint8_t *expect,
+                   size_t expectLength)
+{
+  static uint8_t output[OUTPUT_BUFFER_SIZE];
+  CLzmaDec state;
+  ELzmaStatus status = LZMA_STATUS_NOT_FINISHED;
+  size_t inputOffset = 0U;
+  size_t outputOffset = 0U;
+  SRes res;
+
+  LzmaDec_Construct(&state);
+  res = profiles[p].allocate(&state, s->props, LZMA_PROPS_SIZE, &allocator);
+  if (res != SZ_OK) {
+    return res;
+  }
+  profiles[p].init(&state);
+
+  while (res == SZ_OK && status != LZMA_STATUS_FINISHED_WITH_MARK
+         && outputOffset < s->decodedSize) {
+    SizeT outputLength = sizeof(output);
+    SizeT inputLength = s->dataLength - inputOffset;
+
+    res = profiles[p].decodeToBuf(&state, output, &outputLength,
+                                  &s->data[inputOffset], &inputLength,
+                                  LZMA_FINISH_ANY, &status);
+    if (outputLength > expectLength - outputOffset
+        || memcmp(output, &expect[outputOffset], outputLength) != 0) {
+      res = SZ_ERROR_DATA;
+    }
+    inputOffset += inputLength;
+    outputOffset += outputLength;
+    if (inputLength == 0U && outputLength == 0U) {
+      break;
+    }
+  }
+  if (res == SZ_OK && outputOffset != expectLength) {
+    res = SZ_ERROR_DATA;
+  }
+  profiles[p].free(&state, &allocator);
+  return res;
+}
+
+static bool bench(const char *name, const LzmaStream_t *s,
+                  const uint8_t *expect, size_t expectLength, unsigned repeat)
+{
+  bool ok = true;
+
+  for (unsigned p = 0; p < PROFILE_COUNT; p++) {
+    uint64_t bestNs = UINT64_MAX;
+    uint64_t bestCycles = 0U;
+    SRes res = SZ_OK;
+
+    for (unsigned run = 0; run < repeat && res == SZ_OK; run++) {
+      uint64_t start = hostNs();
+      uint64_t ns;
+      uint64_t cycles;
+
+      startCycles();
+      res = decode(p, s, expect, expectLength);
+      cycles = stopCycles();
+      ns = hostNs() - start;
+      if (ns < bestNs) {
+        bestNs = ns;
+        bestCycles = cycles;
+      }
+    }
+
+    printf("{\"image\": \"%s\", \"profile\": \"%s\", \"lc\": %u, \"lp\": %u, "
+           "\"pb\": %u, \"decoded_bytes\": %zu, ",
+           name, profiles[p].name, s->props[0] % 9U, (s->props[0] / 9U) % 5U,
+           s->props[0] / 45U, expectLength);
+    if (res == SZ_ERROR_UNSUPPORTED) {
+      printf("\"rejected\": true}\n");
+      continue;
+    }
+    if (res != SZ_OK) {
+      printf("\"ok\": false}\n");
+      fprintf(stderr, "%s: %s profile failed with %d\n", name,
+              profiles[p].name, res);
+      ok = false;
+      continue;
+    }
+    printf("\"ns\": %llu, \"bytes_per_ns\": %.4f, \"mb_per_s\": %.1f",
+           (unsigned long long)bestNs, (double)expectLength / bestNs,
+           (double)expectLength * 1e3 / bestNs);
+    if (bestCycles != 0U) {
+      printf(", \"cycles\": %llu, \"bytes_per_cycle\": %.4f",
+             (unsigned long long)bestCycles,
+             (double)expectLength / bestCycles);
+    }
+    printf("}\n");
+    fflush(stdout);
+  }
+  return ok;
+}
+
+static int usage(void)
+{
+  fprintf(stderr,
+          "usage: lzma_bench [--repeat N] --expect BIN NAME=FILE.gbl...\n");
+  return 2;
+}
+
+int main(int argc, char **argv)
+{
+  const uint8_t *expect = NULL;
+  size_t expectLength = 0U;
+  unsigned repeat = 5U;
+  int first = argc;
+  int status = 0;
+
+  for (int i = 1; i < argc && first == argc; i++) {
+    if (strcmp(argv[i], "--repeat") == 0 && i + 1 < argc) {
+      repeat = (unsigned)strtoul(argv[++i], NULL, 0);
+    } else if (strcmp(argv[i], "--expect") == 0 && i + 1 < argc) {
+      expect = feed_readFile(argv[++i], &expectLength);
+    } else if (argv[i][0] != '-' && strchr(argv[i], '=') != NULL) {
+      first = i;
+    } else {
+      return usage();
+    }
+  }
+  if (first == argc || expect == NULL || repeat == 0U) {
+    return usage();
+  }
+
+  openCycleCounter();
+  for (int i = first; i < argc; i++) {
+    char *file = strchr(argv[i], '=');
+    const uint8_t *gbl;
+    size_t gblLength;
+    LzmaStream_t s;
+
+    *file++ = '\0';
+    gbl = feed_readFile(file, &gblLength);
+    if (!findStream(gbl, gblLength, &s)) {
+      fprintf(stderr, "%s: no unencrypted PROG_LZMA tag\n", file);
+      return 1;
+    }
+    if (!bench(argv[i], &s, expect, expectLength, repeat)) {
+      status = 1;
+    }
+  }
+  return status;
+}
@@ -0,0 +1,88 @@
+#!/usr/bin/env python3
+"""Create a pseudo-random application image for the host tests.
+
+The image compresses about as well as Cortex-M firmware: it is built from
+instruction-like halfwords drawn from a small vocabulary, repeated code
+sequences and runs of constant data, behind a vector table.
+
+With --base, the image is a later version of another one instead, with
+code inserted, removed and changed in a few places, for delta upgrades.
+"""
+
+import argparse
+import random
+import struct
+import sys
+
+
+def make_app(size, seed):
+    rng = random.Random(seed)
+    vocabulary = [rng.getrandbits(16) for _ in range(512)]
+    snippets = []
+    out = bytearray()
+
+    # Vector table: initial stack pointer, then handlers in the image
+    out += struct.pack('<I', 0x20008000)
+    for _ in range(63):
+        out += struct.pack('<I', 0x08006000 + 0x100 + (rng.getrandbits(12) << 1) + 1)
+
+    while len(out) < size:
+        kind = rng.random()
+        if kind < 0.55:
+            # Fresh code from the vocabulary, remembered for reuse
+            snippet = b''.join(struct.pack('<H', rng.choice(vocabulary))
+                               for _ in range(rng.randint(4, 48)))
+            snippets.append(snippet)
+            out += snippet
+        elif kind < 0.85 and snippets:
+            # Repeated code sequence
+            out += rng.choice(snippets[-256:])
+        elif kind < 0.93:
+            # Constant tables and padding
+            out += bytes([rng.choice([0x00, 0xFF])]) * rng.randint(4, 64)
+        else:
+            # Literal pool, string and table data
+            out += bytes(rng.getrandbits(8) for _ in range(rng.randint(4, 64)))
+    return bytes(out[:size])
+
+
+def edit_app(base, edits, seed):
+    rng = random.Random(seed)
+    out = bytearray(base)
+    for _ in range(edits):
+        # The vector table stays in place
+        pos = rng.randrange(256, len(out)) & ~1
+        length = rng.randint(2, 32) * 2
+        kind = rng.random()
+        if kind < 0.4:
+            out[pos:pos] = bytes(rng.getrandbits(8) for _ in range(length))
+        elif kind < 0.7:
+            del out[pos:pos + length]
+        else:
+            out[pos:pos + length] = bytes(rng.getrandbits(8) for _ in range(length))
+    return bytes(out)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__)
+    parser.add_argument('--size', type=int)
+    parser.add_argument('--seed', type=int, default=1)
+    parser.add_argument('--base', help='earlier version of the image')
+    parser.add_argument('--edits', type=int, default=24,
+                        help='places changed in the earlier version')
+    parser.add_argument('output')
+    args = parser.parse_args()
+    if args.base is not None:
+        with open(args.base, 'rb') as f:
+            app = edit_app(f.read(), args.edits, args.seed)
+    elif args.size is not None:
+        app = make_app(args.size, args.seed)
+    else:
+        parser.error('--size or --base is required')
+    with open(args.output, 'wb') as f:
+        f.write(app)
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
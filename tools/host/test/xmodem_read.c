@@ -0,0 +1,375 @@
+/***************************************************************************//**
+ * @file
+ * @brief Flash readback and page manifest over the modelled serial line.
+ *
+ * Runs the XMODEM UART communication interface of the bootloader, built with
+ * BTL_XMODEM_READBACK_ENABLE, against an XMODEM-CRC receiver on the host side
+ * of the line model. Flash is filled with pseudo-random data, a range across
+ * the GBL decryption key in the token page is read with menu 9, and the page
+ * manifest of the token page is listed with menu 0. The data received and
+ * the CRC-32 listed must match flash, with the key read as erased flash.
+ *
+ *   xmodem_read [--address ADDR] [--length N]
+ ******************************************************************************/
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "btl_host.h"
+
+#include "communication/btl_communication.h"
+
+#define XMODEM_SOH                 0x01U
+#define XMODEM_STX                 0x02U
+#define XMODEM_EOT                 0x04U
+#define XMODEM_ACK                 0x06U
+#define XMODEM_NAK                 0x15U
+#define XMODEM_CAN                 0x18U
+#define XMODEM_C                   0x43U
+
+// GBL decryption key, masked by the bootloader
+#define KEY_ADDRESS                0x0807E284UL
+#define KEY_SIZE                   20UL
+
+// Token page and end of flash
+#define TOKEN_PAGE                 0x0807E000UL
+#define TOKEN_PAGE_SIZE            0x2000UL
+#define FLASH_END                  0x08080000UL
+
+// Time the receiver waits for the bootloader before giving up
+#define RECEIVER_TIMEOUT_PS        (20ULL * BTL_HOST_PS_PER_S)
+
+// Stops the bootloader once the receiver is done
+#define SIM_STOP                   0x7FFF
+
+typedef enum {
+  RECEIVER_WAIT_ADDRESS,           // Menu selection sent, waiting for prompt
+  RECEIVER_WAIT_LENGTH,
+  RECEIVER_WAIT_BEGIN,             // Range sent, waiting for the download
+  RECEIVER_PACKET,                 // Receiving packets
+  RECEIVER_WAIT_RESULT,            // Waiting for the completion message
+  RECEIVER_MANIFEST,               // Receiving manifest lines
+  RECEIVER_DONE
+} ReceiverState_t;
+
+typedef struct {
+  // Parameters
+  uint8_t  select;
+  uint32_t address;
+  uint32_t length;
+
+  // State
+  ReceiverState_t state;
+  char     tail[64];               // Last characters of bootloader output
+  uint8_t  packet[3U + 1024U + 2U];
+  size_t   packetLength;
+  uint8_t  packetNumber;
+  bool     ok;
+
+  // Results
+  uint8_t  *data;
+  size_t   dataLength;
+  uint32_t pageCrc;
+  uint32_t pages;
+} Receiver_t;
+
+static Receiver_t receiver;
+
+static void receiverStop(bool ok)
+{
+  receiver.ok = ok;
+  receiver.state = RECEIVER_DONE;
+  btl_host_lineSetTimer(0U);
+  btl_host_stop(SIM_STOP);
+}
+
+// XMODEM CRC16, independent of the bootloader implementation
+static uint16_t blockCrc(const uint8_t *data, size_t length)
+{
+  uint16_t crc = 0U;
+
+  for (size_t i = 0; i < length; i++) {
+    crc ^= (uint16_t)data[i] << 8;
+    for (unsigned bit = 0; bit < 8U; bit++) {
+      crc = (crc & 0x8000U) ? (uint16_t)((crc << 1) ^ 0x1021U) : (uint16_t)(crc << 1);
+    }
+  }
+  return crc;
+}
+
+// CRC-32 as computed by zlib
+static uint32_t pageCrc(const uint8_t *data, size_t length)
+{
+  uint32_t crc = 0xFFFFFFFFUL;
+
+  for (size_t i = 0; i < length; i++) {
+    crc ^= data[i];
+    for (unsigned bit = 0; bit < 8U; bit++) {
+      crc = (crc & 1U) ? (crc >> 1) ^ 0xEDB88320UL : crc >> 1;
+    }
+  }
+  return crc ^ 0xFFFFFFFFUL;
+}
+
+static void send(const char *str)
+{
+  btl_host_lineSend((const uint8_t *)str, strlen(str));
+  btl_host_lineSetTimer(btl_host_time() + RECEIVER_TIMEOUT_PS);
+}
+
+static void sendByte(uint8_t byte)
+{
+  btl_host_lineSend(&byte, 1U);
+  btl_host_lineSetTimer(btl_host_time() + RECEIVER_TIMEOUT_PS);
+}
+
+static bool outputEndsWith(const char *str)
+{
+  size_t length = strlen(receiver.tail);
+  size_t strLength = strlen(str);
+
+  return (length >= strLength)
+         && (strcmp(&receiver.tail[length - strLength], str) == 0);
+}
+
+static void appendOutput(uint8_t byte)
+{
+  size_t length = strlen(receiver.tail);
+
+  if (length == sizeof(receiver.tail) - 1U) {
+    memmove(receiver.tail, &receiver.tail[1], length);
+    length--;
+  }
+  receiver.tail[length] = (char)byte;
+  receiver.tail[length + 1U] = '\0';
+}
+
+// A complete packet was received; store it if it is intact
+static void receivePacket(void)
+{
+  size_t size = (receiver.packet[0] == XMODEM_STX) ? 1024U : 128U;
+  uint16_t crc = blockCrc(&receiver.packet[3], size);
+
+  receiver.packetLength = 0U;
+  if (receiver.packet[1] != receiver.packetNumber
+      || receiver.packet[2] != (uint8_t)~receiver.packetNumber
+      || receiver.packet[3U + size] != (uint8_t)(crc >> 8)
+      || receiver.packet[4U + size] != (uint8_t)crc) {
+    fprintf(stderr, "xmodem_read: packet %u is corrupt\n",
+            (unsigned)receiver.packetNumber);
+    sendByte(XMODEM_NAK);
+    return;
+  }
+  receiver.data = realloc(receiver.data, receiver.dataLength + size);
+  memcpy(&receiver.data[receiver.dataLength], &receiver.packet[3], size);
+  receiver.dataLength += size;
+  receiver.packetNumber++;
+  sendByte(XMODEM_ACK);
+}
+
+static void receiverReceive(void *context, uint8_t byte)
+{
+  char hex[9];
+
+  (void)context;
+
+  switch (receiver.state) {
+    case RECEIVER_WAIT_ADDRESS:
+      appendOutput(byte);
+      if (outputEndsWith("address > ")) {
+        snprintf(hex, sizeof(hex), "%08X", (unsigned)receiver.address);
+        receiver.state = RECEIVER_WAIT_LENGTH;
+        send(hex);
+      }
+      break;
+
+    case RECEIVER_WAIT_LENGTH:
+      appendOutput(byte);
+      if (outputEndsWith("length > ")) {
+        snprintf(hex, sizeof(hex), "%08X", (unsigned)receiver.length);
+        receiver.tail[0] = '\0';
+        receiver.state = (receiver.select == '9') ? RECEIVER_WAIT_BEGIN
+                         : RECEIVER_MANIFEST;
+        send(hex);
+      }
+      break;
+
+    case RECEIVER_WAIT_BEGIN:
+      appendOutput(byte);
+      if (outputEndsWith("begin download\r\n")) {
+        receiver.state = RECEIVER_PACKET;
+        receiver.packetNumber = 1U;
+        sendByte(XMODEM_C);
+      }
+      break;
+
+    case RECEIVER_PACKET:
+      if (receiver.packetLength == 0U) {
+        if (byte == XMODEM_EOT) {
+          receiver.state = RECEIVER_WAIT_RESULT;
+          receiver.tail[0] = '\0';
+          sendByte(XMODEM_ACK);
+        } else if (byte == XMODEM_CAN) {
+          receiverStop(false);
+        } else if (byte == XMODEM_SOH || byte == XMODEM_STX) {
+          receiver.packet[receiver.packetLength++] = byte;
+        }
+        break;
+      }
+      receiver.packet[receiver.packetLength++] = byte;
+      if (receiver.packetLength
+          == 5U + ((receiver.packet[0] == XMODEM_STX) ? 1024U : 128U)) {
+        receivePacket();
+      }
+      break;
+
+    case RECEIVER_WAIT_RESULT:
+      appendOutput(byte);
+      if (outputEndsWith("download complete\r\n")) {
+        receiverStop(true);
+      } else if (outputEndsWith("download aborted\r\n")) {
+        receiverStop(false);
+      }
+      break;
+
+    case RECEIVER_MANIFEST: {
+      unsigned page;
+      unsigned crc;
+
+      appendOutput(byte);
+      if (byte != '\n') {
+        break;
+      }
+      if (sscanf(receiver.tail, "%8X %8X", &page, &crc) == 2) {
+        if (page != (receiver.address & ~(TOKEN_PAGE_SIZE - 1UL))) {
+          fprintf(stderr, "xmodem_read: manifest lists page 0x%08x\n", page);
+          receiverStop(false);
+        }
+        receiver.pageCrc = crc;
+        receiver.pages++;
+        receiverStop(true);
+      }
+      receiver.tail[0] = '\0';
+      break;
+    }
+
+    case RECEIVER_DONE:
+      break;
+  }
+}
+
+static void receiverTimeout(void *context)
+{
+  (void)context;
+  fprintf(stderr, "xmodem_read: no response from the bootloader\n");
+  receiverStop(false);
+}
+
+// Runs on the bootloader stack
+static void bootloader(void *argument)
+{
+  static const BtlHostLineHandler_t handler = {
+    .receive = receiverReceive,
+    .timer = receiverTimeout,
+    .context = NULL
+  };
+
+  (void)argument;
+  communication_init();
+  btl_host_lineSetHandler(&handler);
+  sendByte(receiver.select);
+  (void)communication_main();
+}
+
+// Run one menu action of the receiver
+static bool run(uint8_t select, uint32_t address, uint32_t length)
+{
+  free(receiver.data);
+  memset(&receiver, 0, sizeof(receiver));
+  receiver.select = select;
+  receiver.address = address;
+  receiver.length = length;
+  btl_host_reset();
+  return btl_host_run(bootloader, NULL) == SIM_STOP && receiver.ok;
+}
+
+// -----------------------------------------------------------------------------
+// Main
+
+static int usage(void)
+{
+  fprintf(stderr, "usage: xmodem_read [--address ADDR] [--length N]\n");
+  return 2;
+}
+
+int main(int argc, char **argv)
+{
+  static uint8_t flash[FLASH_END - TOKEN_PAGE + TOKEN_PAGE_SIZE];
+  const uint32_t base = TOKEN_PAGE - TOKEN_PAGE_SIZE;
+  uint32_t address = 0x0807DF00UL;
+  uint32_t length = 0x4F0UL;
+  uint32_t state = 1U;
+  int status = 0;
+
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--address") == 0 && i + 1 < argc) {
+      address = strtoul(argv[++i], NULL, 0);
+    } else if (strcmp(argv[i], "--length") == 0 && i + 1 < argc) {
+      length = strtoul(argv[++i], NULL, 0);
+    } else {
+      return usage();
+    }
+  }
+  if (address < base || length == 0U || length > FLASH_END - address) {
+    return usage();
+  }
+
+  // The last pages of flash, with the key in the token page
+  for (size_t i = 0; i < sizeof(flash); i++) {
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    flash[i] = (uint8_t)state;
+  }
+  btl_host_flashErase();
+  btl_host_flashLoad(base, flash, sizeof(flash));
+  memset(&flash[KEY_ADDRESS - base], 0xFF, KEY_SIZE);
+
+  if (!run('9', address, length)) {
+    fprintf(stderr, "xmodem_read: download of %u bytes at 0x%08x failed\n",
+            (unsigned)length, (unsigned)address);
+    return 1;
+  }
+  for (size_t i = 0; i < receiver.dataLength; i++) {
+    uint8_t expected = (i < length) ? flash[address - base + i] : 0xFFU;
+
+    if (receiver.data[i] != expected) {
+      fprintf(stderr, "xmodem_read: byte at 0x%08zx is 0x%02x, "
+              "expected 0x%02x\n", address + i, receiver.data[i], expected);
+      status = 1;
+      break;
+    }
+  }
+  if (receiver.dataLength < length) {
+    fprintf(stderr, "xmodem_read: %zu of %u bytes received\n",
+            receiver.dataLength, (unsigned)length);
+    status = 1;
+  }
+  printf("download: %zu bytes in %u packets\n", receiver.dataLength,
+         (unsigned)(receiver.packetNumber - 1U));
+
+  if (!run('0', TOKEN_PAGE, 1U) || receiver.pages != 1U) {
+    fprintf(stderr, "xmodem_read: manifest failed\n");
+    return 1;
+  }
+  if (receiver.pageCrc != pageCrc(&flash[TOKEN_PAGE - base], TOKEN_PAGE_SIZE)) {
+    fprintf(stderr, "xmodem_read: CRC-32 of the token page is 0x%08x, "
+            "expected 0x%08x\n", (unsigned)receiver.pageCrc,
+            (unsigned)pageCrc(&flash[TOKEN_PAGE - base], TOKEN_PAGE_SIZE));
+    status = 1;
+  }
+  printf("manifest: 0x%08x %08x\n", (unsigned)TOKEN_PAGE,
+         (unsigned)receiver.pageCrc);
+  return status;
+}
@@ -0,0 +1,584 @@
+/***************************************************************************//**
+ * @file
+ * @brief Upload of a GBL file over the modelled serial line with XMODEM.
+ *
+ * Runs the XMODEM UART communication interface of the bootloader against an
+ * XMODEM-CRC sender on the host side of the line model. The sender selects
+ * the upload from the menu, and sends the file in 128 byte (SOH) or 1024
+ * byte (STX) blocks once the bootloader requests the transfer. With
+ * --stream, the sender selects the streaming upload (menu 5, built with
+ * BTL_XMODEM_STREAMING_ENABLE), and sends all blocks back to back once the
+ * bootloader requests the transfer with 'G'. The upload is timed in virtual time, from the transfer request to the completion
+ * message, and written as one JSON object per line, for each combination of
+ * the block sizes, baud rates and flash page erase times given. With
+ * --installed, flash holds an older application at the upload address
+ * before each upload, so that its pages are erased as on a device in the
+ * field. With --keep-going, failed uploads are reported as such and the others still
+ * run, to find where streaming without flow control breaks down. With
+ * --rejected, the bootloader has to refuse the upload, and flash is checked
+ * against --expect afterwards all the same.
+ *
+ * On a bootloader built with SL_DEBUG_PROFILE, the bytes the GBL parser
+ * copied (profiling stage gbl_copy) are reported per block. With --max-copy,
+ * the upload fails if they exceed the given number, to check that packets
+ * are parsed in place in the receive buffer.
+ *
+ * With --loss, each byte sent to the device from the transfer request on is
+ * lost with the given probability, in parts per million. The time from the
+ * end of a block to its NAK is reported, and with --nak-us checked against
+ * a range, to cover the recovery of BTL_XMODEM_FAST_NAK_ENABLE: the idle gap
+ * set with uart_setRxIdleTimeout() on the TIMECMP1 comparator, its minimum
+ * BTL_XMODEM_RX_GAP_MIN_US, and the packet timeout. The sender honours RTS,
+ * after --cts-lag more bytes; on a bootloader built without flow control,
+ * RTS is always asserted.
+ *
+ * The bootloader code runs without cost on the host. Its processing time is
+ * charged per byte to the virtual time: XMODEM CRC16 per received packet
+ * byte, and image parsing (CRC32, SHA-256, decryption, decompression and the
+ * flash callback) per GBL byte. Take the cycles per byte from the profile of
+ * a target (menu "profile") to model it.
+ *
+ *   xmodem_sim [--stream] [--block 128,1024] [--baud N,...] [--erase-us N,...]
+ *              [--loss PPM,...] [--seed N] [--nak-us MIN,MAX]
+ *              [--cts-lag N]
+ *              [--write-ns N] [--crc-cpb N] [--parse-cpb N] [--keep-going]
+ *              [--rejected] [--max-copy N] [--installed BIN] [--sign KEY]
+ *              [--key TOKENS] [--expect BIN] [--address ADDR] FILE.gbl
+ ******************************************************************************/
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "btl_host.h"
+#include "feed.h"
+
+#include "api/btl_errorcode.h"
+#include "communication/btl_communication.h"
+#include "debug/btl_debug.h"
+#include "driver/btl_serial_driver.h"
+#include "security/btl_crc16.h"
+
+#define XMODEM_SOH                 0x01U
+#define XMODEM_STX                 0x02U
+#define XMODEM_EOT                 0x04U
+#define XMODEM_ACK                 0x06U
+#define XMODEM_NAK                 0x15U
+#define XMODEM_CAN                 0x18U
+#define XMODEM_C                   0x43U
+#define XMODEM_G                   0x47U
+
+// Padding of the last block
+#define XMODEM_SUB                 0x1AU
+
+// Time the sender waits for a response before giving up
+#define SENDER_TIMEOUT_PS          (20ULL * BTL_HOST_PS_PER_S)
+
+// Stops the bootloader once the sender is done
+#define SIM_STOP                   0x7FFF
+
+typedef enum {
+  SENDER_WAIT_REQUEST,             // Menu selection sent, waiting for 'C'/'G'
+  SENDER_SEND,                     // Block sent, waiting for its response
+  SENDER_WAIT_EOT,                 // EOT sent, waiting for its ACK
+  SENDER_WAIT_RESULT,              // Waiting for the completion message
+  SENDER_DONE
+} SenderState_t;
+
+typedef struct {
+  // Parameters
+  size_t   blockSize;
+  uint32_t baudRate;
+  bool     stream;                 // Streaming upload (XMODEM-G)
+  uint32_t lossPpm;                // Loss once the transfer is requested
+  const uint8_t *gbl;
+  size_t   gblLength;
+
+  // State
+  SenderState_t state;
+  size_t   offset;                 // Offset of the block being sent
+  uint8_t  blockNumber;
+  char     tail[32];               // Last characters of bootloader output
+  bool     ok;
+  uint64_t blockEndPs;             // Time the last block sent is on the line
+
+  // Results
+  uint32_t blocks;
+  uint32_t retries;
+  uint64_t nakTotalPs;             // Time from the end of a block to its NAK
+  uint64_t nakMinPs;
+  uint64_t nakMaxPs;
+  uint64_t startPs;
+  uint64_t endPs;
+} Sender_t;
+
+static Sender_t sender;
+
+// Cycles charged per byte of bootloader processing
+static uint32_t crcCyclesPerByte = 12U;
+static uint32_t parseCyclesPerByte = 20U;
+
+// -----------------------------------------------------------------------------
+// Processing cost of the bootloader
+
+uint16_t __real_btl_crc16Stream(const uint8_t *buffer, size_t length,
+                                uint16_t prevResult);
+int32_t __real_parser_parse(void *context, ImageProperties_t *imageProperties,
+                            uint8_t buffer[], size_t length,
+                            const BootloaderParserCallbacks_t *callbacks);
+
+uint16_t __wrap_btl_crc16Stream(const uint8_t *buffer, size_t length,
+                                uint16_t prevResult)
+{
+  btl_host_spend((uint64_t)length * crcCyclesPerByte);
+  return __real_btl_crc16Stream(buffer, length, prevResult);
+}
+
+int32_t __wrap_parser_parse(void *context, ImageProperties_t *imageProperties,
+                            uint8_t buffer[], size_t length,
+                            const BootloaderParserCallbacks_t *callbacks)
+{
+  btl_host_spend((uint64_t)length * parseCyclesPerByte);
+  return __real_parser_parse(context, imageProperties, buffer, length,
+                             callbacks);
+}
+
+// -----------------------------------------------------------------------------
+// Sender
+
+static void senderStop(bool ok)
+{
+  sender.ok = ok;
+  sender.state = SENDER_DONE;
+  btl_host_lineSetTimer(0U);
+  btl_host_stop(SIM_STOP);
+}
+
+// XMODEM CRC16 of the sender, independent of the bootloader implementation
+static uint16_t blockCrc(const uint8_t *data, size_t length)
+{
+  uint16_t crc = 0U;
+
+  for (size_t i = 0; i < length; i++) {
+    crc ^= (uint16_t)data[i] << 8;
+    for (unsigned bit = 0; bit < 8U; bit++) {
+      crc = (crc & 0x8000U) ? (uint16_t)((crc << 1) ^ 0x1021U) : (uint16_t)(crc << 1);
+    }
+  }
+  return crc;
+}
+
+static void queueBlock(void)
+{
+  uint8_t block[3U + 1024U + 2U];
+  size_t length = sender.gblLength - sender.offset;
+  uint16_t crc;
+
+  if (length > sender.blockSize) {
+    length = sender.blockSize;
+  }
+  block[0] = (sender.blockSize == 1024U) ? XMODEM_STX : XMODEM_SOH;
+  block[1] = sender.blockNumber;
+  block[2] = (uint8_t)~sender.blockNumber;
+  memcpy(&block[3], &sender.gbl[sender.offset], length);
+  memset(&block[3U + length], XMODEM_SUB, sender.blockSize - length);
+  crc = blockCrc(&block[3], sender.blockSize);
+  block[3U + sender.blockSize] = (uint8_t)(crc >> 8);
+  block[3U + sender.blockSize + 1U] = (uint8_t)crc;
+  btl_host_lineSend(block, 3U + sender.blockSize + 2U);
+}
+
+// Time the data queued for the device takes on the line
+static uint64_t pendingPs(void)
+{
+  return (btl_host_linePending() * 10U * BTL_HOST_PS_PER_S)
+         / btl_host_lineBaudRate();
+}
+
+static void sendBlock(void)
+{
+  queueBlock();
+  sender.blockEndPs = btl_host_time() + pendingPs();
+  btl_host_lineSetTimer(btl_host_time() + SENDER_TIMEOUT_PS);
+}
+
+// A block was rejected
+static void blockNaked(void)
+{
+  uint64_t now = btl_host_time();
+  uint64_t nakPs = (now > sender.blockEndPs) ? now - sender.blockEndPs : 0U;
+
+  if (sender.retries == 0U || nakPs < sender.nakMinPs) {
+    sender.nakMinPs = nakPs;
+  }
+  if (nakPs > sender.nakMaxPs) {
+    sender.nakMaxPs = nakPs;
+  }
+  sender.nakTotalPs += nakPs;
+  sender.retries++;
+}
+
+static void sendByte(uint8_t byte)
+{
+  btl_host_lineSend(&byte, 1U);
+  btl_host_lineSetTimer(btl_host_time() + SENDER_TIMEOUT_PS);
+}
+
+// Queue all blocks and the EOT at once, as the sender does not wait for
+// data blocks to be acknowledged
+static void streamBlocks(void)
+{
+  while (sender.offset < sender.gblLength) {
+    queueBlock();
+    sender.blocks++;
+    sender.blockNumber++;
+    sender.offset += sender.blockSize;
+  }
+  sender.state = SENDER_WAIT_EOT;
+  sendByte(XMODEM_EOT);
+  // Allow for the time the queued data takes on the line
+  btl_host_lineSetTimer(btl_host_time() + SENDER_TIMEOUT_PS + pendingPs());
+}
+
+static bool outputEndsWith(const char *str)
+{
+  size_t length = strlen(sender.tail);
+  size_t strLength = strlen(str);
+
+  return (length >= strLength)
+         && (strcmp(&sender.tail[length - strLength], str) == 0);
+}
+
+static void senderReceive(void *context, uint8_t byte)
+{
+  (void)context;
+
+  switch (sender.state) {
+    case SENDER_WAIT_REQUEST:
+      btl_host_line.lossPpm = sender.lossPpm;
+      if (byte == XMODEM_C && !sender.stream) {
+        sender.startPs = btl_host_time();
+        sender.state = SENDER_SEND;
+        sendBlock();
+      } else if (byte == XMODEM_G && sender.stream) {
+        sender.startPs = btl_host_time();
+        streamBlocks();
+      }
+      break;
+
+    case SENDER_SEND:
+      if (byte == XMODEM_ACK) {
+        sender.blocks++;
+        sender.blockNumber++;
+        sender.offset += sender.blockSize;
+        if (sender.offset >= sender.gblLength) {
+          sender.state = SENDER_WAIT_EOT;
+          sendByte(XMODEM_EOT);
+        } else {
+          sendBlock();
+        }
+      } else if (byte == XMODEM_NAK) {
+        blockNaked();
+        btl_host_lineDiscard();
+        sendBlock();
+      } else if (byte == XMODEM_CAN) {
+        senderStop(false);
+      }
+      break;
+
+    case SENDER_WAIT_EOT:
+      if (byte == XMODEM_ACK) {
+        sender.state = SENDER_WAIT_RESULT;
+      } else if (byte == XMODEM_NAK) {
+        sendByte(XMODEM_EOT);
+      } else if (byte == XMODEM_CAN) {
+        senderStop(false);
+      }
+      break;
+
+    case SENDER_WAIT_RESULT: {
+      size_t length = strlen(sender.tail);
+
+      if (length == sizeof(sender.tail) - 1U) {
+        memmove(sender.tail, &sender.tail[1], length);
+        length--;
+      }
+      sender.tail[length] = (char)byte;
+      sender.tail[length + 1U] = '\0';
+      if (outputEndsWith("upload complete\r\n")) {
+        sender.endPs = btl_host_time();
+        senderStop(true);
+      } else if (outputEndsWith("upload aborted\r\n")) {
+        senderStop(false);
+      }
+      break;
+    }
+
+    case SENDER_DONE:
+      break;
+  }
+}
+
+static void senderTimeout(void *context)
+{
+  (void)context;
+  fprintf(stderr, "xmodem_sim: no response from the bootloader\n");
+  senderStop(false);
+}
+
+// Runs on the bootloader stack
+static void bootloader(void *argument)
+{
+  static const BtlHostLineHandler_t handler = {
+    .receive = senderReceive,
+    .timer = senderTimeout,
+    .context = NULL
+  };
+  const uint8_t select = sender.stream ? '5' : '1';
+
+  (void)argument;
+  communication_init();
+  if (sender.baudRate != 0U) {
+    (void)uart_setBaudRate(sender.baudRate);
+  }
+  btl_host_lineSetHandler(&handler);
+  btl_host_lineSend(&select, 1U);
+  btl_host_lineSetTimer(btl_host_time() + SENDER_TIMEOUT_PS);
+  (void)communication_main();
+}
+
+// -----------------------------------------------------------------------------
+// Main
+
+#define MAX_VALUES                 16U
+
+typedef struct {
+  const char *gblFile;
+  uint32_t nakMinUs;               // Range each NAK must be in, with --nak-us
+  uint32_t nakMaxUs;
+  const uint8_t *expect;
+  size_t   expectLength;
+  const uint8_t *installed;
+  size_t   installedLength;
+  uint32_t address;
+  bool     rejected;               // The upload has to be refused
+  double   maxCopy;                // Bytes copied per block, with --max-copy
+} Upload_t;
+
+// Parse a comma separated list of numbers
+static size_t parseList(char *list, uint32_t values[])
+{
+  size_t count = 0U;
+
+  for (char *c = strtok(list, ","); c != NULL && count < MAX_VALUES;
+       c = strtok(NULL, ",")) {
+    values[count++] = strtoul(c, NULL, 0);
+  }
+  return count;
+}
+
+// Upload the file once with the current parameters, and print the result
+static bool upload(const Upload_t *u)
+{
+  const BtlHostLineStats_t *line;
+  double seconds = 0.0;
+  double copied = 0.0;
+  bool ok = true;
+
+  bool done = (btl_host_run(bootloader, NULL) == SIM_STOP) && sender.ok;
+
+  if (done == u->rejected) {
+    if (done) {
+      fprintf(stderr, "%s: upload was not rejected\n", u->gblFile);
+    } else {
+      fprintf(stderr, "%s: upload failed after %u blocks\n", u->gblFile,
+              (unsigned)sender.blocks);
+    }
+    ok = false;
+  }
+  for (size_t i = 0; ok && i < u->expectLength; i++) {
+    if (((const uint8_t *)(uintptr_t)u->address)[i] != u->expect[i]) {
+      fprintf(stderr, "%s: flash differs at 0x%08zx\n", u->gblFile,
+              u->address + i);
+      ok = false;
+    }
+  }
+
+  if (ok && u->nakMaxUs != 0U) {
+    if (sender.retries == 0U) {
+      fprintf(stderr, "%s: no block was rejected\n", u->gblFile);
+      ok = false;
+    } else if (sender.nakMinPs < (uint64_t)u->nakMinUs * 1000000U
+               || sender.nakMaxPs > (uint64_t)u->nakMaxUs * 1000000U) {
+      fprintf(stderr, "%s: NAKs after %llu to %llu us\n", u->gblFile,
+              (unsigned long long)(sender.nakMinPs / 1000000U),
+              (unsigned long long)(sender.nakMaxPs / 1000000U));
+      ok = false;
+    }
+  }
+
+#if defined(SL_DEBUG_PROFILE) && (SL_DEBUG_PROFILE == 1)
+  copied = (sender.blocks == 0U) ? 0.0
+           : (double)btl_profileGetStats(BTL_PROFILE_STAGE_GBL_COPY)->bytes
+           / sender.blocks;
+#endif
+  if (ok && u->maxCopy >= 0.0 && copied > u->maxCopy) {
+    fprintf(stderr, "%s: %.1f bytes copied per block\n", u->gblFile, copied);
+    ok = false;
+  }
+
+  line = btl_host_lineStats();
+  if (ok && done) {
+    seconds = (double)(sender.endPs - sender.startPs) / (double)BTL_HOST_PS_PER_S;
+  }
+  printf("{\"stream\": %s, \"block\": %zu, \"baud\": %u, \"erase_us\": %u, "
+         "\"loss_ppm\": %u, \"gbl_bytes\": %zu, \"ok\": %s, \"blocks\": %u, "
+         "\"retries\": %u, \"bytes_lost\": %llu, \"overruns\": %llu, "
+         "\"nak_us_mean\": %.0f, \"nak_us_max\": %llu, "
+         "\"rts_deassertions\": %u, \"copied_per_block\": %.1f, "
+         "\"seconds\": %.4f, "
+         "\"blocks_per_s\": %.1f, \"bytes_per_s\": %.0f, "
+         "\"line_utilization\": %.3f}\n",
+         sender.stream ? "true" : "false", sender.blockSize,
+         (unsigned)btl_host_lineBaudRate(),
+         (unsigned)btl_host_timing.pageEraseUs, (unsigned)sender.lossPpm,
+         sender.gblLength, (ok && done) ? "true" : "false",
+         (unsigned)sender.blocks,
+         (unsigned)sender.retries, (unsigned long long)line->bytesLost,
+         (unsigned long long)line->bytesOverrun,
+         (sender.retries == 0U) ? 0.0
+         : (double)sender.nakTotalPs / sender.retries / 1e6,
+         (unsigned long long)(sender.nakMaxPs / 1000000U),
+         (unsigned)line->rtsDeassertions, copied, seconds,
+         (ok && done) ? sender.blocks / seconds : 0.0,
+         (ok && done) ? sender.gblLength / seconds : 0.0,
+         (ok && done) ? (double)line->bytesToDevice * 10.0
+         / btl_host_lineBaudRate() / seconds : 0.0);
+  fflush(stdout);
+  return ok;
+}
+
+static int usage(void)
+{
+  fprintf(stderr,
+          "usage: xmodem_sim [--stream] [--block 128,1024] [--baud N,...] "
+          "[--erase-us N,...] [--loss PPM,...] [--seed N] [--nak-us MIN,MAX] "
+          "[--cts-lag N] "
+          "[--write-ns N] [--crc-cpb N] [--parse-cpb N] "
+          "[--keep-going] [--rejected] [--max-copy N] [--installed BIN] "
+          "[--sign KEY] [--key TOKENS] "
+          "[--expect BIN] [--address ADDR] FILE.gbl\n");
+  return 2;
+}
+
+int main(int argc, char **argv)
+{
+  Upload_t u = { .address = 0x08006000UL, .maxCopy = -1.0 };
+  const char *signKey = NULL;
+  const char *decryptKey = NULL;
+  const uint8_t *gbl;
+  size_t gblLength;
+  uint32_t blocks[MAX_VALUES] = { 1024U };
+  size_t blockCount = 1U;
+  uint32_t bauds[MAX_VALUES] = { 0U };
+  size_t baudCount = 1U;
+  uint32_t erases[MAX_VALUES] = { btl_host_timing.pageEraseUs };
+  size_t eraseCount = 1U;
+  uint32_t losses[MAX_VALUES] = { 0U };
+  size_t lossCount = 1U;
+  uint32_t nakRange[MAX_VALUES];
+  bool stream = false;
+  bool keepGoing = false;
+
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--stream") == 0) {
+      stream = true;
+    } else if (strcmp(argv[i], "--keep-going") == 0) {
+      keepGoing = true;
+    } else if (strcmp(argv[i], "--rejected") == 0) {
+      u.rejected = true;
+    } else if (strcmp(argv[i], "--max-copy") == 0 && i + 1 < argc) {
+      u.maxCopy = strtod(argv[++i], NULL);
+    } else if (strcmp(argv[i], "--block") == 0 && i + 1 < argc) {
+      blockCount = parseList(argv[++i], blocks);
+    } else if (strcmp(argv[i], "--baud") == 0 && i + 1 < argc) {
+      baudCount = parseList(argv[++i], bauds);
+    } else if (strcmp(argv[i], "--erase-us") == 0 && i + 1 < argc) {
+      eraseCount = parseList(argv[++i], erases);
+    } else if (strcmp(argv[i], "--loss") == 0 && i + 1 < argc) {
+      lossCount = parseList(argv[++i], losses);
+    } else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+      btl_host_line.seed = strtoul(argv[++i], NULL, 0);
+    } else if (strcmp(argv[i], "--nak-us") == 0 && i + 1 < argc) {
+      if (parseList(argv[++i], nakRange) != 2U || nakRange[1] == 0U) {
+        return usage();
+      }
+      u.nakMinUs = nakRange[0];
+      u.nakMaxUs = nakRange[1];
+    } else if (strcmp(argv[i], "--cts-lag") == 0 && i + 1 < argc) {
+      btl_host_line.ctsLagBytes = strtoul(argv[++i], NULL, 0);
+    } else if (strcmp(argv[i], "--write-ns") == 0 && i + 1 < argc) {
+      btl_host_timing.wordWriteNs = strtoul(argv[++i], NULL, 0);
+    } else if (strcmp(argv[i], "--crc-cpb") == 0 && i + 1 < argc) {
+      crcCyclesPerByte = strtoul(argv[++i], NULL, 0);
+    } else if (strcmp(argv[i], "--parse-cpb") == 0 && i + 1 < argc) {
+      parseCyclesPerByte = strtoul(argv[++i], NULL, 0);
+    } else if (strcmp(argv[i], "--sign") == 0 && i + 1 < argc) {
+      signKey = argv[++i];
+    } else if (strcmp(argv[i], "--key") == 0 && i + 1 < argc) {
+      decryptKey = argv[++i];
+    } else if (strcmp(argv[i], "--expect") == 0 && i + 1 < argc) {
+      u.expect = feed_readFile(argv[++i], &u.expectLength);
+    } else if (strcmp(argv[i], "--installed") == 0 && i + 1 < argc) {
+      u.installed = feed_readFile(argv[++i], &u.installedLength);
+    } else if (strcmp(argv[i], "--address") == 0 && i + 1 < argc) {
+      u.address = strtoul(argv[++i], NULL, 0);
+    } else if (argv[i][0] != '-' && u.gblFile == NULL) {
+      u.gblFile = argv[i];
+    } else {
+      return usage();
+    }
+  }
+  if (u.gblFile == NULL || blockCount == 0U || baudCount == 0U
+      || eraseCount == 0U || lossCount == 0U) {
+    return usage();
+  }
+  for (size_t b = 0; b < blockCount; b++) {
+    if (blocks[b] != 128U && blocks[b] != 1024U) {
+      return usage();
+    }
+  }
+  gbl = feed_readFile(u.gblFile, &gblLength);
+
+  for (size_t l = 0; l < lossCount; l++) {
+    for (size_t e = 0; e < eraseCount; e++) {
+      for (size_t r = 0; r < baudCount; r++) {
+        for (size_t b = 0; b < blockCount; b++) {
+          btl_host_timing.pageEraseUs = erases[e];
+          // The menu selection is not lost
+          btl_host_line.lossPpm = 0U;
+          btl_host_reset();
+          btl_host_flashErase();
+          if (u.installed != NULL) {
+            btl_host_flashLoad(u.address, u.installed, u.installedLength);
+          }
+          if (btl_host_loadKeys(signKey, decryptKey) != 0) {
+            return 2;
+          }
+          memset(&sender, 0, sizeof(sender));
+          sender.stream = stream;
+          sender.lossPpm = losses[l];
+          sender.blockSize = blocks[b];
+          sender.blockNumber = 1U;
+          sender.baudRate = bauds[r];
+          sender.gbl = gbl;
+          sender.gblLength = gblLength;
+          if (!upload(&u) && !keepGoing) {
+            return 1;
+          }
+        }
+      }
+    }
+  }
+  return 0;
+}
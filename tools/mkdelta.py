@@ -0,0 +1,193 @@
+#!/usr/bin/env python3
+"""Create delta GBL upgrade files for BOOTLOADER_DELTA_OTW.
+
+Writes a GBL file that upgrades the installed application OLD to NEW with
+a patch in the format of core/btl_delta.h: a header naming OLD by its size
+and CRC-32, then blocks of diff bytes, which are added to bytes of OLD, and
+extra bytes, which are new. The patch is carried in a DELTA tag, or with
+--compress lzma in a DELTA_LZMA tag, and is encrypted and signed as with
+mkgbl.py.
+
+  mkdelta.py --old installed.bin --new app.bin --sign keys/vendor_sign.key \\
+             --encrypt keys/vendor_encrypt.key --compress lzma out.gbl
+
+The bootloader rebuilds NEW in the application space above OLD, so both
+together must fit in the application space: 0x7A000 bytes, or 0x66000 bytes
+with resumable uploads. Images of the size of the Z-Wave controller firmware
+can't be upgraded this way. The bootloader refuses a patch for another
+application before anything is erased.
+
+Matches are found with a hash of MATCH_SIZE bytes and extended as in
+bsdiff, so that code that only moved keeps mostly zero diff bytes, which
+compress well. The patch is applied on the host before it is written, and
+the result compared with NEW.
+"""
+
+import argparse
+import struct
+import sys
+import zlib
+
+import mkgbl
+
+TAG_DELTA = 0xF80A0AF8
+TAG_DELTA_LZMA = 0xF80C0CF8
+
+# Patch header and blocks, see core/btl_delta.h
+DELTA_PATCH_MAGIC = 0x31544C44
+# Shortest exact match that starts a block
+MATCH_SIZE = 16
+# A diff run ends once this many bytes have not improved it
+DIFF_GIVE_UP = 256
+# Application space of the bootloader without and with resumable uploads
+APP_SPACE_SIZE = 0x7A000
+APP_SPACE_SIZE_RESUME = 0x66000
+FLASH_PAGE_SIZE = 0x2000
+
+
+def index_old(old):
+    """First position of each MATCH_SIZE byte string of OLD"""
+    index = {}
+    for pos in range(len(old) - MATCH_SIZE + 1):
+        index.setdefault(old[pos:pos + MATCH_SIZE], pos)
+    return index
+
+
+def diff_length(old, old_pos, new, new_pos):
+    """Length of the diff run from these positions: as long as at least half
+    of the bytes are equal, as in bsdiff"""
+    best = 0
+    best_score = 0
+    equal = 0
+    limit = min(len(old) - old_pos, len(new) - new_pos)
+    for i in range(limit):
+        if old[old_pos + i] == new[new_pos + i]:
+            equal += 1
+        score = 2 * equal - (i + 1)
+        if score > best_score:
+            best_score = score
+            best = i + 1
+        elif i + 1 - best > DIFF_GIVE_UP:
+            break
+    return best
+
+
+def find_match(old, index, new, new_pos, old_hint):
+    """Next position in NEW from new_pos that starts an exact match, and its
+    position in OLD. Staying in line with the previous block is preferred."""
+    for pos in range(new_pos, len(new) - MATCH_SIZE + 1):
+        key = new[pos:pos + MATCH_SIZE]
+        hint = old_hint + (pos - new_pos)
+        if old[hint:hint + MATCH_SIZE] == key:
+            return pos, hint
+        found = index.get(key)
+        if found is not None:
+            return pos, found
+    return len(new), None
+
+
+def make_patch(old, new):
+    index = index_old(old)
+    out = bytearray(struct.pack('<III', DELTA_PATCH_MAGIC, len(old),
+                                zlib.crc32(old) & 0xFFFFFFFF))
+    new_pos = 0
+    old_pos = 0
+    while new_pos < len(new):
+        diff = diff_length(old, old_pos, new, new_pos)
+        extra_start = new_pos + diff
+        match, next_old = find_match(old, index, new, extra_start,
+                                     old_pos + diff)
+        if next_old is None:
+            next_old = old_pos + diff
+        out += struct.pack('<IIi', diff, match - extra_start,
+                           next_old - (old_pos + diff))
+        out += bytes((n - o) & 0xFF for n, o in
+                     zip(new[new_pos:extra_start], old[old_pos:old_pos + diff]))
+        out += new[extra_start:match]
+        new_pos = match
+        old_pos = next_old
+    return bytes(out)
+
+
+def apply_patch(old, patch):
+    """The bootloader side, to check the patch before it is written"""
+    magic, old_size, old_crc = struct.unpack_from('<III', patch, 0)
+    if (magic != DELTA_PATCH_MAGIC or old_size != len(old)
+            or old_crc != zlib.crc32(old) & 0xFFFFFFFF):
+        raise ValueError('patch header does not match OLD')
+    new = bytearray()
+    pos = 12
+    old_pos = 0
+    while pos < len(patch):
+        diff, extra, skip = struct.unpack_from('<IIi', patch, pos)
+        pos += 12
+        new += bytes((d + o) & 0xFF for d, o in
+                     zip(patch[pos:pos + diff], old[old_pos:old_pos + diff]))
+        pos += diff
+        new += patch[pos:pos + extra]
+        pos += extra
+        old_pos += diff + skip
+        if not 0 <= old_pos <= len(old):
+            raise ValueError('patch reaches outside OLD')
+    return bytes(new)
+
+
+def delta_tags(patch, new, compress, lzma_dict):
+    header = struct.pack('<III', zlib.crc32(new) & 0xFFFFFFFF, len(new), 0)
+    if compress == 'lzma':
+        return mkgbl.tag(TAG_DELTA_LZMA, header
+                         + mkgbl.lzma_compress(patch, lzma_dict))
+    # Trailing 0xFF bytes can't be mistaken for a block header
+    return mkgbl.tag(TAG_DELTA, header + patch + b'\xff' * (-len(patch) % 4))
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__,
+                                     formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument('--old', required=True, help='installed application binary')
+    parser.add_argument('--new', required=True, help='new application binary')
+    parser.add_argument('--app-type', type=lambda s: int(s, 0),
+                        default=mkgbl.APP_TYPE_ZWAVE)
+    parser.add_argument('--app-version', type=lambda s: int(s, 0), default=0)
+    parser.add_argument('--compress', choices=['none', 'lzma'], default='none')
+    parser.add_argument('--app-space', type=mkgbl.size, default=APP_SPACE_SIZE,
+                        metavar='SIZE',
+                        help='application space of the bootloader (default: '
+                        '0x%X, 0x%X with resumable uploads)'
+                        % (APP_SPACE_SIZE, APP_SPACE_SIZE_RESUME))
+    parser.add_argument('--lzma-dict', type=mkgbl.size,
+                        default=mkgbl.LZMA_DEFAULT_DICT, metavar='SIZE',
+                        help='LZMA dictionary size (default: 8K); it must '
+                        'fit LZMA_DICT_SIZE_KB, patches are not read back')
+    parser.add_argument('--sign', metavar='KEY', help='PEM ECDSA P-256 private key')
+    parser.add_argument('--encrypt', metavar='TOKENS',
+                        help='Commander token file with the decryption key')
+    parser.add_argument('--nonce', help='AES-CTR nonce, 12 bytes in hex (default: random)')
+    parser.add_argument('output')
+    args = parser.parse_args()
+
+    with open(args.old, 'rb') as f:
+        old = f.read()
+    with open(args.new, 'rb') as f:
+        new = f.read()
+    # The bootloader rebuilds and checks whole words of the new image
+    new += b'\xff' * (-len(new) % 4)
+    # ...above OLD, from the next page to the end of the application space
+    scratch = len(old) + (-len(old) % FLASH_PAGE_SIZE)
+    if scratch + len(new) > args.app_space:
+        raise SystemExit('OLD (%d bytes) and NEW (%d bytes) do not fit the '
+                         'application space of 0x%X bytes; use a full GBL file'
+                         % (len(old), len(new), args.app_space))
+
+    patch = make_patch(old, new)
+    if apply_patch(old, patch) != new:
+        raise SystemExit('patch does not rebuild NEW')
+
+    with open(args.output, 'wb') as f:
+        f.write(mkgbl.build_gbl(args, delta_tags(patch, new, args.compress,
+                                                 args.lzma_dict)))
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
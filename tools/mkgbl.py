@@ -0,0 +1,253 @@
+#!/usr/bin/env python3
+"""Create GBL upgrade files for the host build and benchmarks.
+
+Writes the subset of the GBL format the bootloader parses: an application
+image in PROG, PROG_LZMA or PROG_LZ4 tags, optionally AES-CTR encrypted with
+the key of a Commander token file and signed with an ECDSA P-256 key. Uses
+the openssl command line tool for signing and encryption.
+
+Release images are still created with Simplicity Commander (tools/mkgbl.sh).
+
+  mkgbl.py --app app.bin --address 0x08006000 --sign keys/vendor_sign.key \\
+           --encrypt keys/vendor_encrypt.key --compress lzma out.gbl
+
+LZMA dictionaries larger than the bootloader keeps in RAM
+(LZMA_DICT_SIZE_KB, 8 KiB) compress better, but can only be decoded by a
+bootloader built with LZMA_DICT_READ_BACK set to 1, which reads matches
+beyond its RAM window back from flash. Commander does not set the LZMA
+dictionary size, so build such images with --lzma-dict:
+
+  mkgbl.py --app app.bin --sign keys/vendor_sign.key \\
+           --encrypt keys/vendor_encrypt.key --compress lzma \\
+           --lzma-dict 256K out.gbl
+
+lc + lp must fit the probability counters of the bootloader
+(LZMA_COUNTER_SIZE_KB); the default lc = 1, lp = 0 fits the default 10 KiB.
+"""
+
+import argparse
+import lzma
+import os
+import struct
+import subprocess
+import sys
+import tempfile
+import zlib
+
+TAG_HEADER_V3 = 0x03A617EB
+TAG_APPLICATION = 0xF40A0AF4
+TAG_PROG = 0xFE0101FE
+TAG_PROG_LZ4 = 0xFD0505FD
+TAG_PROG_LZMA = 0xFD0707FD
+TAG_END = 0xFC0404FC
+TAG_ENC_INIT = 0xFA0606FA
+TAG_ENC_GBL_DATA = 0xF90707F9
+TAG_SIGNATURE_ECDSA_P256 = 0xF70A0AF7
+
+GBL_VERSION = 0x03000000
+GBL_TYPE_ENCRYPTION_AESCCM = 0x00000001
+GBL_TYPE_SIGNATURE_ECDSA = 0x00000100
+
+APP_TYPE_ZWAVE = 1 << 7
+
+# Dictionary the bootloader decodes with by default (LZMA_DICT_SIZE_KB)
+LZMA_DEFAULT_DICT = 8 * 1024
+# Literal context and position bits, lc + lp must fit LZMA_COUNTER_SIZE_KB
+LZMA_DEFAULT_LC = 1
+LZMA_DEFAULT_LP = 0
+
+
+def size(text):
+    """Size in bytes, with an optional K or M suffix"""
+    units = {'K': 1024, 'M': 1024 * 1024}
+    text = text.strip().upper()
+    if text and text[-1] in units:
+        return int(text[:-1], 0) * units[text[-1]]
+    return int(text, 0)
+
+
+def tag(tag_id, payload):
+    return struct.pack('<II', tag_id, len(payload)) + payload
+
+
+def lzma_compress(data, dict_size, lc=LZMA_DEFAULT_LC, lp=LZMA_DEFAULT_LP):
+    """LZMA stream as in PROG_LZMA tags: 5 bytes properties, 8 bytes size"""
+    filters = [{'id': lzma.FILTER_LZMA1, 'dict_size': dict_size,
+                'lc': lc, 'lp': lp, 'pb': 2}]
+    stream = lzma.compress(data, format=lzma.FORMAT_ALONE, filters=filters)
+    return stream[:5] + struct.pack('<Q', len(data)) + stream[13:]
+
+
+def lz4_compress(data):
+    """LZ4 block format, greedy matching with a hash of four bytes"""
+    out = bytearray()
+    table = {}
+    anchor = 0
+    pos = 0
+    # The last match starts at least 12 bytes before the end, and the last
+    # five bytes are literals
+    match_limit = len(data) - 12
+
+    def length_bytes(n):
+        ext = bytearray()
+        while n >= 255:
+            ext.append(255)
+            n -= 255
+        ext.append(n)
+        return ext
+
+    def sequence(literals, offset=None, match_len=0):
+        lit_len = len(literals)
+        token = min(lit_len, 15) << 4
+        if offset is not None:
+            token |= min(match_len - 4, 15)
+        out.append(token)
+        if lit_len >= 15:
+            out.extend(length_bytes(lit_len - 15))
+        out.extend(literals)
+        if offset is not None:
+            out.extend(struct.pack('<H', offset))
+            if match_len - 4 >= 15:
+                out.extend(length_bytes(match_len - 4 - 15))
+
+    while pos < match_limit:
+        key = data[pos:pos + 4]
+        candidate = table.get(key)
+        table[key] = pos
+        if candidate is not None and pos - candidate <= 0xFFFF:
+            length = 4
+            end = len(data) - 5
+            while pos + length < end and data[candidate + length] == data[pos + length]:
+                length += 1
+            sequence(data[anchor:pos], pos - candidate, length)
+            for i in range(pos + 1, min(pos + length, match_limit)):
+                table[data[i:i + 4]] = i
+            pos += length
+            anchor = pos
+        else:
+            pos += 1
+    sequence(data[anchor:])
+    return bytes(out)
+
+
+def read_token_key(path):
+    with open(path) as f:
+        for line in f:
+            if line.startswith('TOKEN_MFG_SECURE_BOOTLOADER_KEY:'):
+                return bytes.fromhex(line.split(':', 1)[1].strip())
+    raise SystemExit('%s: no TOKEN_MFG_SECURE_BOOTLOADER_KEY' % path)
+
+
+def aes_ctr(key, nonce, data):
+    """AES-CTR as the bootloader uses it: counter block 0x02 | nonce | 1"""
+    iv = bytes([0x02]) + nonce + b'\x00\x00\x01'
+    result = subprocess.run(['openssl', 'enc', '-aes-128-ctr', '-nosalt',
+                             '-K', key.hex(), '-iv', iv.hex()],
+                            input=data, stdout=subprocess.PIPE, check=True)
+    return result.stdout
+
+
+def der_int(der, pos):
+    if der[pos] != 0x02:
+        raise ValueError('bad DER signature')
+    length = der[pos + 1]
+    value = int.from_bytes(der[pos + 2:pos + 2 + length], 'big')
+    return value, pos + 2 + length
+
+
+def ecdsa_sign(key_file, data):
+    with tempfile.NamedTemporaryFile(delete=False) as f:
+        f.write(data)
+        name = f.name
+    try:
+        der = subprocess.run(['openssl', 'dgst', '-sha256', '-sign', key_file,
+                              name], stdout=subprocess.PIPE, check=True).stdout
+    finally:
+        os.unlink(name)
+    # SEQUENCE { INTEGER r, INTEGER s }
+    pos = 2 if der[1] < 0x80 else 3
+    r, pos = der_int(der, pos)
+    s, _ = der_int(der, pos)
+    return r.to_bytes(32, 'big') + s.to_bytes(32, 'big')
+
+
+def prog_tags(data, address, compress, lzma_dict, lzma_lc, lzma_lp):
+    if compress == 'lzma':
+        return tag(TAG_PROG_LZMA, struct.pack('<I', address)
+                   + lzma_compress(data, lzma_dict, lzma_lc, lzma_lp))
+    if compress == 'lz4':
+        return tag(TAG_PROG_LZ4, struct.pack('<I', address) + lz4_compress(data))
+    return tag(TAG_PROG, struct.pack('<I', address) + data)
+
+
+def build_gbl(args, data_tags):
+    """GBL file with the application data tags given, encrypted and signed
+    as the options ask for"""
+    gbl_type = 0
+    if args.encrypt:
+        gbl_type |= GBL_TYPE_ENCRYPTION_AESCCM
+    if args.sign:
+        gbl_type |= GBL_TYPE_SIGNATURE_ECDSA
+
+    out = tag(TAG_HEADER_V3, struct.pack('<II', GBL_VERSION, gbl_type))
+    inner = tag(TAG_APPLICATION, struct.pack('<III16s', args.app_type,
+                                             args.app_version, 0, b''))
+    inner += data_tags
+
+    if args.encrypt:
+        key = read_token_key(args.encrypt)
+        nonce = os.urandom(12) if args.nonce is None else bytes.fromhex(args.nonce)
+        out += tag(TAG_ENC_INIT, struct.pack('<I', len(inner)) + nonce)
+        out += tag(TAG_ENC_GBL_DATA, aes_ctr(key, nonce, inner))
+    else:
+        out += inner
+
+    if args.sign:
+        out += tag(TAG_SIGNATURE_ECDSA_P256, ecdsa_sign(args.sign, out))
+
+    out += struct.pack('<II', TAG_END, 4)
+    out += struct.pack('<I', zlib.crc32(out) & 0xFFFFFFFF)
+    return out
+
+
+def build(args):
+    with open(args.app, 'rb') as f:
+        app = f.read()
+    app += b'\xff' * (-len(app) % 4)
+    return build_gbl(args, prog_tags(app, args.address, args.compress,
+                                     args.lzma_dict, args.lzma_lc, args.lzma_lp))
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__,
+                                     formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument('--app', required=True, help='application binary')
+    parser.add_argument('--address', type=lambda s: int(s, 0), default=0x08006000,
+                        help='flash address of the application')
+    parser.add_argument('--app-type', type=lambda s: int(s, 0), default=APP_TYPE_ZWAVE)
+    parser.add_argument('--app-version', type=lambda s: int(s, 0), default=0)
+    parser.add_argument('--compress', choices=['none', 'lzma', 'lz4'], default='none')
+    parser.add_argument('--lzma-dict', type=size, default=LZMA_DEFAULT_DICT,
+                        metavar='SIZE',
+                        help='LZMA dictionary size, such as 64K or 256K '
+                        '(default: 8K); see above')
+    parser.add_argument('--lzma-lc', type=int, default=LZMA_DEFAULT_LC,
+                        choices=range(0, 9), help='LZMA literal context bits')
+    parser.add_argument('--lzma-lp', type=int, default=LZMA_DEFAULT_LP,
+                        choices=range(0, 5), help='LZMA literal position bits')
+    parser.add_argument('--sign', metavar='KEY', help='PEM ECDSA P-256 private key')
+    parser.add_argument('--encrypt', metavar='TOKENS',
+                        help='Commander token file with the decryption key')
+    parser.add_argument('--nonce', help='AES-CTR nonce, 12 bytes in hex (default: random)')
+    parser.add_argument('output')
+    args = parser.parse_args()
+    if not 4096 <= args.lzma_dict <= 1 << 30:
+        parser.error('--lzma-dict must be from 4K to 1024M')
+
+    with open(args.output, 'wb') as f:
+        f.write(build(args))
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
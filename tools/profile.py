@@ -0,0 +1,63 @@
+#!/usr/bin/env python3
+"""Report the profile menu of the bootloader in bytes per cycle.
+
+Reads the output of the profile menu entry of a bootloader built with
+SL_DEBUG_PROFILE, as captured from the serial terminal after an upload:
+one line per stage, with the calls, bytes and core cycles in hex. Writes
+one JSON object per stage that ran, with bytes per cycle and, given the
+core clock, MB/s. Other lines of the capture, such as the menu, are
+skipped.
+
+  profile.py [--clock HZ] [--name NAME] capture.txt
+
+The lzma_decode and lz4_decode stages count decoded bytes, and cover the
+decoder calls only, as on the host (tools/host, bench target lzma_decode).
+Captures of bootloaders built with different options of the decoder can be
+told apart with --name.
+"""
+
+import argparse
+import json
+import re
+import sys
+
+STAGE = re.compile(r'^\s*([a-z0-9_]+) ([0-9A-Fa-f]{8}) ([0-9A-Fa-f]{8}) '
+                   r'([0-9A-Fa-f]{16})\s*$')
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__,
+                                     formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument('--clock', type=float, metavar='HZ',
+                        help='core clock, to report MB/s as well')
+    parser.add_argument('--name', help='name of the capture in the output')
+    parser.add_argument('capture', type=argparse.FileType('r', errors='replace'),
+                        help='profile menu output, - for standard input')
+    args = parser.parse_args()
+
+    found = False
+    for line in args.capture:
+        match = STAGE.match(line)
+        if match is None:
+            continue
+        found = True
+        stage = match.group(1)
+        calls, size, cycles = (int(match.group(i), 16) for i in range(2, 5))
+        if calls == 0:
+            continue
+        result = {'stage': stage, 'calls': calls, 'bytes': size, 'cycles': cycles}
+        if args.name is not None:
+            result = {'name': args.name, **result}
+        if cycles != 0:
+            result['bytes_per_cycle'] = round(size / cycles, 4)
+            if args.clock is not None:
+                result['mb_per_s'] = round(size * args.clock / cycles / 1e6, 2)
+        print(json.dumps(result))
+    if not found:
+        print('%s: no profile stages found' % args.capture.name, file=sys.stderr)
+        return 1
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())